@@ -0,0 +1,1868 @@
+#include "Benchmarks.h"
+#include "SceneGraph.h"
+#include "Drone.h"
+#include "TransformSoA.h"
+#include "ClusteredLights.h"
+#include "ShadowCascades.h"
+#include "FrustumCulling.h"
+#include "RenderQueue.h"
+#include "VertexFormat.h"
+#include "MeshOptimizer.h"
+#include "cubev2.h"
+#include "Tube.h"
+#include "UnitTube.h"
+#include "MeshLod.h"
+#include "Swarm.h"
+#include "JobSystem.h"
+#include "FixedTimestep.h"
+#include "Profiler.h"
+#include "InputLog.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <stack>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <random>
+#include <fstream>
+#include <sstream>
+
+#include <glm/glm.hpp>
+#include "glm/gtc/matrix_transform.hpp"
+
+using namespace std;
+using namespace glm;
+
+typedef chrono::high_resolution_clock benchClock;
+
+/* Runs the function repeatedly for at least minSeconds and returns the average time of one run in microseconds */
+template <typename Function>
+static double timeRuns(Function function, double minSeconds = 0.2)
+{
+	int runs = 0;
+	benchClock::time_point start = benchClock::now();
+	double elapsed = 0.0;
+	do
+	{
+		function();
+		runs++;
+		elapsed = chrono::duration<double>(benchClock::now() - start).count();
+	} while (elapsed < minSeconds);
+
+	return elapsed * 1e6 / runs;
+}
+
+// stops the compiler from removing the work being timed
+static volatile float benchSink;
+
+// set by any check that fails, so the run can end with a failing exit code
+static bool benchmarkFailed;
+
+static const char* check(bool passed, const char* passText = "ok")
+{
+	if (!passed)
+		benchmarkFailed = true;
+	return passed ? passText : "FAILED";
+}
+
+static vec3 benchDronePosition(int i)
+{
+	return vec3((float)(i % 100) - 50.f, 1.f, (float)(i / 100) - 50.f);
+}
+
+/* The transform part of the original render() traversal, rebuilding every matrix with a
+   std::stack<mat4> each frame. Each drawn part writes its model matrix to out. Every drone is
+   moved by offset from benchDronePosition and turned by modelAngle, in degrees */
+static void stackTraversal(int numDrones, float motorAngle, vec3 offset, vec3 modelAngle, vector<mat4>& out)
+{
+	vec3 framePlateScale = vec3(1.f, 0.015f, 0.3f);
+	vec3 frameArmScale = vec3(0.8f, 0.03f, 0.15f);
+	vec3 standoffScale = vec3(0.025f, 0.17f, 0.025f);
+	vec3 motorBellScale = vec3(0.15f, 0.085f, 0.15f);
+	vec3 motorStatorScale = vec3(0.125f, 0.08f, 0.125f);
+	vec3 motorShaftScale = vec3(0.025f, 0.085f, 0.025f);
+	vec3 motorStrutsScale = vec3(0.011f, 0.011f, 0.14f);
+	vec3 groundPlaneScale = vec3(20.f, 0.0001f, 20.f);
+	vec3 standoffPositions[8] =
+	{
+		vec3(0.45f, 0.f, 0.12f), vec3(0.2f, 0.f, 0.12f), vec3(-0.2f, 0.f, 0.12f), vec3(-0.45f, 0.f, 0.12f),
+		vec3(0.45f, 0.f, -0.12f), vec3(0.2f, 0.f, -0.12f), vec3(-0.2f, 0.f, -0.12f), vec3(-0.45f, 0.f, -0.12f)
+	};
+
+	out.clear();
+	stack<mat4> model;
+	model.push(mat4(1.0f));
+
+	for (int d = 0; d < numDrones; d++)
+	{
+		model.push(model.top());
+		model.top() = translate(model.top(), benchDronePosition(d) + offset);
+		model.top() = rotate(model.top(), -radians(modelAngle.x), vec3(1, 0, 0));
+		model.top() = rotate(model.top(), -radians(modelAngle.y), vec3(0, 1, 0));
+		model.top() = rotate(model.top(), -radians(modelAngle.z), vec3(0, 0, 1));
+		model.top() = rotate(model.top(), -radians(90.f), vec3(0, 1, 0));
+		model.top() = scale(model.top(), vec3(1.f));
+
+		for (int i = 0; i < 4; i++)
+		{
+			model.push(model.top());
+			model.top() = rotate(model.top(), -radians((90 * i) + 45.f), vec3(0, 1, 0));
+			model.top() = translate(model.top(), vec3(0.7f, -0.08f, 0.f));
+			model.top() = scale(model.top(), vec3(0.02f, 0.02f, 0.02f));
+			out.push_back(model.top());
+			model.pop();
+		}
+
+		for (int i = 0; i < 2; i++)
+		{
+			model.push(model.top());
+			model.top() = translate(model.top(), vec3(0.f, i == 0 ? -0.085f : 0.085f, 0.f));
+			model.top() = scale(model.top(), framePlateScale);
+			out.push_back(model.top());
+			model.pop();
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			model.push(model.top());
+			model.top() = rotate(model.top(), -radians((90 * i) + 45.f), vec3(0, 1, 0));
+			model.top() = translate(model.top(), vec3(0.45f, -0.1f, 0.f));
+			model.top() = scale(model.top(), frameArmScale);
+			out.push_back(model.top());
+			model.pop();
+		}
+
+		for (int i = 0; i < 4; i++)
+		{
+			model.push(model.top());
+			model.top() = rotate(model.top(), -radians((90 * i) + 45.f), vec3(0, 1, 0));
+			model.top() = translate(model.top(), vec3(0.77f, -0.02f, 0.f));
+
+			model.push(model.top());
+			model.top() = rotate(model.top(), (i % 2 == 0 ? -1.f : 1.f) * radians(motorAngle), vec3(0, 1, 0));
+
+			model.push(model.top());
+			model.top() = translate(model.top(), vec3(0.f, 0.042f, 0.f));
+			for (int j = 0; j < 3; j++)
+			{
+				model.push(model.top());
+				model.top() = rotate(model.top(), -radians(120.f * j), vec3(0, 1, 0));
+
+				model.push(model.top());
+				model.top() = rotate(model.top(), (i % 2 == 0 ? -1.f : 1.f) * radians(10.f), vec3(1, 0, 0));
+				model.top() = translate(model.top(), vec3(0.15f, 0.03f, 0.f));
+				model.top() = scale(model.top(), vec3(0.3f, 0.01f, 0.05f));
+				out.push_back(model.top());
+				model.pop();
+
+				for (int k = 0; k < 2; k++)
+				{
+					model.push(model.top());
+					model.top() = translate(model.top(), vec3(k == 0 ? 0.015f : -0.015f, 0.f, 0.f));
+					model.top() = scale(model.top(), motorStrutsScale);
+					out.push_back(model.top());
+					model.pop();
+				}
+				model.pop();
+			}
+			model.pop();
+
+			model.push(model.top());
+			model.top() = translate(model.top(), vec3(0.f, 0.06f, 0.f));
+			model.top() = scale(model.top(), motorShaftScale);
+			model.top() = rotate(model.top(), -radians(90.f), vec3(1, 0, 0));
+			out.push_back(model.top());
+			model.pop();
+
+			model.push(model.top());
+			model.top() = scale(model.top(), motorBellScale);
+			model.top() = rotate(model.top(), -radians(90.f), vec3(1, 0, 0));
+			out.push_back(model.top());
+			model.pop();
+			model.pop();
+
+			model.push(model.top());
+			model.top() = translate(model.top(), vec3(0.f, -0.06f, 0.f));
+			model.top() = scale(model.top(), vec3(0.12f, 0.01f, 0.04f));
+			out.push_back(model.top());
+			model.pop();
+
+			model.push(model.top());
+			model.top() = translate(model.top(), vec3(0.f, -0.06f, 0.f));
+			model.top() = scale(model.top(), vec3(0.04f, 0.01f, 0.12f));
+			out.push_back(model.top());
+			model.pop();
+
+			model.push(model.top());
+			model.top() = translate(model.top(), vec3(0.f, -0.015f, 0.f));
+			model.top() = scale(model.top(), motorStatorScale);
+			model.top() = rotate(model.top(), -radians(90.f), vec3(1, 0, 0));
+			out.push_back(model.top());
+			model.pop();
+
+			model.pop();
+		}
+
+		for (int i = 0; i < 8; i++)
+		{
+			model.push(model.top());
+			model.top() = translate(model.top(), standoffPositions[i]);
+			model.top() = scale(model.top(), standoffScale);
+			model.top() = rotate(model.top(), -radians(90.f), vec3(1, 0, 0));
+			out.push_back(model.top());
+			model.pop();
+		}
+		model.pop();
+	}
+
+	model.push(model.top());
+	model.top() = translate(model.top(), vec3(0.f, -1.f, 0.f));
+	model.top() = scale(model.top(), groundPlaneScale);
+	out.push_back(model.top());
+	model.pop();
+}
+
+/* Largest difference between the world matrices of the graph's drawn nodes, in order, and the
+   stack traversal's model matrices */
+static float stackDifference(const SceneGraph& graph, const vector<mat4>& stackMatrices)
+{
+	float difference = 0.f;
+	size_t drawn = 0;
+	for (const SceneNode& node : graph.nodes)
+	{
+		if (node.mesh < 0)
+			continue;
+		if (drawn == stackMatrices.size())
+			return 3.4e38f;
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+				difference = std::max(difference, fabs(node.world[c][r] - stackMatrices[drawn][c][r]));
+		}
+		drawn++;
+	}
+	return drawn == stackMatrices.size() ? difference : 3.4e38f;
+}
+
+/* Compares rebuilding every transform with the matrix stack against the scene graph,
+   where only the nodes below a changed node are recomputed */
+static void benchmarkSceneGraph()
+{
+	cout << "scene graph traversal (microseconds per frame), with the largest difference from the stack" << endl;
+	cout << setw(8) << "drones" << setw(14) << "stack" << setw(14) << "graph idle" << setw(14) << "graph flying" << setw(14) << "difference" << endl;
+
+	int droneCounts[] = { 1, 10, 100, 1000, 10000 };
+	for (int numDrones : droneCounts)
+	{
+		vector<mat4> out;
+		out.reserve(numDrones * 70 + 1);
+		float motorAngle = 0.f;
+
+		double stackTime = timeRuns([&]()
+		{
+			motorAngle += 47.f;
+			stackTraversal(numDrones, motorAngle, vec3(0.f), vec3(0.f), out);
+			benchSink = out.back()[3][0];
+		});
+
+		SceneGraph graph;
+		vector<DroneNodes> drones;
+		for (int i = 0; i < numDrones; i++)
+		{
+			drones.push_back(buildDrone(graph));
+			setDronePose(graph, drones[i], benchDronePosition(i), vec3(0.f), 1.f);
+		}
+		buildGroundPlane(graph);
+		graph.updateWorldTransforms();
+
+		// drones sitting still with the props spinning
+		double idleTime = timeRuns([&]()
+		{
+			motorAngle += 47.f;
+			for (int i = 0; i < numDrones; i++)
+				setDroneMotorAngle(graph, drones[i], motorAngle);
+			graph.updateWorldTransforms();
+			benchSink = graph.nodes.back().world[3][0];
+		});
+		stackTraversal(numDrones, motorAngle, vec3(0.f), vec3(0.f), out);
+		float difference = stackDifference(graph, out);
+
+		// every drone moving as well
+		float height = 0.f;
+		double flyingTime = timeRuns([&]()
+		{
+			motorAngle += 47.f;
+			height += 0.01f;
+			for (int i = 0; i < numDrones; i++)
+			{
+				setDronePose(graph, drones[i], benchDronePosition(i) + vec3(0.f, height, 0.f), vec3(10.f, 0.f, 5.f), 1.f);
+				setDroneMotorAngle(graph, drones[i], motorAngle);
+			}
+			graph.updateWorldTransforms();
+			benchSink = graph.nodes.back().world[3][0];
+		});
+		stackTraversal(numDrones, motorAngle, vec3(0.f, height, 0.f), vec3(10.f, 0.f, 5.f), out);
+		difference = glm::max(difference, stackDifference(graph, out));
+
+		cout << fixed << setprecision(1) << setw(8) << numDrones << setw(14) << stackTime << setw(14) << idleTime << setw(14) << flyingTime <<
+			scientific << setprecision(2) << setw(14) << difference << "  " << check(difference < 1e-4f) << endl;
+	}
+	cout << endl;
+}
+
+/* Builds a scene graph of drones in random poses */
+static void buildRandomDrones(SceneGraph& graph, int numDrones)
+{
+	srand(1);
+	for (int i = 0; i < numDrones; i++)
+	{
+		DroneNodes drone = buildDrone(graph);
+		vec3 angles = vec3(rand() % 60 - 30.f, rand() % 360, rand() % 60 - 30.f);
+		setDronePose(graph, drone, benchDronePosition(i), angles, 0.5f + (rand() % 100) / 100.f);
+		setDroneMotorAngle(graph, drone, (float)(rand() % 360));
+	}
+	buildGroundPlane(graph);
+	graph.updateWorldTransforms();
+}
+
+static float maxDifference(const mat4& a, const mat4& b)
+{
+	float difference = 0.f;
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 4; r++)
+			difference = glm::max(difference, glm::abs(a[c][r] - b[c][r]));
+	return difference;
+}
+
+static float maxDifference(const mat3& a, const mat3& b)
+{
+	float difference = 0.f;
+	for (int c = 0; c < 3; c++)
+		for (int r = 0; r < 3; r++)
+			difference = glm::max(difference, glm::abs(a[c][r] - b[c][r]));
+	return difference;
+}
+
+/* Checks the SoA kernels against glm and times them against the per node glm code */
+static void benchmarkTransformSoA()
+{
+	TransformKernel kernels[] = { KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX };
+	mat4 view = lookAt(vec3(0, 2, 0), vec3(3, 1, 4), vec3(0, 1, 0));
+
+	// correctness against glm
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, 100);
+
+		cout << "SoA transforms against glm (max difference)" << endl;
+		for (TransformKernel kernel : kernels)
+		{
+			if (!transformKernelAvailable(kernel))
+				continue;
+
+			TransformSoA transforms;
+			transforms.buildFromSceneGraph(graph);
+			transforms.updateWorld(kernel);
+			transforms.computeModelViewNormal(view, kernel);
+
+			float worldError = 0.f, modelViewError = 0.f, normalError = 0.f;
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+			{
+				const mat4& world = graph.nodes[i].world;
+				size_t slot = transforms.slotOfNode[i];
+				mat3 normalMatrix = transpose(inverse(mat3(view * world)));
+
+				// the normal matrices of the flat parts are large so compare relative to their size
+				float normalScale = glm::max(1.f, maxDifference(normalMatrix, mat3(0.f)));
+
+				worldError = glm::max(worldError, maxDifference(world, transforms.getWorld(slot)));
+				modelViewError = glm::max(modelViewError, maxDifference(view * world, transforms.getModelView(slot)));
+				normalError = glm::max(normalError, maxDifference(normalMatrix, transforms.getNormal(slot)) / normalScale);
+			}
+
+			bool passed = worldError < 1e-4f && modelViewError < 1e-4f && normalError < 1e-4f;
+			cout << setw(8) << transformKernelName(kernel) << scientific << setprecision(2) <<
+				"  world " << worldError << "  model view " << modelViewError << "  normal " << normalError <<
+				"  " << check(passed) << endl;
+		}
+		cout << endl;
+	}
+
+	cout << "transform stage (microseconds per frame)" << endl;
+	cout << setw(8) << "drones" << setw(18) << "glm world" << setw(18) << "glm mv+normal";
+	for (TransformKernel kernel : kernels)
+	{
+		if (transformKernelAvailable(kernel))
+			cout << setw(18) << (string(transformKernelName(kernel)) + " world") << setw(18) << (string(transformKernelName(kernel)) + " mv+normal");
+	}
+	cout << endl;
+
+	int droneCounts[] = { 10, 100, 1000, 10000 };
+	for (int numDrones : droneCounts)
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, numDrones);
+
+		double glmWorldTime = timeRuns([&]()
+		{
+			for (SceneNode& node : graph.nodes)
+				node.dirty = true;
+			graph.updateWorldTransforms();
+			benchSink = graph.nodes.back().world[3][0];
+		});
+
+		vector<mat3> normalMatrices(graph.nodes.size());
+		double glmNormalTime = timeRuns([&]()
+		{
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+				normalMatrices[i] = transpose(inverse(mat3(view * graph.nodes[i].world)));
+			benchSink = normalMatrices.back()[0][0];
+		});
+
+		cout << fixed << setprecision(1) << setw(8) << numDrones << setw(18) << glmWorldTime << setw(18) << glmNormalTime;
+
+		TransformSoA transforms;
+		transforms.buildFromSceneGraph(graph);
+		for (TransformKernel kernel : kernels)
+		{
+			if (!transformKernelAvailable(kernel))
+				continue;
+
+			double worldTime = timeRuns([&]()
+			{
+				transforms.updateWorld(kernel);
+				benchSink = transforms.world[9][0];
+			});
+			double normalTime = timeRuns([&]()
+			{
+				transforms.computeModelViewNormal(view, kernel);
+				benchSink = transforms.normal[0][0];
+			});
+			cout << setw(18) << worldTime << setw(18) << normalTime;
+		}
+		cout << endl;
+	}
+	cout << endl;
+}
+
+/* Compares the analytic normal matrix of rigid nodes with the general inverse, first checking
+   both give the same result */
+static void benchmarkRigidNormals()
+{
+	mat4 view = lookAt(vec3(0, 2, 0), vec3(3, 1, 4), vec3(0, 1, 0));
+	view = rotate(view, radians(30.f), vec3(0, 1, 0));
+	mat3 viewRotation = mat3(view);
+
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, 100);
+
+		// a sheared node and its child have to fall back to the general path
+		int sheared = graph.addNode(-1, vec3(0.f), quat(1.f, 0.f, 0.f, 0.f), vec3(1.f));
+		mat4 shear(1.f);
+		shear[1][0] = 0.5f;
+		graph.setLocalMatrix(sheared, shear);
+		int shearedChild = graph.addNode(sheared, vec3(1.f, 0.f, 0.f), angleAxis(radians(30.f), vec3(0, 0, 1)), vec3(1.f, 2.f, 3.f), MESH_CUBE, MATERIAL_FRAME);
+		graph.updateWorldTransforms();
+
+		int numRigid = 0;
+		float error = 0.f;
+		for (const SceneNode& node : graph.nodes)
+		{
+			if (!node.rigidScale)
+				continue;
+			numRigid++;
+
+			mat3 general = transpose(inverse(mat3(view * node.world)));
+			float normalScale = glm::max(1.f, maxDifference(general, mat3(0.f)));
+			error = glm::max(error, maxDifference(general, rigidNormalMatrix(node, viewRotation)) / normalScale);
+		}
+
+		bool passed = error < 1e-4f && isRotation(viewRotation) && !graph.nodes[sheared].rigidScale && !graph.nodes[shearedChild].rigidScale;
+		cout << "rigid normal matrices against the general inverse" << endl;
+		cout << numRigid << " of " << graph.nodes.size() << " nodes rigid, max difference " << scientific << setprecision(2) << error <<
+			"  " << check(passed) << endl << endl;
+	}
+
+	cout << "normal matrices for every node (microseconds per frame)" << endl;
+	cout << setw(8) << "drones" << setw(14) << "glm inverse" << setw(14) << "SoA batch" << setw(14) << "rigid" << endl;
+
+	int droneCounts[] = { 10, 100, 1000, 10000 };
+	for (int numDrones : droneCounts)
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, numDrones);
+		vector<mat3> normalMatrices(graph.nodes.size());
+
+		double generalTime = timeRuns([&]()
+		{
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+				normalMatrices[i] = transpose(inverse(mat3(view * graph.nodes[i].world)));
+			benchSink = normalMatrices.back()[0][0];
+		});
+
+		// includes copying the world matrices in, as render() has to
+		TransformSoA transforms;
+		transforms.resize(graph.nodes.size());
+		double batchTime = timeRuns([&]()
+		{
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+				transforms.setWorld(i, graph.nodes[i].world);
+			transforms.computeModelViewNormal(view);
+			benchSink = transforms.normal[0][0];
+		});
+
+		double rigidTime = timeRuns([&]()
+		{
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+				normalMatrices[i] = rigidNormalMatrix(graph.nodes[i], viewRotation);
+			benchSink = normalMatrices.back()[0][0];
+		});
+
+		cout << fixed << setprecision(1) << setw(8) << numDrones << setw(14) << generalTime << setw(14) << batchTime << setw(14) << rigidTime << endl;
+	}
+	cout << endl;
+}
+
+/* Random lights spread through the camera frustum, as drone nav lights would be */
+static void randomClusterLights(vector<ClusterLight>& lights, int numLights, float aspect)
+{
+	srand(2);
+	lights.resize(numLights);
+	float tanY = tan(radians(30.f));
+	for (ClusterLight& light : lights)
+	{
+		float depth = 0.5f + 60.f * (float)rand() / RAND_MAX;
+		float sx = 2.f * rand() / RAND_MAX - 1.f;
+		float sy = 2.f * rand() / RAND_MAX - 1.f;
+		light.position = vec3(sx * tanY * aspect * depth, sy * tanY * depth, -depth);
+		light.colour = vec3((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+		light.radius = lightRadius(light.colour);
+	}
+}
+
+static void benchmarkClusteredLights()
+{
+	float aspect = 1024.f / 768.f;
+	LightClusters clusters;
+	clusters.setFrustum(radians(60.f), aspect, 0.1f, 100.f, 1024, 768);
+
+	cout << "clustered light binning, " << clusters.numClusters() << " clusters (microseconds per frame)" << endl;
+	cout << setw(8) << "lights" << setw(14) << "binned" << setw(14) << "brute force" << setw(16) << "lights/cluster" << setw(12) << "max" << endl;
+
+	bool passed = true;
+	int lightCounts[] = { 16, 64, 256, 1024 };
+	for (int numLights : lightCounts)
+	{
+		vector<ClusterLight> lights;
+		randomClusterLights(lights, numLights, aspect);
+
+		// every cluster must get exactly the lights the brute force test gives it, in the same order
+		clusters.assignLightsBruteForce(lights);
+		vector<GLuint> expectedGrid = clusters.grid;
+		vector<GLuint> expectedIndices = clusters.indices;
+		clusters.assignLights(lights);
+		passed = passed && clusters.grid == expectedGrid && clusters.indices == expectedIndices;
+
+		double binnedTime = timeRuns([&]()
+		{
+			clusters.assignLights(lights);
+			benchSink = (float)clusters.indices.size();
+		});
+
+		double bruteForceTime = timeRuns([&]()
+		{
+			clusters.assignLightsBruteForce(lights);
+			benchSink = (float)clusters.indices.size();
+		});
+
+		// the number of lights a fragment shades, against numLights without clustering
+		GLuint maxCount = 0;
+		for (int c = 0; c < clusters.numClusters(); c++)
+			maxCount = glm::max(maxCount, clusters.grid[c * 2 + 1]);
+
+		cout << fixed << setprecision(1) << setw(8) << numLights << setw(14) << binnedTime << setw(14) << bruteForceTime <<
+			setprecision(2) << setw(16) << (double)clusters.indices.size() / clusters.numClusters() << setw(12) << maxCount << endl;
+	}
+
+	// a light sitting across the near plane must still reach the clusters in front of it
+	vector<ClusterLight> nearLight(1);
+	nearLight[0].position = vec3(0.f, 0.f, 0.f);
+	nearLight[0].colour = vec3(1.f);
+	nearLight[0].radius = 1.f;
+	clusters.assignLights(nearLight);
+	passed = passed && clusters.grid[clusters.clusterIndex(clusters.tilesX / 2, clusters.tilesY / 2, 0) * 2 + 1] == 1;
+
+	cout << "binned clusters match brute force  " << check(passed) << endl;
+
+	// no cluster may list more than the cap, even with every light in range of it
+	vector<ClusterLight> lights;
+	randomClusterLights(lights, 4096, aspect);
+	for (ClusterLight& light : lights)
+		light.radius = 200.f;
+	clusters.assignLights(lights);
+	bool capped = clusters.indices.size() <= (size_t)clusters.numClusters() * clusters.maxLightsPerCluster;
+	for (int c = 0; c < clusters.numClusters(); c++)
+		capped = capped && clusters.grid[c * 2 + 1] <= clusters.maxLightsPerCluster;
+	cout << "clusters hold at most " << clusters.maxLightsPerCluster << " lights     " << check(capped) << endl;
+
+	/* Culling keeps the lights that reach into the frustum, even from outside it, and only
+	   the nearest of them once there are too many */
+	vector<ClusterLight> culled(4);
+	for (ClusterLight& light : culled)
+	{
+		light.colour = vec3(1.f);
+		light.radius = 1.f;
+	}
+	culled[0].position = vec3(0.f, 0.f, -20.f);		// in view
+	culled[1].position = vec3(0.f, 0.f, 5.f);		// behind the camera
+	culled[2].position = vec3(0.f, 0.f, -5.f);		// in view and nearer
+	culled[3].position = vec3(tan(radians(30.f)) * aspect * 10.f + 0.5f, 0.f, -10.f);	// just outside, its sphere reaches in
+	clusters.cullLights(culled, 2);
+	bool culledRight = culled.size() == 2 && culled[0].position.z == -5.f && culled[1].position.z == -10.f;
+
+	randomClusterLights(lights, 4096, aspect);
+	clusters.cullLights(lights, 512);
+	culledRight = culledRight && lights.size() == 512;
+	for (size_t l = 1; l < lights.size(); l++)
+		culledRight = culledRight && dot(lights[l - 1].position, lights[l - 1].position) <= dot(lights[l].position, lights[l].position);
+	cout << "culled to the nearest lights in view  " << check(culledRight) << endl << endl;
+}
+
+static void benchmarkShadowCascades()
+{
+	float aspect = 1024.f / 768.f;
+	ShadowCascades cascades;
+	vec3 lightDirection = vec3(0.3f, -1.f, 0.2f);
+
+	// every point of each cascade's slice of the camera frustum has to land inside its shadow map
+	float tanY = tan(radians(30.f));
+	auto containsSlices = [&](const ShadowCascades& fitted, const mat4& view)
+	{
+		mat4 inverseView = inverse(view);
+		bool contained = true;
+		float nearDepth = 0.1f;
+		for (int i = 0; i < fitted.numCascades; i++)
+		{
+			for (int c = 0; c < 8; c++)
+			{
+				float depth = c < 4 ? nearDepth : fitted.splitDepth[i];
+				vec4 corner((c & 1 ? 1.f : -1.f) * tanY * aspect * depth, (c & 2 ? 1.f : -1.f) * tanY * depth, -depth, 1.f);
+				vec4 clip = fitted.lightSpaceMatrix[i] * (inverseView * corner);
+				contained = contained && abs(clip.x) <= 1.f && abs(clip.y) <= 1.f && abs(clip.z) <= 1.f;
+			}
+			nearDepth = fitted.splitDepth[i];
+		}
+		return contained;
+	};
+
+	bool passed = true;
+	srand(3);
+	for (int test = 0; test < 100; test++)
+	{
+		vec3 eye = vec3(20.f * rand() / RAND_MAX - 10.f, 0.5f + 5.f * rand() / RAND_MAX, 20.f * rand() / RAND_MAX - 10.f);
+		vec3 target = vec3(20.f * rand() / RAND_MAX - 10.f, 0.f, 20.f * rand() / RAND_MAX - 10.f);
+		mat4 view = lookAt(eye, target, vec3(0, 1, 0));
+		cascades.fit(view, radians(60.f), aspect, 0.1f, lightDirection);
+		passed = passed && containsSlices(cascades, view);
+	}
+
+	mat4 view = lookAt(vec3(0, 2, 0), vec3(3, 1, 4), vec3(0, 1, 0));
+	double fitTime = timeRuns([&]()
+	{
+		cascades.fit(view, radians(60.f), aspect, 0.1f, lightDirection);
+		benchSink = cascades.lightSpaceMatrix[0][0][0];
+	});
+
+	// the depth texels that are stored and cleared each frame, against the single 4096x4096 map
+	double singleTexels = 4096.0 * 4096.0;
+	double cascadeTexels = (double)cascades.numCascades * cascades.resolution * cascades.resolution;
+	cout << "shadow cascades, " << cascades.numCascades << " x " << cascades.resolution << "x" << cascades.resolution << endl;
+	cout << "splits at";
+	for (int i = 0; i < cascades.numCascades; i++)
+		cout << " " << fixed << setprecision(2) << cascades.splitDepth[i];
+	cout << ", fitting takes " << setprecision(2) << fitTime << " microseconds" << endl;
+	cout << "depth memory " << setprecision(1) << cascadeTexels * 4.0 / (1024.0 * 1024.0) << " MB against " << singleTexels * 4.0 / (1024.0 * 1024.0) << " MB" << endl << endl;
+
+	/* The static shadow cache is kept while a cascade's light space matrix stays the same. Ten
+	   seconds of the view mode orbit around the drone, at the speed it starts at and ten times
+	   that, with and without the refit margin. The slices have to stay inside the kept cascades */
+	cout << "cascades kept (static shadow cache hits) over 600 ticks of the view mode orbit" << endl;
+	cout << setw(14) << "degrees/tick" << setw(10) << "margin" << setw(10) << "kept" << setw(10) << "refitted" << endl;
+	float defaultKept = 0.f;
+	for (float turn : { 0.05f, 0.5f })
+	{
+		for (float margin : { 0.f, cascades.refitMargin })
+		{
+			ShadowCascades orbit;
+			orbit.refitMargin = margin;
+			int kept = 0, refitted = 0;
+			mat4 previous[maxShadowCascades];
+			for (int tick = 0; tick <= 600; tick++)
+			{
+				mat4 orbitView = rotate(lookAt(vec3(0, 0, -4), vec3(0.f), vec3(0, 1, 0)), radians(turn * tick), vec3(0, 1, 0));
+				orbit.fit(orbitView, radians(60.f), aspect, 0.1f, vec3(4.f, -4.f, 4.f));
+				passed = passed && containsSlices(orbit, orbitView);
+				for (int i = 0; i < orbit.numCascades; i++)
+				{
+					if (tick > 0 && orbit.lightSpaceMatrix[i] == previous[i])
+						kept++;
+					else if (tick > 0)
+						refitted++;
+					previous[i] = orbit.lightSpaceMatrix[i];
+				}
+			}
+			if (turn == 0.05f && margin > 0.f)
+				defaultKept = (float)kept / (kept + refitted);
+			cout << fixed << setprecision(2) << setw(14) << turn << setw(10) << margin << setw(10) << kept << setw(10) << refitted << endl;
+		}
+	}
+
+	cout << "cascades contain their frustum slices  " << check(passed) << endl;
+	cout << "over 90% of the cascades kept at the starting orbit speed  " << check(defaultKept > 0.9f) << endl << endl;
+}
+
+static void benchmarkCulling()
+{
+	// the unit cube and tube both fit in a unit box, the sphere has radius 1
+	BoundingSphere meshBounds[NUM_MESHES];
+	for (int m = 0; m < NUM_MESHES; m++)
+		meshBounds[m] = sphereFromBox(vec3(-0.5f), vec3(0.5f));
+	meshBounds[MESH_SPHERE] = sphereFromBox(vec3(-1.f), vec3(1.f));
+
+	// looking along the rows of drones laid out by benchDronePosition
+	mat4 viewProjection = perspective(radians(60.f), 1024.f / 768.f, 0.1f, 100.f) * lookAt(vec3(0, 2, 0), vec3(3, 1, -40), vec3(0, 1, 0));
+	Frustum frustum = frustumFromMatrix(viewProjection);
+
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, 1000);
+		SceneBounds bounds;
+		bounds.update(graph, meshBounds);
+
+		// every node's sphere has to hold its mesh's sphere and all of its children's
+		bool contained = true;
+		for (size_t i = 0; i < graph.nodes.size(); i++)
+		{
+			BoundingSphere sphere = bounds.getSphere(i);
+			int parent = graph.nodes[i].parent;
+			if (parent >= 0 && sphere.radius >= 0.f)
+			{
+				BoundingSphere parentSphere = bounds.getSphere(parent);
+				contained = contained && length(sphere.centre - parentSphere.centre) + sphere.radius <= parentSphere.radius * 1.0001f;
+			}
+		}
+
+		// the SIMD kernels must agree with scalar, and the hierarchy must only hide parts that are outside themselves
+		bounds.cull(graph, frustum, KERNEL_SCALAR);
+		vector<float> scalarDistance = bounds.distance;
+		vector<char> hierarchical = bounds.visible;
+		float kernelError = 0.f;
+		for (TransformKernel kernel : { KERNEL_SSE, KERNEL_AVX })
+		{
+			bounds.cull(graph, frustum, kernel);
+			for (size_t i = 0; i < bounds.size(); i++)
+				kernelError = glm::max(kernelError, abs(bounds.distance[i] - scalarDistance[i]));
+		}
+
+		int numVisible = 0, wrong = 0;
+		for (size_t i = 0; i < graph.nodes.size(); i++)
+		{
+			const SceneNode& node = graph.nodes[i];
+			if (node.mesh < 0)
+				continue;
+			bool own = scalarDistance[i] >= 0.f;
+			wrong += own != (hierarchical[i] != 0);
+			numVisible += hierarchical[i] != 0;
+		}
+
+		bool passed = contained && kernelError < 1e-3f && wrong == 0;
+		cout << "frustum culling" << endl;
+		cout << numVisible << " of " << graph.nodes.size() << " nodes visible, kernel difference " << scientific << setprecision(2) << kernelError <<
+			"  " << check(passed) << endl << endl;
+	}
+
+	cout << "bounds update and culling for every node (microseconds per frame)" << endl;
+	cout << setw(8) << "drones" << setw(14) << "bounds";
+	for (TransformKernel kernel : { KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX })
+	{
+		if (transformKernelAvailable(kernel))
+			cout << setw(14) << transformKernelName(kernel);
+	}
+	cout << endl;
+
+	int droneCounts[] = { 10, 100, 1000, 10000 };
+	for (int numDrones : droneCounts)
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, numDrones);
+		SceneBounds bounds;
+
+		double updateTime = timeRuns([&]()
+		{
+			bounds.update(graph, meshBounds);
+			benchSink = bounds.radius[0];
+		});
+		cout << fixed << setprecision(1) << setw(8) << numDrones << setw(14) << updateTime;
+
+		for (TransformKernel kernel : { KERNEL_SCALAR, KERNEL_SSE, KERNEL_AVX })
+		{
+			if (!transformKernelAvailable(kernel))
+				continue;
+			double cullTime = timeRuns([&]()
+			{
+				bounds.cull(graph, frustum, kernel);
+				benchSink = bounds.distance[0];
+			});
+			cout << setw(14) << cullTime;
+		}
+		cout << endl;
+	}
+	cout << endl;
+}
+
+/* How many mesh binds and material uploads the render queue saves over drawing in scene graph order */
+static void benchmarkRenderQueue()
+{
+	mat4 view = lookAt(vec3(0, 2, 0), vec3(3, 1, -40), vec3(0, 1, 0));
+
+	cout << "render queue state changes per frame, scene order against sorted" << endl;
+	cout << setw(8) << "drones" << setw(10) << "parts" << setw(14) << "binds" << setw(14) << "sorted" <<
+		setw(14) << "materials" << setw(14) << "sorted" << setw(14) << "build+sort" << endl;
+
+	int droneCounts[] = { 1, 10, 100, 1000, 10000 };
+	for (int numDrones : droneCounts)
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, numDrones);
+		RenderQueue queue;
+
+		auto buildQueue = [&]()
+		{
+			queue.clear();
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+			{
+				const SceneNode& node = graph.nodes[i];
+				if (node.mesh < 0)
+					continue;
+				float depth = -(view * node.world[3]).z;
+				queue.add(makeSortKey(0, node.mesh, node.material, depth, 100.f), (int)i, (int)queue.packets.size());
+			}
+		};
+
+		buildQueue();
+		unsigned int sceneBinds, sceneMaterials;
+		queue.countStateChanges(sceneBinds, sceneMaterials);
+
+		queue.sort();
+		unsigned int sortedBinds, sortedMaterials;
+		queue.countStateChanges(sortedBinds, sortedMaterials);
+
+		// the sort must keep every packet and leave the keys in order
+		bool ordered = true;
+		for (size_t i = 1; i < queue.packets.size(); i++)
+			ordered = ordered && queue.packets[i - 1].key <= queue.packets[i].key;
+		bool passed = ordered && sortedBinds <= sceneBinds && sortedMaterials <= sceneMaterials;
+
+		double buildTime = timeRuns([&]()
+		{
+			buildQueue();
+			queue.sort();
+			benchSink = (float)queue.packets[0].node;
+		});
+
+		cout << fixed << setprecision(1) << setw(8) << numDrones << setw(10) << queue.packets.size() <<
+			setw(14) << sceneBinds << setw(14) << sortedBinds << setw(14) << sceneMaterials << setw(14) << sortedMaterials <<
+			setw(14) << buildTime << "  " << check(passed) << endl;
+	}
+	cout << "build+sort in microseconds" << endl << endl;
+}
+
+/* Size and accuracy of the interleaved vertex formats, on vertices like the tube's */
+static void benchmarkVertexFormats()
+{
+	const int numVertices = 8 * 40;
+	vector<GLfloat> positions(numVertices * 3), normals(numVertices * 3), colours(numVertices * 4, 1.f);
+	srand(1);
+	for (int i = 0; i < numVertices; i++)
+	{
+		float angle = radians(360.f * i / numVertices);
+		float r = 0.05f + (rand() % 1000) / 2222.f;
+		positions[i * 3] = r * sin(angle);
+		positions[i * 3 + 1] = r * cos(angle);
+		positions[i * 3 + 2] = (i & 1) ? 0.5f : -0.5f;
+		vec3 normal = normalize(vec3(rand() % 200 - 100.f, rand() % 200 - 100.f, rand() % 200 - 99.5f));
+		normals[i * 3] = normal.x;
+		normals[i * 3 + 1] = normal.y;
+		normals[i * 3 + 2] = normal.z;
+	}
+
+	cout << "vertex formats, " << numVertices << " tube vertices (separate float buffers use 40 bytes a vertex)" << endl;
+	cout << setw(24) << "format" << setw(10) << "bytes" << setw(14) << "position err" << setw(14) << "normal err" << setw(14) << "interleave" << endl;
+
+	struct NamedFormat { const char* name; VertexFormat format; };
+	NamedFormat formats[] =
+	{
+		{ "float, colour", { false, true } },
+		{ "float, no colour", { false, false } },
+		{ "half, colour", { true, true } },
+		{ "half, no colour", { true, false } },
+	};
+
+	for (const NamedFormat& named : formats)
+	{
+		const VertexFormat& format = named.format;
+		vector<unsigned char> vertices;
+		interleaveVertices(format, &positions[0], &normals[0], &colours[0], numVertices, vertices);
+
+		// unpack again the way GL would and compare
+		float positionError = 0.f, normalError = 0.f;
+		for (int i = 0; i < numVertices; i++)
+		{
+			const unsigned char* vertex = &vertices[(size_t)i * format.stride()];
+			for (int c = 0; c < 3; c++)
+			{
+				float value;
+				if (format.halfPositions)
+				{
+					GLushort half;
+					memcpy(&half, vertex + c * 2, sizeof(half));
+					value = halfToFloat(half);
+				}
+				else
+				{
+					memcpy(&value, vertex + c * 4, sizeof(value));
+				}
+				positionError = glm::max(positionError, abs(value - positions[i * 3 + c]));
+			}
+
+			GLuint packed;
+			memcpy(&packed, vertex + format.normalOffset(), sizeof(packed));
+			for (int c = 0; c < 3; c++)
+			{
+				int value = (int)((packed >> (c * 10)) & 0x3ff);
+				if (value >= 512)
+					value -= 1024;
+				normalError = glm::max(normalError, abs(glm::max(value / 511.f, -1.f) - normals[i * 3 + c]));
+			}
+		}
+
+		double interleaveTime = timeRuns([&]()
+		{
+			interleaveVertices(format, &positions[0], &normals[0], &colours[0], numVertices, vertices);
+			benchSink = vertices[0];
+		});
+
+		// half precision is about 1/2048 relative, the normals have 1/511 steps
+		bool passed = positionError <= (format.halfPositions ? 0.5f / 2048.f : 0.f) && normalError <= 1.f / 511.f;
+		cout << setw(24) << named.name << setw(10) << format.stride() << scientific << setprecision(2) << setw(14) << positionError <<
+			setw(14) << normalError << fixed << setprecision(1) << setw(14) << interleaveTime << "  " << check(passed) << endl;
+	}
+	cout << "interleave in microseconds" << endl << endl;
+}
+
+/* Triangle list indices of a latitude/longitude sphere, with rows of longitudes + 1 vertices
+   from pole to pole. The Sphere class isn't available without GL, this has the same layout */
+static void uvSphereIndices(int latitudes, int longitudes, vector<GLuint>& indices)
+{
+	indices.clear();
+	int row = longitudes + 1;
+	for (int lat = 0; lat < latitudes; lat++)
+	{
+		for (int lon = 0; lon < longitudes; lon++)
+		{
+			GLuint a = lat * row + lon, b = a + 1, c = a + row, d = c + 1;
+			indices.insert(indices.end(), { a, c, b, b, c, d });
+		}
+	}
+}
+
+/* Average cache miss ratio of the meshes before and after vertex cache optimisation */
+static void benchmarkVertexCache()
+{
+	struct MeshIndices { string name; vector<GLuint> indices; int numVertices; };
+	vector<MeshIndices> meshes;
+
+	// the cube drawn without indices shades every one of its 36 vertices
+	vector<GLuint> unindexed(36);
+	for (GLuint i = 0; i < 36; i++)
+		unindexed[i] = i;
+	meshes.push_back({ "cube, unindexed", unindexed, 36 });
+
+	vector<GLfloat> positions, normals, colours;
+	vector<GLushort> cubeIndices;
+	Cubev2::makeIndexedCube(positions, normals, colours, cubeIndices);
+	meshes.push_back({ "cube, indexed", vector<GLuint>(cubeIndices.begin(), cubeIndices.end()), (int)positions.size() / 3 });
+
+	for (int segments : { 15, 40 })
+	{
+		vector<GLuint> strips, triangles;
+		Tube::makeStripIndices(segments, strips);
+		int stripLength = segments * 2 + 2;
+		for (int s = 0; s < 4; s++)
+			stripToTriangles(&strips[s * stripLength], stripLength, triangles);
+		meshes.push_back({ "tube " + to_string(segments), triangles, 8 * segments });
+	}
+
+	vector<GLuint> sphereIndices;
+	uvSphereIndices(20, 20, sphereIndices);
+	meshes.push_back({ "sphere 20x20", sphereIndices, 21 * 21 });
+
+	cout << "vertex cache miss ratio (vertices shaded per triangle), FIFO cache" << endl;
+	cout << setw(18) << "mesh" << setw(10) << "vertices" << setw(11) << "triangles" << setw(12) << "16 entries" << setw(12) << "optimised" <<
+		setw(12) << "32 entries" << setw(12) << "optimised" << endl;
+
+	for (const MeshIndices& mesh : meshes)
+	{
+		vector<GLuint> optimised = mesh.indices;
+		optimizeVertexCache(optimised, mesh.numVertices);
+
+		// the optimised order must draw exactly the same triangles
+		vector<vector<GLuint>> before, after;
+		for (size_t t = 0; t < mesh.indices.size(); t += 3)
+		{
+			before.push_back(vector<GLuint>(mesh.indices.begin() + t, mesh.indices.begin() + t + 3));
+			after.push_back(vector<GLuint>(optimised.begin() + t, optimised.begin() + t + 3));
+		}
+		sort(before.begin(), before.end());
+		sort(after.begin(), after.end());
+
+		float acmr16 = vertexCacheACMR(mesh.indices, mesh.numVertices, 16);
+		float optimised16 = vertexCacheACMR(optimised, mesh.numVertices, 16);
+		float acmr32 = vertexCacheACMR(mesh.indices, mesh.numVertices, 32);
+		float optimised32 = vertexCacheACMR(optimised, mesh.numVertices, 32);
+		bool passed = before == after && optimised16 <= acmr16 + 0.05f;
+
+		cout << setw(18) << mesh.name << setw(10) << mesh.numVertices << setw(11) << mesh.indices.size() / 3 << fixed << setprecision(3) <<
+			setw(12) << acmr16 << setw(12) << optimised16 << setw(12) << acmr32 << setw(12) << optimised32 << "  " << check(passed) << endl;
+	}
+	cout << endl;
+}
+
+/* Triangles submitted for a swarm of drones with and without levels of detail */
+static void benchmarkLod()
+{
+	// bounds and levels as set up in main, with the drone's tube segment counts
+	BoundingSphere meshBounds[NUM_MESHES];
+	for (int m = 0; m < NUM_MESHES; m++)
+		meshBounds[m] = sphereFromBox(vec3(-0.5f), vec3(0.5f));
+	meshBounds[MESH_SPHERE] = sphereFromBox(vec3(-1.f), vec3(1.f));
+	int meshLevels[NUM_MESHES];
+	for (int m = 0; m < NUM_MESHES; m++)
+		meshLevels[m] = m == MESH_CUBE ? 1 : maxLods;
+
+	// a tube has 8 triangles a segment and the sphere 2 a quad
+	auto meshTriangles = [](int mesh, int lod)
+	{
+		switch (mesh)
+		{
+		case MESH_CUBE: return 12;
+		case MESH_TUBE: return 8 * lodSegments(15, lod, 6);
+		case MESH_SPHERE: { int rings = lodSegments(20, lod, 4); return 2 * rings * rings; }
+		default: return 8 * lodSegments(40, lod, 6);
+		}
+	};
+
+	// the hysteresis must stop a part on a threshold switching back and forth
+	LodSettings settings = defaultLodSettings;
+	int lod = selectLod(settings, maxLods, 100.f, 0);
+	int switches = 0;
+	for (int frame = 0; frame < 100; frame++)
+	{
+		float size = settings.minScreenSize[1] * (frame & 1 ? 1.1f : 0.9f);
+		int next = selectLod(settings, maxLods, size, lod);
+		switches += next != lod;
+		lod = next;
+	}
+	bool hysteresisPassed = switches <= 1;
+
+	vec3 cameraPosition(0.f, 2.f, 0.f);
+	float pixelsPerUnit = 768.f / (2.f * tan(radians(30.f)));
+
+	cout << "levels of detail for a swarm seen from " << cameraPosition.x << "," << cameraPosition.y << "," << cameraPosition.z <<
+		", hysteresis  " << check(hysteresisPassed) << endl;
+	cout << setw(8) << "drones" << setw(14) << "triangles" << setw(14) << "with LOD" << setw(10) << "ratio" <<
+		setw(14) << "select" << setw(14) << "Mtri/s" << setw(14) << "with LOD" << endl;
+
+	int droneCounts[] = { 10, 100, 1000, 10000 };
+	for (int numDrones : droneCounts)
+	{
+		SceneGraph graph;
+		buildRandomDrones(graph, numDrones);
+		LodSelector selector;
+
+		double selectTime = timeRuns([&]()
+		{
+			selector.update(graph, meshBounds, meshLevels, cameraPosition, pixelsPerUnit);
+			benchSink = selector.levels[0];
+		});
+
+		size_t fullTriangles = 0, lodTriangles = 0;
+		for (size_t i = 0; i < graph.nodes.size(); i++)
+		{
+			int mesh = graph.nodes[i].mesh;
+			if (mesh < 0)
+				continue;
+			fullTriangles += meshTriangles(mesh, 0);
+			lodTriangles += meshTriangles(mesh, selector.levels[i]);
+		}
+
+		/* A CPU transform of every submitted triangle's vertices stands in for the vertex
+		   work saved, so the throughput is comparable between the two */
+		auto transformTriangles = [&](bool useLod)
+		{
+			vec4 sum(0.f);
+			for (size_t i = 0; i < graph.nodes.size(); i++)
+			{
+				const SceneNode& node = graph.nodes[i];
+				if (node.mesh < 0)
+					continue;
+				int triangles = meshTriangles(node.mesh, useLod ? selector.levels[i] : 0);
+				for (int t = 0; t < triangles; t++)
+					sum += node.world * vec4((float)t, 0.5f, -0.5f, 1.f);
+			}
+			benchSink = sum.x;
+		};
+		double fullTime = timeRuns([&]() { transformTriangles(false); });
+		double lodTime = timeRuns([&]() { transformTriangles(true); });
+
+		cout << fixed << setprecision(1) << setw(8) << numDrones << setw(14) << fullTriangles << setw(14) << lodTriangles <<
+			setprecision(2) << setw(10) << (double)lodTriangles / fullTriangles << setprecision(1) << setw(14) << selectTime <<
+			setw(14) << fullTriangles / fullTime << setw(14) << fullTriangles / lodTime << endl;
+	}
+	cout << "select in microseconds, Mtri/s is full-detail triangles covered per second" << endl << endl;
+}
+
+/* The tube generator as it was before generateTube, one sin and cos per vertex and fresh
+   arrays for every tube, kept to check the new one against */
+static void referenceTube(int numSegments, float thickness, vector<GLfloat>& positions, vector<GLfloat>& normals, vector<GLfloat>& colours)
+{
+	int numvertices = 8 * numSegments;
+	GLfloat* pVertices = new GLfloat[numvertices * 3];
+	GLfloat* pNormals = new GLfloat[numvertices * 3];
+	GLfloat* pColours = new GLfloat[numvertices * 4];
+
+	float segmentAngleIncrement = (2 * 3.14159265358979f) / numSegments;
+	int numVerticesPerSection = (numSegments * 2);
+	for (int i = 0; i < numSegments; i++)
+	{
+		pVertices[i * 6] = 0.5f * ::sin(segmentAngleIncrement * i);
+		pVertices[(i * 6) + 1] = 0.5f * ::cos(segmentAngleIncrement * i);
+		pVertices[(i * 6) + 2] = 0.5f;
+		pVertices[(i * 6) + 3] = (0.5f - (thickness * 0.5f)) * ::sin(segmentAngleIncrement * i);
+		pVertices[(i * 6) + 4] = (0.5f - (thickness * 0.5f)) * ::cos(segmentAngleIncrement * i);
+		pVertices[(i * 6) + 5] = 0.5f;
+	}
+	for (int i = 0; i < numSegments * 6; i++)
+		pVertices[(numVerticesPerSection * 3) + i] = i % 3 != 2 ? pVertices[i] : -pVertices[i];
+	for (int i = 0; i < numSegments; i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + k] = pVertices[(i * 6) + k];
+			pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + 3 + k] = pVertices[(numVerticesPerSection * 3) + (i * 6) + k];
+			pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + k] = pVertices[(i * 6) + 3 + k];
+			pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + 3 + k] = pVertices[(numVerticesPerSection * 3) + (i * 6) + 3 + k];
+		}
+	}
+	for (int i = 0; i < numvertices; i++)
+	{
+		pColours[i * 4] = pVertices[i * 3];
+		pColours[i * 4 + 1] = pVertices[i * 3 + 1];
+		pColours[i * 4 + 2] = pVertices[i * 3 + 2];
+		pColours[i * 4 + 3] = 1.f;
+	}
+	for (int i = 0; i < numvertices / 2; i++)
+	{
+		pNormals[i * 3] = 0;
+		pNormals[(i * 3) + 1] = 0;
+		pNormals[(i * 3) + 2] = pVertices[(i * 3) + 2];
+	}
+	for (int i = numvertices / 2; i < numvertices; i++)
+	{
+		pNormals[i * 3] = pVertices[(i * 3)];
+		pNormals[(i * 3) + 1] = pVertices[(i * 3) + 1];
+		pNormals[(i * 3) + 2] = 0;
+	}
+
+	positions.assign(pVertices, pVertices + numvertices * 3);
+	normals.assign(pNormals, pNormals + numvertices * 3);
+	colours.assign(pColours, pColours + numvertices * 4);
+	delete[] pVertices;
+	delete[] pNormals;
+	delete[] pColours;
+}
+
+/* Tubes generated per second by the old and new generators, which must give identical vertices */
+static void benchmarkTubeGeneration()
+{
+	cout << "tube generation (thousand tubes per second)" << endl;
+	cout << setw(10) << "segments" << setw(14) << "reference" << setw(14) << "generator" << setw(10) << "speedup" << endl;
+
+	for (int segments : { 6, 15, 40, 128 })
+	{
+		// every thickness used by the drone, and the clamped ends
+		bool identical = true;
+		for (float thickness : { 0.f, 0.1f, 0.7f, 0.85f, 1.f })
+		{
+			vector<GLfloat> positions, normals, colours;
+			referenceTube(segments, thickness, positions, normals, colours);
+			TubeGenerator generator;
+			generator.generate(segments, thickness);
+			identical = identical && generator.positions == positions && generator.normals == normals && generator.colours == colours;
+		}
+
+		vector<GLfloat> positions, normals, colours;
+		double referenceTime = timeRuns([&]()
+		{
+			referenceTube(segments, 0.1f, positions, normals, colours);
+			benchSink = positions[3];
+		});
+
+		TubeGenerator generator;
+		double generatorTime = timeRuns([&]()
+		{
+			generator.generate(segments, 0.1f);
+			benchSink = generator.positions[3];
+		});
+
+		cout << fixed << setprecision(1) << setw(10) << segments << setw(14) << 1e3 / referenceTime << setw(14) << 1e3 / generatorTime <<
+			setprecision(2) << setw(10) << referenceTime / generatorTime << "  " << check(identical) << endl;
+	}
+	cout << endl;
+}
+
+/* Compares a compile time tube with the runtime generator. The trig isn't the same code, so
+   the floats may be a unit in the last place apart, the indices have to be identical */
+static bool checkUnitTube(const UnitTubeTable& table, int& exactValues, int& totalValues, float& maxError)
+{
+	TubeGenerator generator;
+	generator.generate(table.numSegments, table.thickness);
+	const GLfloat* runtime[3] = { generator.positions.data(), generator.normals.data(), generator.colours.data() };
+	const GLfloat* compiled[3] = { table.positions, table.normals, table.colours };
+	int sizes[3] = { (int)generator.positions.size(), (int)generator.normals.size(), (int)generator.colours.size() };
+
+	for (int a = 0; a < 3; a++)
+	{
+		for (int i = 0; i < sizes[a]; i++)
+		{
+			float error = fabs(runtime[a][i] - compiled[a][i]);
+			maxError = std::max(maxError, error);
+			exactValues += error == 0.f;
+			totalValues++;
+		}
+	}
+
+	vector<GLuint> indices;
+	Tube::makeStripIndices(table.numSegments, indices);
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] != table.indices[i])
+			return false;
+	}
+	return true;
+}
+
+/* The compile time tubes against the runtime generator, and how long generating them would take */
+static void benchmarkUnitTubes()
+{
+	cout << "compile time tubes" << endl;
+	cout << setw(10) << "segments" << setw(11) << "thickness" << setw(10) << "exact" << setw(13) << "max error" << setw(16) << "generate (us)" << endl;
+
+	// one that isn't in the table, built here
+	static constexpr UnitTube<64, 250> extraTube;
+	static_assert(extraTube.positions[2] == 0.5f && extraTube.indices[UnitTube<64, 250>::numIndices - 1] == 3 * 128 + 1, "compile time tube");
+
+	vector<UnitTubeTable> tables(unitTubeTables, unitTubeTables + numUnitTubeTables);
+	tables.push_back(unitTubeTable(extraTube));
+
+	for (const UnitTubeTable& table : tables)
+	{
+		int exactValues = 0, totalValues = 0;
+		float maxError = 0.f;
+		bool ok = checkUnitTube(table, exactValues, totalValues, maxError) && maxError <= 1e-6f;
+
+		TubeGenerator generator;
+		double generateTime = timeRuns([&]()
+		{
+			generator.generate(table.numSegments, table.thickness);
+			benchSink = generator.positions[3];
+		});
+
+		cout << fixed << setw(10) << table.numSegments << setprecision(3) << setw(11) << table.thickness <<
+			setw(6) << exactValues << "/" << setw(4) << left << totalValues << right << setprecision(1) << scientific << setw(12) << maxError <<
+			fixed << setprecision(2) << setw(16) << generateTime << "  " << check(ok) << endl;
+	}
+
+	bool found = findUnitTube(15, 0.1f) == &unitTubeTables[0] && findUnitTube(16, 0.1f) == NULL;
+	cout << "table lookup  " << check(found) << endl << endl;
+}
+
+/* One drone as the globals in main used to hold it */
+struct ScalarDrone
+{
+	float x, y, z;
+	float moveX, moveY, moveZ;
+	float modelAngle_x, modelAngle_y, modelAngle_z;
+	float motorAngle;
+};
+
+/* The fly mode update from the end of the old display(), for one drone */
+static void scalarDroneUpdate(ScalarDrone& d, const FlightLimits& limits)
+{
+	float minmaxXZ = limits.minmaxXZ, maxY = limits.maxY, minY = limits.minY, minYFly = limits.minYFly;
+	float modelAngleChange = limits.tiltChange;
+
+	if (d.moveY > 0 && d.y < maxY)
+		d.y += d.moveY;
+	else if (d.moveY < 0 && d.y > minY)
+		d.y += d.moveY;
+
+	if (d.moveZ > 0 && d.z < minmaxXZ && d.y > minYFly)
+	{
+		d.z += d.moveZ;
+		d.modelAngle_x = glm::max(-30.f, d.modelAngle_x - modelAngleChange);
+	}
+	else if (d.moveZ < 0 && d.z > -minmaxXZ && d.y > minYFly)
+	{
+		d.z += d.moveZ;
+		d.modelAngle_x = glm::min(30.f, d.modelAngle_x + modelAngleChange);
+	}
+	else
+	{
+		if (d.modelAngle_x > 0)
+			d.modelAngle_x -= modelAngleChange;
+		if (d.modelAngle_x < 0)
+			d.modelAngle_x += modelAngleChange;
+	}
+
+	if (d.moveX > 0 && d.x < minmaxXZ && d.y > minYFly)
+	{
+		d.x += d.moveX;
+		d.modelAngle_z = glm::min(30.f, d.modelAngle_z + modelAngleChange);
+	}
+	else if (d.moveX < 0 && d.x > -minmaxXZ && d.y > minYFly)
+	{
+		d.x += d.moveX;
+		d.modelAngle_z = glm::max(-30.f, d.modelAngle_z - modelAngleChange);
+	}
+	else
+	{
+		if (d.modelAngle_z > 0)
+			d.modelAngle_z -= modelAngleChange;
+		if (d.modelAngle_z < 0)
+			d.modelAngle_z += modelAngleChange;
+	}
+
+	if (d.y > minY)
+		d.motorAngle += 47;
+	if (d.motorAngle > 360)
+		d.motorAngle -= 360;
+}
+
+static void copySwarmToScalar(const DroneSwarm& swarm, vector<ScalarDrone>& drones)
+{
+	drones.resize(swarm.size());
+	for (size_t i = 0; i < swarm.size(); i++)
+	{
+		ScalarDrone& d = drones[i];
+		d.x = swarm.positionX[i]; d.y = swarm.positionY[i]; d.z = swarm.positionZ[i];
+		d.moveX = swarm.velocityX[i]; d.moveY = swarm.velocityY[i]; d.moveZ = swarm.velocityZ[i];
+		d.modelAngle_x = swarm.pitch[i]; d.modelAngle_y = swarm.yaw[i]; d.modelAngle_z = swarm.roll[i];
+		d.motorAngle = swarm.propAngle[i];
+	}
+}
+
+/* Drones simulated per millisecond by the old one drone update run over an array of drones,
+   and by the swarm's batch update with the scalar and widest kernels. They all have to fly the
+   drones to the same place */
+static void benchmarkSwarm()
+{
+	cout << "swarm update (drones per millisecond)" << endl;
+	cout << setw(10) << "drones" << setw(14) << "one by one" << setw(14) << "swarm scalar" << setw(14) << transformKernelName(KERNEL_BEST) << setw(10) << "speedup" << endl;
+
+	for (int numDrones : { 1000, 10000, 100000 })
+	{
+		DroneSwarm swarm;
+		swarm.resize(numDrones);
+		swarm.scatter(0, 1234);
+		// some drones climbing or coming down, and some sat on the ground
+		for (int i = 0; i < numDrones; i += 7)
+			swarm.velocityY[i] = i % 2 ? 0.02f : -0.02f;
+		for (int i = 3; i < numDrones; i += 11)
+			swarm.positionY[i] = defaultFlightLimits.minY;
+
+		vector<ScalarDrone> drones;
+		copySwarmToScalar(swarm, drones);
+
+		// check the two agree over a few hundred steps, steering the scalar drones from the swarm's velocities
+		DroneSwarm scalarSwarm = swarm;
+		bool identical = true;
+		for (int step = 0; step < 300 && identical; step++)
+		{
+			swarm.steer(0, swarm.size());
+			swarm.update();
+			scalarSwarm.steer(0, scalarSwarm.size());
+			scalarSwarm.update(defaultFlightLimits, KERNEL_SCALAR);
+			for (int i = 0; i < numDrones; i++)
+			{
+				ScalarDrone& d = drones[i];
+				d.moveX = swarm.velocityX[i];
+				d.moveZ = swarm.velocityZ[i];
+				scalarDroneUpdate(d, defaultFlightLimits);
+				identical = identical && d.x == swarm.positionX[i] && d.y == swarm.positionY[i] && d.z == swarm.positionZ[i] &&
+					d.modelAngle_x == swarm.pitch[i] && d.modelAngle_z == swarm.roll[i] && d.motorAngle == swarm.propAngle[i];
+			}
+		}
+		identical = identical && scalarSwarm.positionX == swarm.positionX && scalarSwarm.positionY == swarm.positionY &&
+			scalarSwarm.positionZ == swarm.positionZ && scalarSwarm.pitch == swarm.pitch && scalarSwarm.roll == swarm.roll;
+
+		double scalarTime = timeRuns([&]()
+		{
+			for (ScalarDrone& d : drones)
+				scalarDroneUpdate(d, defaultFlightLimits);
+			benchSink = drones.back().x;
+		});
+
+		double swarmScalarTime = timeRuns([&]()
+		{
+			swarm.update(defaultFlightLimits, KERNEL_SCALAR);
+			benchSink = swarm.positionX.back();
+		});
+
+		double swarmTime = timeRuns([&]()
+		{
+			swarm.update();
+			benchSink = swarm.positionX.back();
+		});
+
+		cout << fixed << setprecision(0) << setw(10) << numDrones << setw(14) << numDrones * 1e3 / scalarTime <<
+			setw(14) << numDrones * 1e3 / swarmScalarTime << setw(14) << numDrones * 1e3 / swarmTime <<
+			setprecision(2) << setw(10) << scalarTime / swarmTime << "  " << check(identical) << endl;
+	}
+	cout << endl;
+}
+
+/* A swarm with the first numDrawn drones in a scene graph, as main builds it */
+static void buildBenchSwarm(int numDrones, int numDrawn, DroneSwarm& swarm, SceneGraph& graph, vector<DroneNodes>& drones)
+{
+	graph.clear();
+	drones.clear();
+	for (int i = 0; i < numDrawn; i++)
+		drones.push_back(buildDrone(graph));
+	buildGroundPlane(graph);
+	graph.updateWorldTransforms();
+
+	swarm.resize(numDrones);
+	swarm.scatter(0, 4321);
+}
+
+/* One frame of the swarm on the job system */
+static void runSwarmFrame(JobSystem& jobs, DroneSwarm& swarm, SceneGraph& graph, const vector<DroneNodes>& drones)
+{
+	jobs.wait(scheduleSwarmFrame(jobs, swarm, 0, defaultFlightLimits, 1, 1.f, graph, drones, 1.f, 0.3f));
+	jobs.clear();
+}
+
+/* Frame time of the swarm update and transform propagation on 1 to N threads. Every thread
+   count has to give the same drones and world matrices as one thread does */
+static void benchmarkJobs()
+{
+	const int numDrones = 100000, numDrawn = 2000, checkFrames = 20;
+	// at least two so the threaded path is always checked
+	int maxThreads = std::max((int)thread::hardware_concurrency(), 2);
+
+	cout << "swarm frame on the job system, " << numDrones << " drones with " << numDrawn << " in the scene graph" << endl;
+	cout << setw(10) << "threads" << setw(14) << "frame (ms)" << setw(14) << "drones/ms" << setw(10) << "speedup" << setw(10) << "stolen" << endl;
+
+	// the single thread result everything else is checked against
+	DroneSwarm referenceSwarm;
+	SceneGraph referenceGraph;
+	vector<DroneNodes> referenceDrones;
+	buildBenchSwarm(numDrones, numDrawn, referenceSwarm, referenceGraph, referenceDrones);
+	{
+		JobSystem jobs;
+		for (int frame = 0; frame < checkFrames; frame++)
+			runSwarmFrame(jobs, referenceSwarm, referenceGraph, referenceDrones);
+	}
+
+	double oneThreadTime = 0.0;
+	bool allOk = true;
+	for (int threads = 1; threads <= maxThreads; threads++)
+	{
+		DroneSwarm swarm;
+		SceneGraph graph;
+		vector<DroneNodes> drones;
+		buildBenchSwarm(numDrones, numDrawn, swarm, graph, drones);
+
+		JobSystem jobs;
+		jobs.start(threads - 1);
+		for (int frame = 0; frame < checkFrames; frame++)
+			runSwarmFrame(jobs, swarm, graph, drones);
+
+		bool identical = swarm.positionX == referenceSwarm.positionX && swarm.positionY == referenceSwarm.positionY &&
+			swarm.positionZ == referenceSwarm.positionZ && swarm.propAngle == referenceSwarm.propAngle &&
+			graph.numRecomputed == referenceGraph.numRecomputed;
+		for (size_t i = 0; i < graph.nodes.size() && identical; i++)
+			identical = memcmp(&graph.nodes[i].world, &referenceGraph.nodes[i].world, sizeof(mat4)) == 0;
+		allOk = allOk && identical;
+
+		unsigned int stolenBefore = jobs.jobsStolen();
+		unsigned int runBefore = jobs.jobsRun();
+		double frameTime = timeRuns([&]()
+		{
+			runSwarmFrame(jobs, swarm, graph, drones);
+			benchSink = graph.nodes[drones.back().lastNode].world[3][0];
+		});
+		if (threads == 1)
+			oneThreadTime = frameTime;
+
+		unsigned int jobsRun = jobs.jobsRun() - runBefore;
+		cout << fixed << setprecision(3) << setw(10) << threads << setw(14) << frameTime / 1e3 << setprecision(0) << setw(14) << numDrones * 1e3 / frameTime <<
+			setprecision(2) << setw(10) << oneThreadTime / frameTime << setprecision(1) << setw(9) << 100.0 * (jobs.jobsStolen() - stolenBefore) / std::max(jobsRun, 1u) << "%" <<
+			"  " << check(identical) << endl;
+	}
+	cout << check(allOk) << endl << endl;
+}
+
+/* Flies a swarm for the same few seconds at several frame rates, and with frame times all over
+   the place, through a fixed timestep. However the time is cut up the swarm has to end up the
+   same as it does after the same number of ticks one after the other. Then how much faster
+   than real time the ticks run when nothing waits for the screen */
+static void benchmarkFixedTimestep()
+{
+	const int numDrones = 10000;
+	const double seconds = 3.0;
+
+	cout << "fixed timestep, " << numDrones << " drones for " << seconds << "s at 60 ticks/s" << endl;
+	cout << setw(12) << "frames/s" << setw(10) << "frames" << setw(10) << "ticks" << setw(14) << "ticks/frame" << endl;
+
+	SceneGraph graph;
+	vector<DroneNodes> drones;
+	JobSystem jobs;
+	jobs.start(std::max((int)thread::hardware_concurrency() - 1, 0));
+
+	bool allOk = true;
+	for (double fps : { 30.0, 60.0, 144.0, 240.0, 0.0 })
+	{
+		DroneSwarm swarm;
+		swarm.resize(numDrones);
+		swarm.scatter(0, 1234);
+		DroneSwarm reference = swarm;
+
+		// no frame rate is frames between 2 and 50 milliseconds apart
+		mt19937 random(99);
+		uniform_real_distribution<double> frameTime(0.002, 0.05);
+
+		FixedTimestep timestep;
+		timestep.advance(0.0);
+		int frames = 0;
+		bool alphaOk = true;
+		for (double now = 0.0; now < seconds; frames++)
+		{
+			now = fps > 0.0 ? (frames + 1) / fps : now + frameTime(random);
+			int ticks = timestep.advance(now);
+			float alpha = timestep.alpha();
+			alphaOk = alphaOk && alpha >= 0.f && alpha < 1.f;
+			jobs.wait(scheduleSwarmFrame(jobs, swarm, 0, defaultFlightLimits, ticks, alpha, graph, drones, 1.f, 0.3f));
+			jobs.clear();
+		}
+
+		for (unsigned long long tick = 0; tick < timestep.ticks; tick++)
+		{
+			reference.steer(1, numDrones - 1);
+			reference.update();
+		}
+		bool identical = alphaOk && swarm.positionX == reference.positionX && swarm.positionY == reference.positionY &&
+			swarm.positionZ == reference.positionZ && swarm.pitch == reference.pitch && swarm.roll == reference.roll &&
+			swarm.propAngle == reference.propAngle && timestep.droppedSeconds == 0.0 &&
+			std::abs((double)timestep.ticks - seconds * 60.0) <= 1.0 + (fps > 0.0 ? 0.0 : 60.0 * 0.05);
+		allOk = allOk && identical;
+
+		cout << setw(12) << (fps > 0.0 ? to_string((int)fps) : string("irregular")) << setw(10) << frames << setw(10) << timestep.ticks <<
+			fixed << setprecision(2) << setw(14) << (double)timestep.ticks / frames << "  " << check(identical) << endl;
+	}
+
+	// a frame that takes a whole second only catches up maxTicksPerFrame ticks and drops the rest
+	FixedTimestep stalled;
+	stalled.advance(0.0);
+	int caughtUp = stalled.advance(1.0);
+	bool clamped = caughtUp == stalled.maxTicksPerFrame && stalled.droppedSeconds > 0.8 && stalled.advance(1.0 + stalled.tickSeconds) == 1;
+	cout << "stalled frame: " << caughtUp << " ticks, " << setprecision(3) << stalled.droppedSeconds << "s dropped  " << check(clamped) << endl;
+	allOk = allOk && clamped;
+
+	// the props are drawn halfway along the short way round, turning forwards, backwards or across 360
+	DroneSwarm props;
+	props.resize(1);
+	float propAngles[][3] = { { 10.f, 57.f, 33.5f }, { 57.f, 10.f, 33.5f }, { 350.f, 37.f, 13.5f }, { 37.f, 350.f, 13.5f }, { 100.f, -200.f, 130.f } };
+	bool propsOk = true;
+	for (const float* angles : propAngles)
+	{
+		props.previousPropAngle[0] = angles[0];
+		props.propAngle[0] = angles[1];
+		float drawn = props.drawnPropAngle(0, 0.5f);
+		propsOk = propsOk && fabs(remainder(drawn - angles[2], 360.f)) < 1e-3f;
+	}
+	cout << "props drawn the short way round  " << check(propsOk) << endl;
+	allOk = allOk && propsOk;
+
+	// headless, the ticks run back to back
+	DroneSwarm swarm;
+	swarm.resize(numDrones);
+	swarm.scatter(0, 1234);
+	const int batchTicks = 60;
+	double batchTime = timeRuns([&]()
+	{
+		jobs.wait(scheduleSwarmFrame(jobs, swarm, 0, defaultFlightLimits, batchTicks, 0.f, graph, drones, 1.f, 0.3f));
+		jobs.clear();
+		benchSink = swarm.positionX.back();
+	});
+	double simulatedTime = batchTicks / 60.0 * 1e6;
+	cout << "headless: " << setprecision(0) << batchTicks * 1e6 / batchTime << " ticks/s, " << setprecision(1) << simulatedTime / batchTime << "x real time" << endl;
+	cout << check(allOk) << endl << endl;
+}
+
+/* What a CPU scope costs with the profiler compiled in, and checks on what it records: the
+   scopes nest inside each other, the ring keeps the last maxFrames frames, and the trace has an
+   event for every frame and scope */
+static void benchmarkProfiler()
+{
+	cout << "frame profiler" << endl;
+
+	FrameProfiler profiler;
+	const int numFrames = FrameProfiler::maxFrames + 30, scopesPerFrame = 1000;
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		profiler.beginFrame();
+		profiler.beginScope("outer");
+		for (int i = 0; i < 3; i++)
+		{
+			profiler.beginScope("inner");
+			benchSink = (float)i;
+			profiler.endScope();
+		}
+		profiler.endScope();
+		profiler.beginScope("left open");
+		profiler.endFrame();
+	}
+
+	bool ringOk = profiler.numFrames() == FrameProfiler::maxFrames && profiler.frame(0).index == numFrames - 1 &&
+		profiler.frame(FrameProfiler::maxFrames - 1).index == numFrames - FrameProfiler::maxFrames;
+	bool nestingOk = true;
+	for (int age = 0; age < profiler.numFrames(); age++)
+	{
+		const ProfileFrame& frame = profiler.frame(age);
+		nestingOk = nestingOk && frame.events.size() == 5 && frame.events[0].depth == 0 && frame.events[4].depth == 0;
+		for (int i = 1; i <= 3 && nestingOk; i++)
+		{
+			const ProfileEvent& inner = frame.events[i];
+			nestingOk = inner.depth == 1 && inner.start >= frame.events[0].start &&
+				inner.start + inner.duration <= frame.events[0].start + frame.events[0].duration;
+		}
+		nestingOk = nestingOk && frame.events[4].duration >= 0.0 && frame.start + frame.duration >= frame.events[4].start + frame.events[4].duration;
+	}
+
+	ostringstream summary;
+	profiler.summarise(summary);
+	bool summaryOk = summary.str().find("inner") != string::npos && summary.str().find("left open") != string::npos;
+
+	// one event per frame and per scope, as "ph":"X" complete events
+	const char* tracePath = "profiler_bench_trace.json";
+	bool traceOk = profiler.writeChromeTrace(tracePath);
+	ifstream trace(tracePath);
+	string text((istreambuf_iterator<char>(trace)), istreambuf_iterator<char>());
+	trace.close();
+	remove(tracePath);
+	size_t events = 0;
+	for (size_t at = text.find("\"ph\":\"X\""); at != string::npos; at = text.find("\"ph\":\"X\"", at + 1))
+		events++;
+	traceOk = traceOk && text.compare(0, 15, "{\"traceEvents\":") == 0 && events == (size_t)FrameProfiler::maxFrames * 6;
+
+	double scopeTime = timeRuns([&]()
+	{
+		profiler.beginFrame();
+		for (int i = 0; i < scopesPerFrame; i++)
+		{
+			profiler.beginScope("scope");
+			profiler.endScope();
+		}
+		profiler.endFrame();
+	});
+
+	cout << "scope cost: " << fixed << setprecision(1) << scopeTime * 1e3 / scopesPerFrame << "ns" << endl;
+	cout << "ring " << check(ringOk) << ", nesting " << check(nestingOk) <<
+		", summary " << check(summaryOk) << ", trace " << check(traceOk) << endl;
+	cout << check(ringOk && nestingOk && summaryOk && traceOk) << endl << endl;
+}
+
+/* A recorded session of random fly mode keys, saved and loaded again, then replayed into a swarm
+   at several frame rates through the same key handling and tick splitting as display(). The
+   swarm has to end up where the live session, taking each key as it came, left it */
+static void benchmarkInputLog()
+{
+	const int numDrones = 1000, sessionTicks = 3600;
+	cout << "input record and replay, " << sessionTicks << " ticks" << endl;
+
+	InputLog recorded;
+	mt19937 random(7);
+	const int keys[] = { 'W', 'S', 'A', 'D', 'E', 'Q' };
+	for (unsigned int tick = 0; tick < sessionTicks; tick += 1 + random() % 40)
+	{
+		int key = keys[random() % 6];
+		recorded.record(tick, key, 1);
+		recorded.record(tick + 5 + random() % 30, key, 0);
+	}
+	stable_sort(recorded.events.begin(), recorded.events.end(), [](const InputEvent& a, const InputEvent& b) { return a.tick < b.tick; });
+	recorded.endTick = sessionTicks;
+
+	const char* logPath = "inputlog_bench.log";
+	InputLog log;
+	bool saved = recorded.save(logPath);
+	bool loaded = log.load(logPath);
+	ifstream logFile(logPath, ios::binary | ios::ate);
+	size_t fileSize = (size_t)logFile.tellg();
+	logFile.close();
+	remove(logPath);
+
+	bool roundTrip = saved && loaded && log.endTick == recorded.endTick && log.events.size() == recorded.events.size();
+	for (size_t i = 0; i < log.events.size() && roundTrip; i++)
+		roundTrip = log.events[i].tick == recorded.events[i].tick && log.events[i].key == recorded.events[i].key && log.events[i].action == recorded.events[i].action;
+	InputLog empty;
+	bool rejects = !empty.load("no such file.log");
+	cout << log.events.size() << " keys in " << fileSize << " bytes, round trip " << check(roundTrip) <<
+		", missing file " << check(rejects, "rejected") << endl;
+
+	const float speed = 0.025f;
+	auto runTicks = [](DroneSwarm& swarm, int ticks)
+	{
+		for (int i = 0; i < ticks; i++)
+		{
+			swarm.storePrevious(0, swarm.size());
+			swarm.steer(1, swarm.size() - 1);
+			swarm.update();
+		}
+	};
+
+	// the live session, one tick at a time with the keys given to drone 0 as they were pressed
+	DroneSwarm reference;
+	reference.resize(numDrones);
+	reference.scatter(1, 1234);
+	size_t next = 0;
+	for (unsigned int tick = 0; tick < recorded.endTick; tick++)
+	{
+		for (; next < recorded.events.size() && recorded.events[next].tick == tick; next++)
+			flyKey(recorded.events[next].key, recorded.events[next].action, speed, reference.velocityX[0], reference.velocityY[0], reference.velocityZ[0]);
+		runTicks(reference, 1);
+	}
+
+	bool allOk = roundTrip && rejects;
+	cout << setw(12) << "ticks/frame" << setw(10) << "frames" << setw(14) << "replay (ms)" << setw(14) << "x real time" << endl;
+	for (int maxTicks : { 1, 2, 5, 0 })
+	{
+		DroneSwarm swarm;
+		swarm.resize(numDrones);
+		swarm.scatter(1, 1234);
+		log.rewind();
+
+		// frames of maxTicks ticks, or a random number of ticks up to 8
+		mt19937 frameRandom(3);
+		unsigned int tick = 0;
+		int frames = 0;
+		benchClock::time_point start = benchClock::now();
+		while (tick < log.endTick)
+		{
+			int ticks = maxTicks > 0 ? maxTicks : (int)(frameRandom() % 9);
+			log.replayTicks(tick, ticks, [&](const InputEvent& event)
+			{
+				flyKey(event.key, event.action, speed, swarm.velocityX[0], swarm.velocityY[0], swarm.velocityZ[0]);
+			}, [&](int part)
+			{
+				runTicks(swarm, part);
+				tick += part;
+			});
+			frames++;
+		}
+		double replayTime = chrono::duration<double, milli>(benchClock::now() - start).count();
+
+		bool identical = tick == log.endTick && swarm.positionX == reference.positionX && swarm.positionY == reference.positionY &&
+			swarm.positionZ == reference.positionZ && swarm.pitch == reference.pitch && swarm.roll == reference.roll &&
+			swarm.propAngle == reference.propAngle;
+		allOk = allOk && identical;
+
+		cout << setw(12) << (maxTicks > 0 ? to_string(maxTicks) : string("0 to 8")) << setw(10) << frames << fixed << setprecision(2) <<
+			setw(14) << replayTime << setprecision(0) << setw(14) << sessionTicks / 60.0 * 1e3 / replayTime << "  " << check(identical) << endl;
+	}
+
+	// the keys have to have moved drone 0 for the comparison to mean anything
+	bool moved = reference.positionX[0] != 0.f || reference.positionZ[0] != 0.f;
+	cout << "drone 0 flown to (" << setprecision(2) << reference.positionX[0] << ", " << reference.positionY[0] << ", " << reference.positionZ[0] << ")" <<
+		"  " << check(moved) << endl;
+	cout << check(allOk && moved) << endl << endl;
+}
+
+struct Benchmark
+{
+	const char* name;
+	void (*run)();
+};
+
+static const Benchmark benchmarks[] =
+{
+	{ "scenegraph", benchmarkSceneGraph },
+	{ "transforms", benchmarkTransformSoA },
+	{ "normals", benchmarkRigidNormals },
+	{ "clusters", benchmarkClusteredLights },
+	{ "shadows", benchmarkShadowCascades },
+	{ "culling", benchmarkCulling },
+	{ "queue", benchmarkRenderQueue },
+	{ "vertices", benchmarkVertexFormats },
+	{ "vertexcache", benchmarkVertexCache },
+	{ "lod", benchmarkLod },
+	{ "tubes", benchmarkTubeGeneration },
+	{ "unittubes", benchmarkUnitTubes },
+	{ "swarm", benchmarkSwarm },
+	{ "jobs", benchmarkJobs },
+	{ "timestep", benchmarkFixedTimestep },
+	{ "profiler", benchmarkProfiler },
+	{ "inputlog", benchmarkInputLog },
+};
+
+int runBenchmarks(int argc, char* argv[])
+{
+	bool ranAny = false;
+	for (const Benchmark& benchmark : benchmarks)
+	{
+		bool selected = argc == 0;
+		for (int i = 0; i < argc; i++)
+		{
+			if (string(argv[i]) == benchmark.name)
+				selected = true;
+		}
+
+		if (selected)
+		{
+			benchmark.run();
+			ranAny = true;
+		}
+	}
+
+	if (!ranAny)
+	{
+		cout << "Unknown benchmark, available benchmarks are:";
+		for (const Benchmark& benchmark : benchmarks)
+			cout << " " << benchmark.name;
+		cout << endl;
+		return 1;
+	}
+	if (benchmarkFailed)
+	{
+		cout << "FAILED: some checks didn't pass" << endl;
+		return 1;
+	}
+	return 0;
+}
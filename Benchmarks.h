@@ -0,0 +1,9 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+/* CPU benchmarks that run without a window or OpenGL context. Each checks its results too,
+   and the run returns 1 if any check fails.
+   Run with: assignment1 --bench [name ...], with no names every benchmark is run */
+int runBenchmarks(int argc, char* argv[]);
+
+#endif
@@ -0,0 +1,297 @@
+#include "ClusteredLights.h"
+
+#include <cmath>
+#include <algorithm>
+
+float lightRadius(glm::vec3 colour, float cutoff)
+{
+	// poslight.frag treats a black light as white
+	if (colour == glm::vec3(0.f))
+		colour = glm::vec3(1.f);
+
+	// largest ambient + diffuse + specular factor of the light before attenuation
+	float maxColour = std::max(colour.x, std::max(colour.y, colour.z));
+	float intensity = 1.08f + 1.02f * maxColour;
+
+	// solve 1 / (0.5 + 0.2d + 0.8d^2) * intensity = cutoff for d
+	float c = 0.5f - intensity / cutoff;
+	if (c >= 0.f)
+		return 0.f;
+	return (-0.2f + std::sqrt(0.04f - 4.f * 0.8f * c)) / (2.f * 0.8f);
+}
+
+LightClusters::LightClusters()
+{
+	tilesX = 16;
+	tilesY = 9;
+	slices = 24;
+	maxLightsPerCluster = 16;
+	fovy = aspect = zNear = zFar = 0.f;
+	screenWidth = screenHeight = 0;
+	gridBuffer = indicesBuffer = lightsBuffer = 0;
+	gridTexture = indicesTexture = lightsTexture = 0;
+}
+
+LightClusters::~LightClusters()
+{}
+
+void LightClusters::setFrustum(float fovy, float aspect, float zNear, float zFar, int screenWidth, int screenHeight)
+{
+	if (fovy == this->fovy && aspect == this->aspect && zNear == this->zNear && zFar == this->zFar &&
+		screenWidth == this->screenWidth && screenHeight == this->screenHeight)
+		return;
+
+	this->fovy = fovy;
+	this->aspect = aspect;
+	this->zNear = zNear;
+	this->zFar = zFar;
+	this->screenWidth = screenWidth;
+	this->screenHeight = screenHeight;
+	buildBounds();
+}
+
+void LightClusters::setGridSize(int tilesX, int tilesY, int slices)
+{
+	this->tilesX = tilesX;
+	this->tilesY = tilesY;
+	this->slices = slices;
+	if (zFar > 0.f)
+		buildBounds();
+}
+
+void LightClusters::buildBounds()
+{
+	float tanY = std::tan(fovy * 0.5f);
+	float tanX = tanY * aspect;
+
+	sliceNear.resize(slices + 1);
+	for (int k = 0; k <= slices; k++)
+	{
+		sliceNear[k] = zNear * std::pow(zFar / zNear, (float)k / slices);
+	}
+
+	// the tile edges are planes through the eye, so x = slope * depth along them
+	xMin.resize(slices * tilesX);
+	xMax.resize(slices * tilesX);
+	yMin.resize(slices * tilesY);
+	yMax.resize(slices * tilesY);
+	for (int k = 0; k < slices; k++)
+	{
+		float dn = sliceNear[k];
+		float df = sliceNear[k + 1];
+		for (int i = 0; i < tilesX; i++)
+		{
+			float left = (-1.f + 2.f * i / tilesX) * tanX;
+			float right = (-1.f + 2.f * (i + 1) / tilesX) * tanX;
+			xMin[k * tilesX + i] = std::min(left * dn, left * df);
+			xMax[k * tilesX + i] = std::max(right * dn, right * df);
+		}
+		for (int j = 0; j < tilesY; j++)
+		{
+			float bottom = (-1.f + 2.f * j / tilesY) * tanY;
+			float top = (-1.f + 2.f * (j + 1) / tilesY) * tanY;
+			yMin[k * tilesY + j] = std::min(bottom * dn, bottom * df);
+			yMax[k * tilesY + j] = std::max(top * dn, top * df);
+		}
+	}
+}
+
+int LightClusters::clusterIndex(int x, int y, int slice) const
+{
+	return (slice * tilesY + y) * tilesX + x;
+}
+
+int LightClusters::numClusters() const
+{
+	return tilesX * tilesY * slices;
+}
+
+glm::vec2 LightClusters::tileSize() const
+{
+	return glm::vec2((float)screenWidth / tilesX, (float)screenHeight / tilesY);
+}
+
+float LightClusters::sliceScale() const
+{
+	return slices / std::log(zFar / zNear);
+}
+
+float LightClusters::sliceBias() const
+{
+	return -slices * std::log(zNear) / std::log(zFar / zNear);
+}
+
+bool LightClusters::sphereOverlapsCluster(const ClusterLight& light, int x, int y, int slice) const
+{
+	// distance from the light to the nearest point of the cluster's box
+	float depth = -light.position.z;
+	float dx = std::max(0.f, std::max(xMin[slice * tilesX + x] - light.position.x, light.position.x - xMax[slice * tilesX + x]));
+	float dy = std::max(0.f, std::max(yMin[slice * tilesY + y] - light.position.y, light.position.y - yMax[slice * tilesY + y]));
+	float dz = std::max(0.f, std::max(sliceNear[slice] - depth, depth - sliceNear[slice + 1]));
+	return dx * dx + dy * dy + dz * dz <= light.radius * light.radius;
+}
+
+void LightClusters::cullLights(std::vector<ClusterLight>& lights, size_t maxLights) const
+{
+	// the sides are planes through the eye, x = tanX * depth on the right one
+	float tanY = std::tan(fovy * 0.5f);
+	float tanX = tanY * aspect;
+	float scaleX = 1.f / std::sqrt(1.f + tanX * tanX);
+	float scaleY = 1.f / std::sqrt(1.f + tanY * tanY);
+
+	size_t kept = 0;
+	for (size_t l = 0; l < lights.size(); l++)
+	{
+		const ClusterLight& light = lights[l];
+		float depth = -light.position.z;
+		if (depth + light.radius < zNear || depth - light.radius > zFar ||
+			(std::fabs(light.position.x) - tanX * depth) * scaleX > light.radius ||
+			(std::fabs(light.position.y) - tanY * depth) * scaleY > light.radius)
+			continue;
+		lights[kept++] = light;
+	}
+	lights.resize(kept);
+
+	auto nearer = [](const ClusterLight& a, const ClusterLight& b)
+	{
+		return glm::dot(a.position, a.position) < glm::dot(b.position, b.position);
+	};
+	if (lights.size() > maxLights)
+	{
+		std::nth_element(lights.begin(), lights.begin() + maxLights, lights.end(), nearer);
+		lights.resize(maxLights);
+	}
+	std::sort(lights.begin(), lights.end(), nearer);
+}
+
+void LightClusters::assignLights(const std::vector<ClusterLight>& lights)
+{
+	counts.assign(numClusters(), 0);
+	spans.clear();
+
+	float logRange = std::log(zFar / zNear);
+	for (size_t l = 0; l < lights.size(); l++)
+	{
+		const ClusterLight& light = lights[l];
+		float depth = -light.position.z;
+		if (depth + light.radius < zNear || depth - light.radius > zFar)
+			continue;
+
+		// slices covered by the sphere's depth range, widened by one so rounding can't lose any
+		float nearDepth = std::max(depth - light.radius, zNear);
+		float farDepth = std::min(depth + light.radius, zFar);
+		int firstSlice = std::max(0, (int)std::floor(std::log(nearDepth / zNear) / logRange * slices) - 1);
+		int lastSlice = std::min(slices - 1, (int)std::floor(std::log(farDepth / zNear) / logRange * slices) + 1);
+
+		for (int k = firstSlice; k <= lastSlice; k++)
+		{
+			for (int j = 0; j < tilesY; j++)
+			{
+				/* The distance to the tiles along a row falls then rises again, so the tiles the
+				   sphere reaches are a single span found by testing in from both ends */
+				int first = 0, last = tilesX - 1;
+				while (first < tilesX && !sphereOverlapsCluster(light, first, j, k)) first++;
+				if (first == tilesX)
+					continue;
+				while (!sphereOverlapsCluster(light, last, j, k)) last--;
+
+				ClusterSpan span = { (GLuint)l, (GLuint)clusterIndex(first, j, k), (GLuint)(last - first + 1) };
+				spans.push_back(span);
+				for (int i = first; i <= last; i++)
+					counts[span.firstCluster + i - first]++;
+			}
+		}
+	}
+
+	// each cluster's lights are stored after the previous cluster's
+	grid.resize(numClusters() * 2);
+	GLuint offset = 0;
+	for (int c = 0; c < numClusters(); c++)
+	{
+		grid[c * 2] = offset;
+		grid[c * 2 + 1] = 0;
+		offset += std::min(counts[c], maxLightsPerCluster);
+	}
+
+	/* the spans are in light order, so each cluster's list ends up sorted, and capped, the same
+	   as the brute force version */
+	indices.resize(offset);
+	for (const ClusterSpan& span : spans)
+	{
+		for (GLuint c = span.firstCluster; c < span.firstCluster + span.numClusters; c++)
+		{
+			if (grid[c * 2 + 1] < maxLightsPerCluster)
+				indices[grid[c * 2] + grid[c * 2 + 1]++] = span.light;
+		}
+	}
+}
+
+void LightClusters::assignLightsBruteForce(const std::vector<ClusterLight>& lights)
+{
+	grid.resize(numClusters() * 2);
+	indices.clear();
+	for (int k = 0; k < slices; k++)
+	{
+		for (int j = 0; j < tilesY; j++)
+		{
+			for (int i = 0; i < tilesX; i++)
+			{
+				int cluster = clusterIndex(i, j, k);
+				grid[cluster * 2] = (GLuint)indices.size();
+				for (size_t l = 0; l < lights.size() && indices.size() - grid[cluster * 2] < maxLightsPerCluster; l++)
+				{
+					if (sphereOverlapsCluster(lights[l], i, j, k))
+						indices.push_back((GLuint)l);
+				}
+				grid[cluster * 2 + 1] = (GLuint)indices.size() - grid[cluster * 2];
+			}
+		}
+	}
+}
+
+/* Fills a buffer and creates the texture reading it the first time it's used */
+static void uploadTextureBuffer(GLuint& buffer, GLuint& texture, GLenum format, const void* data, GLsizeiptr size)
+{
+	if (buffer == 0)
+	{
+		glGenBuffers(1, &buffer);
+		glGenTextures(1, &texture);
+	}
+
+	glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+	glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+	glBindTexture(GL_TEXTURE_BUFFER, texture);
+	glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+void LightClusters::upload(const std::vector<ClusterLight>& lights)
+{
+	lightTexels.resize(std::max((size_t)1, lights.size() * 2));
+	for (size_t l = 0; l < lights.size(); l++)
+	{
+		lightTexels[l * 2] = glm::vec4(lights[l].position, lights[l].radius);
+		lightTexels[l * 2 + 1] = glm::vec4(lights[l].colour, 0.f);
+	}
+
+	// an empty buffer can't back a texture, so there is always at least one index
+	if (indices.empty())
+		indices.push_back(0);
+
+	uploadTextureBuffer(gridBuffer, gridTexture, GL_RG32UI, &grid[0], grid.size() * sizeof(GLuint));
+	uploadTextureBuffer(indicesBuffer, indicesTexture, GL_R32UI, &indices[0], indices.size() * sizeof(GLuint));
+	uploadTextureBuffer(lightsBuffer, lightsTexture, GL_RGBA32F, &lightTexels[0], lightTexels.size() * sizeof(glm::vec4));
+}
+
+void LightClusters::bindTextures(GLuint gridUnit, GLuint indicesUnit, GLuint lightsUnit)
+{
+	glActiveTexture(GL_TEXTURE0 + gridUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, gridTexture);
+	glActiveTexture(GL_TEXTURE0 + indicesUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, indicesTexture);
+	glActiveTexture(GL_TEXTURE0 + lightsUnit);
+	glBindTexture(GL_TEXTURE_BUFFER, lightsTexture);
+	glActiveTexture(GL_TEXTURE0);
+}
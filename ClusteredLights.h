@@ -0,0 +1,96 @@
+#ifndef CLUSTEREDLIGHTS_H
+#define CLUSTEREDLIGHTS_H
+
+#include "wrapper_glfw.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+/* A point light for clustered shading. The radius is the distance where the light's
+   contribution drops below the cutoff, it is only used to choose the clusters it affects */
+struct ClusterLight
+{
+	glm::vec3 position;	// view space
+	float radius;
+	glm::vec3 colour;
+};
+
+// distance where the attenuation in poslight.frag takes the light below cutoff (out of 1)
+float lightRadius(glm::vec3 colour, float cutoff = 1.f / 256.f);
+
+/* Splits the view frustum into a grid of tiles on screen and exponential slices in depth,
+   and lists the lights whose range overlaps each cluster. The fragment shader then only
+   loops over the lights of the cluster it falls in.
+   The binning is CPU only, upload() sends the result to three texture buffers:
+	grid - one (offset, count) pair per cluster into the index list
+	indices - the light indices of every cluster, one after the other
+	lights - two texels per light, (position, radius) and (colour, 0) */
+class LightClusters
+{
+public:
+	LightClusters();
+	~LightClusters();
+
+	// only rebuilds the cluster bounds when the projection or screen size has changed
+	void setFrustum(float fovy, float aspect, float zNear, float zFar, int screenWidth, int screenHeight);
+	void setGridSize(int tilesX, int tilesY, int slices);
+
+	/* Drops the lights whose sphere misses the frustum and keeps the maxLights nearest the
+	   camera, sorted nearest first so they are the ones a full cluster keeps */
+	void cullLights(std::vector<ClusterLight>& lights, size_t maxLights) const;
+
+	// bins the lights, visiting only the clusters near each light's bounding sphere
+	void assignLights(const std::vector<ClusterLight>& lights);
+
+	// reference version testing every light against every cluster, the results are identical
+	void assignLightsBruteForce(const std::vector<ClusterLight>& lights);
+
+	int clusterIndex(int x, int y, int slice) const;
+	int numClusters() const;
+
+	// values for the cluster lookup in poslight.frag
+	glm::vec2 tileSize() const;
+	float sliceScale() const;
+	float sliceBias() const;
+
+	void upload(const std::vector<ClusterLight>& lights);
+	void bindTextures(GLuint gridUnit, GLuint indicesUnit, GLuint lightsUnit);
+
+	int tilesX, tilesY, slices;
+
+	/* Lights past this in a cluster are left out, earlier lights first. With the default grid
+	   the index list stays under the 64K texels every texture buffer can hold */
+	GLuint maxLightsPerCluster;
+
+	std::vector<GLuint> grid;		// offset and count for each cluster
+	std::vector<GLuint> indices;
+
+private:
+	bool sphereOverlapsCluster(const ClusterLight& light, int x, int y, int slice) const;
+	void buildBounds();
+
+	float fovy, aspect, zNear, zFar;
+	int screenWidth, screenHeight;
+
+	/* The clusters are boxes around the frustum pieces. The x range only depends on the
+	   tile column and the slice, y on the tile row and slice, and depth on the slice */
+	std::vector<float> xMin, xMax;	// [slice * tilesX + x]
+	std::vector<float> yMin, yMax;	// [slice * tilesY + y]
+	std::vector<float> sliceNear;	// depth of the slice boundaries, slices + 1 values
+
+	// a run of clusters along one tile row that a light reaches
+	struct ClusterSpan
+	{
+		GLuint light;
+		GLuint firstCluster;
+		GLuint numClusters;
+	};
+
+	std::vector<GLuint> counts;
+	std::vector<ClusterSpan> spans;	// found by the first binning pass, then written out by the second
+
+	GLuint gridBuffer, indicesBuffer, lightsBuffer;
+	GLuint gridTexture, indicesTexture, lightsTexture;
+	std::vector<glm::vec4> lightTexels;
+};
+
+#endif
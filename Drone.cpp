@@ -0,0 +1,166 @@
+#include "Drone.h"
+
+using namespace glm;
+
+const Material materials[NUM_MATERIALS] =
+{
+	{ vec4(0.20f, 0.20f, 0.20f, 1.f), 0.f, false },	// frame
+	{ vec4(0.60f, 0.60f, 0.60f, 1.f), 8.f, false },	// motor
+	{ vec4(0.88f, 0.44f, 0.f, 1.f), 2.f, false },	// motor stator
+	{ vec4(1.f, 0.f, 0.f, 1.f), 1.f, false },		// standoff
+	{ vec4(0.8f, 0.8f, 0.8f, 1.f), 0.f, false },	// ground
+	{ vec4(0.8f, 0.8f, 0.8f, 1.f), 0.f, true },		// light
+};
+
+static const vec3 xAxis = vec3(1, 0, 0);
+static const vec3 yAxis = vec3(0, 1, 0);
+static const vec3 zAxis = vec3(0, 0, 1);
+
+/* The tubes are built along z and rotated by -90 degrees around x to stand upright. The
+   scale used to be applied after that rotation, to keep translate * rotate * scale order
+   the scale is given in the tube's own axes instead, which swaps y and z */
+static vec3 uprightTubeScale(vec3 scale)
+{
+	return vec3(scale.x, scale.z, scale.y);
+}
+
+DroneNodes buildDrone(SceneGraph& graph, int parent)
+{
+	vec3 framePlateScale = vec3(1.f, 0.015f, 0.3f);
+	vec3 frameArmScale = vec3(0.8f, 0.03f, 0.15f);
+	vec3 standoffScale = vec3(0.025f, 0.17f, 0.025f);
+
+	vec3 motorBellScale = vec3(0.15f, 0.085f, 0.15f);
+	vec3 motorStatorScale = vec3(0.125f, 0.08f, 0.125f);
+	vec3 motorShaftScale = vec3(0.025f, 0.085f, 0.025f);
+	vec3 motorStrutsScale = vec3(0.011f, 0.011f, 0.14f);
+
+	quat noRotation = quat(1.f, 0.f, 0.f, 0.f);
+	quat upright = angleAxis(-radians(90.f), xAxis);
+	vec3 noScale = vec3(1.f);
+
+	DroneNodes drone;
+
+	// the pose of the root is set every frame with setDronePose
+	drone.root = graph.addNode(parent, vec3(0.f), noRotation, noScale);
+	drone.firstNode = drone.root;
+
+	// light sources on drone
+	for (int i = 0; i < 4; i++)
+	{
+		quat armRotation = angleAxis(-radians((90.f * i) + 45.f), yAxis);
+		drone.lights[i] = graph.addNode(drone.root, armRotation * vec3(0.7f, -0.08f, 0.f), armRotation, vec3(0.02f), MESH_SPHERE, MATERIAL_LIGHT);
+	}
+
+	// frame top and bottom plates
+	graph.addNode(drone.root, vec3(0.f, -0.085f, 0.f), noRotation, framePlateScale, MESH_CUBE, MATERIAL_FRAME);
+	graph.addNode(drone.root, vec3(0.f, 0.085f, 0.f), noRotation, framePlateScale, MESH_CUBE, MATERIAL_FRAME);
+
+	// arms
+	for (int i = 0; i < 4; i++)
+	{
+		quat armRotation = angleAxis(-radians((90.f * i) + 45.f), yAxis);
+		graph.addNode(drone.root, armRotation * vec3(0.45f, -0.1f, 0.f), armRotation, frameArmScale, MESH_CUBE, MATERIAL_FRAME);
+	}
+
+	//motors
+	for (int i = 0; i < 4; i++)
+	{
+		quat armRotation = angleAxis(-radians((90.f * i) + 45.f), yAxis);
+		int motorMount = graph.addNode(drone.root, armRotation * vec3(0.77f, -0.02f, 0.f), armRotation, noScale);
+
+		// moving bits, the rotation is set every frame with setDroneMotorAngle
+		drone.motors[i] = graph.addNode(motorMount, vec3(0.f), noRotation, noScale);
+
+		// propeller blades
+		int hub = graph.addNode(drone.motors[i], vec3(0.f, 0.042f, 0.f), noRotation, noScale);
+		for (int j = 0; j < 3; j++)
+		{
+			int bladeMount = graph.addNode(hub, vec3(0.f), angleAxis(-radians(120.f * j), yAxis), noScale);
+
+			quat bladePitch;
+			if (i % 2 == 0)
+				bladePitch = angleAxis(-radians(10.f), xAxis);
+			else
+				bladePitch = angleAxis(radians(10.f), xAxis);
+
+			graph.addNode(bladeMount, bladePitch * vec3(0.15f, 0.03f, 0.f), bladePitch, vec3(0.3f, 0.01f, 0.05f), MESH_CUBE, MATERIAL_MOTOR);
+			graph.addNode(bladeMount, vec3(0.015f, 0.f, 0.f), noRotation, motorStrutsScale, MESH_CUBE, MATERIAL_MOTOR);
+			graph.addNode(bladeMount, vec3(-0.015f, 0.f, 0.f), noRotation, motorStrutsScale, MESH_CUBE, MATERIAL_MOTOR);
+		}
+
+		// motor shaft
+		graph.addNode(drone.motors[i], vec3(0.f, 0.06f, 0.f), upright, uprightTubeScale(motorShaftScale), MESH_MOTOR_SHAFT, MATERIAL_MOTOR);
+
+		// motor bell
+		graph.addNode(drone.motors[i], vec3(0.f), upright, uprightTubeScale(motorBellScale), MESH_MOTOR_BELL, MATERIAL_MOTOR);
+
+		// motor base
+		graph.addNode(motorMount, vec3(0.f, -0.06f, 0.f), noRotation, vec3(0.12f, 0.01f, 0.04f), MESH_CUBE, MATERIAL_MOTOR);
+		graph.addNode(motorMount, vec3(0.f, -0.06f, 0.f), noRotation, vec3(0.04f, 0.01f, 0.12f), MESH_CUBE, MATERIAL_MOTOR);
+
+		// motor stator
+		graph.addNode(motorMount, vec3(0.f, -0.015f, 0.f), upright, uprightTubeScale(motorStatorScale), MESH_MOTOR_STATOR, MATERIAL_MOTOR_STATOR);
+	}
+
+	// standoffs
+	vec3 standoffPositions[8] =
+	{
+		vec3(0.45f, 0.f, 0.12f), vec3(0.2f, 0.f, 0.12f), vec3(-0.2f, 0.f, 0.12f), vec3(-0.45f, 0.f, 0.12f),
+		vec3(0.45f, 0.f, -0.12f), vec3(0.2f, 0.f, -0.12f), vec3(-0.2f, 0.f, -0.12f), vec3(-0.45f, 0.f, -0.12f)
+	};
+	for (int i = 0; i < 8; i++)
+	{
+		graph.addNode(drone.root, standoffPositions[i], upright, uprightTubeScale(standoffScale), MESH_TUBE, MATERIAL_STANDOFF);
+	}
+
+	drone.lastNode = (int)graph.nodes.size() - 1;
+
+	// the whole drone moves with its root, so none of it goes in the static shadow cache
+	for (int i = drone.firstNode; i <= drone.lastNode; i++)
+		graph.nodes[i].dynamic = true;
+	return drone;
+}
+
+int buildGroundPlane(SceneGraph& graph)
+{
+	vec3 groundPlaneScale = vec3(20.f, 0.0001f, 20.f);
+	return graph.addNode(-1, vec3(0.f, -1.f, 0.f), quat(1.f, 0.f, 0.f, 0.f), groundPlaneScale, MESH_CUBE, MATERIAL_GROUND);
+}
+
+void setDronePose(SceneGraph& graph, const DroneNodes& drone, vec3 position, vec3 modelAngle, float modelScale)
+{
+	// rotates the model after transforming it so these transformations do not affect the translation
+	quat rotation = angleAxis(-radians(modelAngle.x), xAxis) *
+		angleAxis(-radians(modelAngle.y), yAxis) *
+		angleAxis(-radians(modelAngle.z), zAxis) *
+		angleAxis(-radians(90.f), yAxis); // rotates 90 degrees to align the drone along the axis which make controls easier
+
+	graph.setTranslation(drone.root, position);
+	graph.setRotation(drone.root, rotation);
+	graph.setScale(drone.root, vec3(modelScale));
+}
+
+void setDroneMotorAngle(SceneGraph& graph, const DroneNodes& drone, float motorAngle)
+{
+	// neighbouring motors spin in opposite directions
+	quat clockwise = angleAxis(-radians(motorAngle), yAxis);
+	quat antiClockwise = angleAxis(radians(motorAngle), yAxis);
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (i % 2 == 0)
+			graph.setRotation(drone.motors[i], clockwise);
+		else
+			graph.setRotation(drone.motors[i], antiClockwise);
+	}
+}
+
+vec3 droneLightColour(int light)
+{
+	// the green lights are forward and the red are back
+	if (light > 0 && light < 3)
+		return vec3(0.6f, 0.1f, 0.1f);
+	else
+		return vec3(0.1f, 0.6f, 0.1f);
+}
@@ -0,0 +1,60 @@
+#ifndef DRONE_H
+#define DRONE_H
+
+#include "SceneGraph.h"
+#include <glm/glm.hpp>
+
+// meshes the scene graph nodes can refer to, main maps these to the actual mesh objects
+enum MeshId
+{
+	MESH_CUBE,
+	MESH_TUBE,
+	MESH_MOTOR_BELL,
+	MESH_MOTOR_STATOR,
+	MESH_MOTOR_SHAFT,
+	MESH_SPHERE,
+	NUM_MESHES
+};
+
+enum MaterialId
+{
+	MATERIAL_FRAME,
+	MATERIAL_MOTOR,
+	MATERIAL_MOTOR_STATOR,
+	MATERIAL_STANDOFF,
+	MATERIAL_GROUND,
+	MATERIAL_LIGHT,
+	NUM_MATERIALS
+};
+
+struct Material
+{
+	glm::vec4 colour;
+	float reflectiveness;
+	bool emissive;
+};
+
+extern const Material materials[NUM_MATERIALS];
+
+// indices of the nodes of a drone that are changed while the program runs
+struct DroneNodes
+{
+	int root;
+	int motors[4];
+	int lights[4];
+
+	// the drone's nodes are stored contiguously in [firstNode, lastNode]
+	int firstNode;
+	int lastNode;
+};
+
+DroneNodes buildDrone(SceneGraph& graph, int parent = -1);
+int buildGroundPlane(SceneGraph& graph);
+
+// angles are in degrees, as used by the controls in main
+void setDronePose(SceneGraph& graph, const DroneNodes& drone, glm::vec3 position, glm::vec3 modelAngle, float modelScale);
+void setDroneMotorAngle(SceneGraph& graph, const DroneNodes& drone, float motorAngle);
+
+glm::vec3 droneLightColour(int light);
+
+#endif
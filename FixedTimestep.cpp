@@ -0,0 +1,68 @@
+#include "FixedTimestep.h"
+
+#include <cmath>
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(double tickSeconds, int maxTicksPerFrame)
+{
+	this->tickSeconds = tickSeconds;
+	this->maxTicksPerFrame = maxTicksPerFrame;
+	reset();
+}
+
+void FixedTimestep::reset()
+{
+	ticks = 0;
+	droppedSeconds = 0.0;
+	accumulator = 0.0;
+	lastTime = 0.0;
+	started = false;
+}
+
+int FixedTimestep::advance(double now)
+{
+	if (!started)
+	{
+		started = true;
+		lastTime = now;
+		return 0;
+	}
+
+	double elapsed = now - lastTime;
+	lastTime = now;
+	return advanceBy(elapsed > 0.0 ? elapsed : 0.0);
+}
+
+int FixedTimestep::advanceBy(double elapsed)
+{
+	accumulator += elapsed;
+
+	/* Frame times that should be a whole number of ticks come out a rounding error short, which
+	   would leave a tick for the next frame and give an alpha of 1. Anything that close is a tick */
+	double fullTick = tickSeconds * (1.0 - 1e-6);
+
+	int due = 0;
+	while (accumulator >= fullTick && due < maxTicksPerFrame)
+	{
+		accumulator = std::max(accumulator - tickSeconds, 0.0);
+		due++;
+	}
+
+	// fallen too far behind to catch up, keep only the part of a tick that is in progress
+	if (accumulator >= fullTick)
+	{
+		double kept = std::fmod(accumulator, tickSeconds);
+		if (kept >= fullTick)
+			kept = 0.0;
+		droppedSeconds += accumulator - kept;
+		accumulator = kept;
+	}
+
+	ticks += due;
+	return due;
+}
+
+float FixedTimestep::alpha() const
+{
+	return (float)(accumulator / tickSeconds);
+}
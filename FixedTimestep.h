@@ -0,0 +1,38 @@
+#ifndef FIXEDTIMESTEP_H
+#define FIXEDTIMESTEP_H
+
+/* Turns real time into a whole number of fixed simulation ticks. The time since the last frame
+   goes into an accumulator and a tick is taken out for every tickSeconds it holds, so the
+   simulation runs at the same speed whatever the frame rate. What is left over is how far the
+   frame is between the last tick and the next one, for interpolating what is drawn.
+   When a frame takes so long that more than maxTicksPerFrame would be due, the rest of the time
+   is dropped rather than carried on, so a slow frame can't make the next one slower still */
+class FixedTimestep
+{
+public:
+	FixedTimestep(double tickSeconds = 1.0 / 60.0, int maxTicksPerFrame = 8);
+
+	// the ticks due by now, in seconds from any fixed point. The first call starts the clock and returns 0
+	int advance(double now);
+
+	// adds elapsed seconds directly, for running the simulation without a clock
+	int advanceBy(double elapsed);
+
+	// from 0 at the last tick to 1 at the next
+	float alpha() const;
+
+	void reset();
+
+	double tickSeconds;
+	int maxTicksPerFrame;
+
+	unsigned long long ticks;	// ticks taken since the start
+	double droppedSeconds;		// time thrown away by frames that fell too far behind
+
+private:
+	double accumulator;
+	double lastTime;
+	bool started;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "FrameTimings.h"
+
+#include <algorithm>
+#include <iomanip>
+
+FrameTimingLog::FrameTimingLog()
+{}
+
+FrameTimingLog::~FrameTimingLog()
+{}
+
+bool FrameTimingLog::open(const std::string& path)
+{
+	frameTimes.clear();
+	file.open(path.c_str());
+	if (!file)
+		return false;
+	file << "frame,tick,cpu_ms,frame_ms,draw_calls,triangles,parts_culled" << std::endl;
+	return true;
+}
+
+void FrameTimingLog::add(unsigned long long tick, double cpuTime, double frameTime, const RenderStats& stats)
+{
+	file << frameTimes.size() << "," << tick << "," << cpuTime << "," << frameTime << "," << stats.drawCalls << "," <<
+		stats.trianglesDrawn << "," << stats.nodesCulled << "\n";
+	frameTimes.push_back(frameTime);
+}
+
+void FrameTimingLog::summarise(std::ostream& out) const
+{
+	if (frameTimes.empty())
+		return;
+
+	std::vector<double> sorted = frameTimes;
+	std::sort(sorted.begin(), sorted.end());
+	double total = 0.0;
+	for (double time : sorted)
+		total += time;
+
+	size_t count = sorted.size();
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << std::fixed << std::setprecision(2) << count << " frames: mean " << total / count << "ms, median " << sorted[count / 2] <<
+		"ms, 95% " << sorted[count * 95 / 100] << "ms, worst " << sorted.back() << "ms" << std::endl;
+	out.flags(flags);
+	out.precision(precision);
+}
+
+size_t FrameTimingLog::numFrames() const
+{
+	return frameTimes.size();
+}
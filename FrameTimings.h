@@ -0,0 +1,32 @@
+#ifndef FRAMETIMINGS_H
+#define FRAMETIMINGS_H
+
+#include "RenderStats.h"
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* Writes how long each frame of a run took to a CSV file, a row a frame with the tick it
+   finished on and what it drew, and sums the times up at the end. cpu is the time to build and
+   submit the frame, frame the whole time the frame took */
+class FrameTimingLog
+{
+public:
+	FrameTimingLog();
+	~FrameTimingLog();
+
+	bool open(const std::string& path);
+	void add(unsigned long long tick, double cpuTime, double frameTime, const RenderStats& stats);
+
+	// the mean, median, 95th percentile and worst frame time
+	void summarise(std::ostream& out) const;
+
+	size_t numFrames() const;
+
+private:
+	std::ofstream file;
+	std::vector<double> frameTimes;
+};
+
+#endif
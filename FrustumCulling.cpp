@@ -0,0 +1,178 @@
+#include "FrustumCulling.h"
+#include "SimdLanes.h"
+
+#include <cmath>
+#include <algorithm>
+
+BoundingSphere sphereFromBox(glm::vec3 boundsMin, glm::vec3 boundsMax)
+{
+	BoundingSphere sphere;
+	sphere.centre = (boundsMin + boundsMax) * 0.5f;
+	sphere.radius = glm::length(boundsMax - boundsMin) * 0.5f;
+	return sphere;
+}
+
+BoundingSphere mergeSpheres(const BoundingSphere& a, const BoundingSphere& b)
+{
+	if (b.radius < 0.f)
+		return a;
+	if (a.radius < 0.f)
+		return b;
+
+	float d = glm::length(b.centre - a.centre);
+	if (d + b.radius <= a.radius)
+		return a;
+	if (d + a.radius <= b.radius)
+		return b;
+
+	// the new sphere touches the far sides of both, slightly enlarged so rounding can't leave b outside
+	BoundingSphere merged;
+	merged.radius = (d + a.radius + b.radius) * 0.5f;
+	merged.centre = a.centre + (b.centre - a.centre) * ((merged.radius - a.radius) / d);
+	merged.radius *= 1.0001f;
+	return merged;
+}
+
+Frustum frustumFromMatrix(const glm::mat4& viewProjection)
+{
+	// each plane is the sum or difference of the last row and one of the other rows
+	glm::vec4 row[4];
+	for (int r = 0; r < 4; r++)
+		row[r] = glm::vec4(viewProjection[0][r], viewProjection[1][r], viewProjection[2][r], viewProjection[3][r]);
+
+	Frustum frustum;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		frustum.planes[axis * 2] = row[3] + row[axis];
+		frustum.planes[axis * 2 + 1] = row[3] - row[axis];
+	}
+
+	// normalised so the plane equation gives the actual distance
+	for (int p = 0; p < 6; p++)
+		frustum.planes[p] *= 1.f / glm::length(glm::vec3(frustum.planes[p]));
+	return frustum;
+}
+
+SceneBounds::SceneBounds()
+{
+	count = 0;
+}
+
+SceneBounds::~SceneBounds()
+{}
+
+size_t SceneBounds::size() const
+{
+	return count;
+}
+
+BoundingSphere SceneBounds::getSphere(size_t i) const
+{
+	BoundingSphere sphere;
+	sphere.centre = glm::vec3(centreX[i], centreY[i], centreZ[i]);
+	sphere.radius = radius[i];
+	return sphere;
+}
+
+void SceneBounds::update(const SceneGraph& graph, const BoundingSphere* meshBounds)
+{
+	count = graph.nodes.size();
+	size_t padded = (count + 7) & ~(size_t)7;
+	centreX.assign(padded, 0.f);
+	centreY.assign(padded, 0.f);
+	centreZ.assign(padded, 0.f);
+	radius.assign(padded, -1.f);
+	distance.resize(padded);
+	visible.resize(count);
+
+	spheres.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const SceneNode& node = graph.nodes[i];
+		spheres[i].centre = glm::vec3(node.world[3]);
+		spheres[i].radius = -1.f;
+		if (node.mesh < 0)
+			continue;
+
+		// the largest axis scale covers any rotation and non uniform scale
+		const BoundingSphere& mesh = meshBounds[node.mesh];
+		float scale = std::max(glm::length(glm::vec3(node.world[0])), std::max(glm::length(glm::vec3(node.world[1])), glm::length(glm::vec3(node.world[2]))));
+		spheres[i].centre = glm::vec3(node.world * glm::vec4(mesh.centre, 1.f));
+		spheres[i].radius = mesh.radius * scale;
+	}
+
+	// children come after their parents, so going backwards every child is complete before it's added to its parent
+	for (size_t i = count; i-- > 0;)
+	{
+		int parent = graph.nodes[i].parent;
+		if (parent >= 0)
+			spheres[parent] = mergeSpheres(spheres[parent], spheres[i]);
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		centreX[i] = spheres[i].centre.x;
+		centreY[i] = spheres[i].centre.y;
+		centreZ[i] = spheres[i].centre.z;
+		radius[i] = spheres[i].radius;
+	}
+}
+
+/* distance = the smallest of plane . centre + radius over the six planes */
+template <typename Lane>
+static void cullKernel(const Frustum& frustum, const float* centreX, const float* centreY, const float* centreZ, const float* radius, float* distance, size_t count)
+{
+	typedef typename Lane::type V;
+
+	V plane[6][4];
+	for (int p = 0; p < 6; p++)
+		for (int k = 0; k < 4; k++)
+			plane[p][k] = Lane::set(frustum.planes[p][k]);
+
+	for (size_t i = 0; i < count; i += Lane::width)
+	{
+		V x = Lane::load(&centreX[i]);
+		V y = Lane::load(&centreY[i]);
+		V z = Lane::load(&centreZ[i]);
+		V r = Lane::load(&radius[i]);
+
+		V nearest = Lane::set(3.4e38f);
+		for (int p = 0; p < 6; p++)
+		{
+			V d = Lane::add(Lane::add(Lane::mul(plane[p][0], x), Lane::mul(plane[p][1], y)), Lane::add(Lane::mul(plane[p][2], z), plane[p][3]));
+			nearest = Lane::min(nearest, Lane::add(d, r));
+		}
+		Lane::store(&distance[i], nearest);
+	}
+}
+
+void SceneBounds::cull(const SceneGraph& graph, const Frustum& frustum, TransformKernel kernel)
+{
+	size_t padded = centreX.size();
+	if (padded == 0)
+		return;
+
+	switch (resolveKernel(kernel))
+	{
+#ifdef TRANSFORM_AVX
+	case KERNEL_AVX:
+		cullKernel<AvxLane>(frustum, &centreX[0], &centreY[0], &centreZ[0], &radius[0], &distance[0], padded);
+		break;
+#endif
+#ifdef TRANSFORM_SSE
+	case KERNEL_SSE:
+		cullKernel<SseLane>(frustum, &centreX[0], &centreY[0], &centreZ[0], &radius[0], &distance[0], padded);
+		break;
+#endif
+	default:
+		cullKernel<ScalarLane>(frustum, &centreX[0], &centreY[0], &centreZ[0], &radius[0], &distance[0], padded);
+		break;
+	}
+
+	// a node is only drawn if everything above it is in the frustum too
+	for (size_t i = 0; i < count; i++)
+	{
+		int parent = graph.nodes[i].parent;
+		visible[i] = distance[i] >= 0.f && (parent < 0 || visible[parent]);
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef FRUSTUMCULLING_H
+#define FRUSTUMCULLING_H
+
+#include "SceneGraph.h"
+#include "TransformSoA.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+struct BoundingSphere
+{
+	glm::vec3 centre;
+	float radius;		// negative for an empty sphere
+};
+
+BoundingSphere sphereFromBox(glm::vec3 boundsMin, glm::vec3 boundsMax);
+
+// the smallest sphere holding both spheres
+BoundingSphere mergeSpheres(const BoundingSphere& a, const BoundingSphere& b);
+
+/* The six planes of a view frustum (left, right, bottom, top, near, far) with normals pointing
+   inwards, taken from a projection * view matrix. Works for perspective and orthographic */
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+Frustum frustumFromMatrix(const glm::mat4& viewProjection);
+
+/* World space bounding spheres for every node of a scene graph, stored as a structure of arrays
+   so they can be tested against a frustum 4 or 8 at a time. A node with a mesh gets its mesh's
+   sphere moved to world space, and every node's sphere is then grown to hold its children's,
+   so a node that is outside the frustum has its whole subtree outside */
+class SceneBounds
+{
+public:
+	SceneBounds();
+	~SceneBounds();
+
+	// meshBounds is indexed by the nodes' mesh ids
+	void update(const SceneGraph& graph, const BoundingSphere* meshBounds);
+
+	/* Tests every sphere against the frustum, then hides the children of hidden nodes.
+	   visible[node] is set for nodes that have to be drawn */
+	void cull(const SceneGraph& graph, const Frustum& frustum, TransformKernel kernel = KERNEL_BEST);
+
+	size_t size() const;
+	BoundingSphere getSphere(size_t i) const;
+
+	std::vector<float> centreX, centreY, centreZ, radius;	// padded to a multiple of 8
+	std::vector<float> distance;	// how far each sphere reaches inside the frustum, negative when outside
+	std::vector<char> visible;
+
+private:
+	size_t count;
+	std::vector<BoundingSphere> spheres;	// the spheres are merged up the hierarchy here before being split into the arrays
+};
+
+#endif
@@ -0,0 +1,267 @@
+#include "Headless.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <iostream>
+
+#ifdef HEADLESS_EGL
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+HeadlessContext::HeadlessContext()
+{
+	width = height = 0;
+	frameBuffer = colourBuffer = depthBuffer = 0;
+	display = context = NULL;
+}
+
+HeadlessContext::~HeadlessContext()
+{
+	destroy();
+}
+
+#ifdef HEADLESS_EGL
+/* The Mesa surfaceless platform needs no display server at all, otherwise the default display is tried */
+static EGLDisplay headlessDisplay()
+{
+	const char* extensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	if (extensions && std::string(extensions).find("EGL_MESA_platform_surfaceless") != std::string::npos)
+	{
+		PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+		if (getPlatformDisplay)
+		{
+			EGLDisplay display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+			if (display != EGL_NO_DISPLAY)
+				return display;
+		}
+	}
+	return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+static bool createContext(void*& display, void*& context)
+{
+	EGLDisplay eglDisplay = headlessDisplay();
+	EGLint major, minor;
+	if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, &major, &minor))
+	{
+		std::cout << "headless: no EGL display" << std::endl;
+		return false;
+	}
+	display = eglDisplay;
+
+	/* nothing is drawn to an EGL surface, so any config that can make a desktop GL context will do.
+	   The surface type has to be given, it defaults to windows and there are none without a display */
+	const EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(eglDisplay, configAttributes, &config, 1, &numConfigs) || numConfigs == 0 || !eglBindAPI(EGL_OPENGL_API))
+	{
+		std::cout << "headless: no EGL config for OpenGL" << std::endl;
+		return false;
+	}
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 2,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE };
+	EGLContext eglContext = eglCreateContext(eglDisplay, config, EGL_NO_CONTEXT, contextAttributes);
+	if (eglContext == EGL_NO_CONTEXT || !eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+	{
+		std::cout << "headless: couldn't make an OpenGL 4.2 core context current" << std::endl;
+		return false;
+	}
+	context = eglContext;
+	return true;
+}
+
+GLFWglproc HeadlessContext::getProcAddress(const char* name)
+{
+	return (GLFWglproc)eglGetProcAddress(name);
+}
+
+static void destroyContext(void* display, void* context)
+{
+	if (!display)
+		return;
+	eglMakeCurrent((EGLDisplay)display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	if (context)
+		eglDestroyContext((EGLDisplay)display, (EGLContext)context);
+	eglTerminate((EGLDisplay)display);
+}
+#else
+/* The window is never shown, its context is only used to draw into the frame buffer object */
+static bool createContext(void*& display, void*& context)
+{
+	if (!glfwInit())
+	{
+		std::cout << "headless: glfwInit failed" << std::endl;
+		return false;
+	}
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	GLFWwindow* window = glfwCreateWindow(16, 16, "headless", NULL, NULL);
+	if (!window)
+	{
+		std::cout << "headless: couldn't create a hidden window" << std::endl;
+		glfwTerminate();
+		return false;
+	}
+	glfwMakeContextCurrent(window);
+	display = window;
+	context = NULL;
+	return true;
+}
+
+GLFWglproc HeadlessContext::getProcAddress(const char* name)
+{
+	return glfwGetProcAddress(name);
+}
+
+static void destroyContext(void* display, void* context)
+{
+	if (!display)
+		return;
+	glfwDestroyWindow((GLFWwindow*)display);
+	glfwTerminate();
+}
+#endif
+
+bool HeadlessContext::create(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	if (!createContext(display, context))
+	{
+		destroy();
+		return false;
+	}
+	if (!ogl_LoadFunctions())
+	{
+		std::cout << "headless: ogl_LoadFunctions() failed" << std::endl;
+		destroy();
+		return false;
+	}
+
+	glGenRenderbuffers(1, &colourBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colourBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &frameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colourBuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	if (!complete)
+	{
+		std::cout << "headless frame buffer invalid" << std::endl;
+		destroy();
+		return false;
+	}
+	return true;
+}
+
+void HeadlessContext::destroy()
+{
+	if (frameBuffer)
+	{
+		glDeleteFramebuffers(1, &frameBuffer);
+		glDeleteRenderbuffers(1, &colourBuffer);
+		glDeleteRenderbuffers(1, &depthBuffer);
+		frameBuffer = colourBuffer = depthBuffer = 0;
+	}
+	destroyContext(display, context);
+	display = context = NULL;
+}
+
+void HeadlessContext::readPixels(std::vector<unsigned char>& pixels)
+{
+	// GL's rows start at the bottom
+	rows.resize((size_t)width * height * 3);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffer);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &rows[0]);
+
+	size_t rowSize = (size_t)width * 3;
+	pixels.resize(rows.size());
+	for (int y = 0; y < height; y++)
+		std::copy(rows.begin() + (height - 1 - y) * rowSize, rows.begin() + (height - y) * rowSize, pixels.begin() + y * rowSize);
+}
+
+bool HeadlessContext::writeImage(const std::string& path)
+{
+	std::vector<unsigned char> pixels;
+	readPixels(pixels);
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+	file << "P6\n" << width << " " << height << "\n255\n";
+	file.write((const char*)&pixels[0], pixels.size());
+	return (bool)file;
+}
+
+static GLuint compileShader(GLenum type, const char* path)
+{
+	std::ifstream file(path);
+	if (!file)
+		throw std::runtime_error(std::string("can't open shader ") + path);
+	std::stringstream source;
+	source << file.rdbuf();
+	std::string text = source.str();
+	const char* textPointer = text.c_str();
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &textPointer, NULL);
+	glCompileShader(shader);
+
+	GLint compiled;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+	if (!compiled)
+	{
+		GLint length;
+		glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+		std::string log(length > 0 ? length : 1, '\0');
+		glGetShaderInfoLog(shader, (GLsizei)log.size(), NULL, &log[0]);
+		glDeleteShader(shader);
+		throw std::runtime_error(std::string("shader ") + path + " failed to compile: " + log);
+	}
+	return shader;
+}
+
+GLuint loadShaderProgram(const char* vertexPath, const char* fragmentPath)
+{
+	GLuint vertexShader = compileShader(GL_VERTEX_SHADER, vertexPath);
+	GLuint fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentPath);
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, vertexShader);
+	glAttachShader(program, fragmentShader);
+	glLinkProgram(program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint linked;
+	glGetProgramiv(program, GL_LINK_STATUS, &linked);
+	if (!linked)
+	{
+		GLint length;
+		glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+		std::string log(length > 0 ? length : 1, '\0');
+		glGetProgramInfoLog(program, (GLsizei)log.size(), NULL, &log[0]);
+		glDeleteProgram(program);
+		throw std::runtime_error(std::string("shaders ") + vertexPath + " and " + fragmentPath + " failed to link: " + log);
+	}
+	return program;
+}
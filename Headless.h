@@ -0,0 +1,48 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include "wrapper_glfw.h"
+#include <string>
+#include <vector>
+
+/* An OpenGL context with no window, for running the renderer on machines without a display.
+   With HEADLESS_EGL defined the context comes from EGL, on the Mesa surfaceless platform when
+   there is one, so it works with llvmpipe and no GPU. Without it a hidden GLFW window is used.
+   Either way the frames are drawn into a frame buffer object of the given size rather than a
+   window, and can be read back and saved */
+class HeadlessContext
+{
+public:
+	HeadlessContext();
+	~HeadlessContext();
+
+	// makes a 4.2 core context current and creates the frame buffer, false if there is no context to be had
+	bool create(int width, int height);
+	void destroy();
+
+	// the frame as rows of RGB bytes, top row first
+	void readPixels(std::vector<unsigned char>& pixels);
+
+	// saves the frame as a binary PPM image
+	bool writeImage(const std::string& path);
+
+	// looks up a GL function through EGL or GLFW, whichever made the context
+	static GLFWglproc getProcAddress(const char* name);
+
+	int width, height;
+	GLuint frameBuffer;		// draw the frames into this instead of frame buffer 0
+
+private:
+	GLuint colourBuffer, depthBuffer;
+	std::vector<unsigned char> rows;
+
+	// EGLDisplay and EGLContext, or the hidden GLFWwindow
+	void* display;
+	void* context;
+};
+
+/* Compiles and links a vertex and fragment shader from their files, what GLWrapper::LoadShader
+   does for a window. Throws a runtime_error with the shader log when they don't build */
+GLuint loadShaderProgram(const char* vertexPath, const char* fragmentPath);
+
+#endif
@@ -0,0 +1,157 @@
+#include "InputLog.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+static const char inputLogMagic[8] = { 'D', 'R', 'O', 'N', 'E', 'I', 'N', 'P' };
+static const unsigned int inputLogVersion = 1;
+
+// GLFW_RELEASE and GLFW_PRESS, the log and the keys don't need GLFW
+static const int keyRelease = 0, keyPress = 1;
+
+InputLog::InputLog()
+{
+	ticksPerSecond = 60;
+	clear();
+}
+
+InputLog::~InputLog()
+{}
+
+void InputLog::clear()
+{
+	events.clear();
+	endTick = 0;
+	replayed = 0;
+}
+
+void InputLog::record(unsigned int tick, int key, int action)
+{
+	InputEvent event = { tick, key, action };
+	events.push_back(event);
+	if (tick > endTick)
+		endTick = tick;
+}
+
+// written a byte at a time so the file is the same on any machine
+static void putBytes(std::vector<unsigned char>& out, unsigned int value, int bytes)
+{
+	for (int i = 0; i < bytes; i++)
+		out.push_back((unsigned char)(value >> (8 * i)));
+}
+
+static unsigned int getBytes(const unsigned char* in, int bytes)
+{
+	unsigned int value = 0;
+	for (int i = 0; i < bytes; i++)
+		value |= (unsigned int)in[i] << (8 * i);
+	return value;
+}
+
+bool InputLog::save(const std::string& path) const
+{
+	std::vector<unsigned char> data(inputLogMagic, inputLogMagic + sizeof(inputLogMagic));
+	putBytes(data, inputLogVersion, 4);
+	putBytes(data, ticksPerSecond, 4);
+	putBytes(data, endTick, 4);
+	putBytes(data, (unsigned int)events.size(), 4);
+	for (const InputEvent& event : events)
+	{
+		putBytes(data, event.tick, 4);
+		putBytes(data, (unsigned int)event.key, 2);
+		putBytes(data, (unsigned int)event.action, 1);
+		putBytes(data, 0, 1);
+	}
+
+	std::ofstream file(path.c_str(), std::ios::binary);
+	file.write((const char*)&data[0], data.size());
+	return (bool)file;
+}
+
+bool InputLog::load(const std::string& path)
+{
+	clear();
+	std::ifstream file(path.c_str(), std::ios::binary);
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	const size_t headerSize = sizeof(inputLogMagic) + 16;
+	if (data.size() < headerSize || memcmp(&data[0], inputLogMagic, sizeof(inputLogMagic)) != 0 ||
+		getBytes(&data[8], 4) != inputLogVersion)
+		return false;
+
+	ticksPerSecond = getBytes(&data[12], 4);
+	unsigned int end = getBytes(&data[16], 4);
+	size_t numEvents = getBytes(&data[20], 4);
+	if (ticksPerSecond == 0 || data.size() != headerSize + numEvents * 8)
+		return false;
+
+	for (size_t i = 0; i < numEvents; i++)
+	{
+		const unsigned char* in = &data[headerSize + i * 8];
+		// keys are signed, GLFW_KEY_UNKNOWN is -1
+		record(getBytes(in, 4), (short)getBytes(in + 4, 2), in[6]);
+	}
+	endTick = end;
+	return true;
+}
+
+bool InputLog::nextEvent(unsigned int tick, InputEvent& event)
+{
+	if (replayed == events.size() || events[replayed].tick > tick)
+		return false;
+	event = events[replayed++];
+	return true;
+}
+
+unsigned int InputLog::nextEventTick() const
+{
+	return replayed < events.size() ? events[replayed].tick : endTick;
+}
+
+void InputLog::rewind()
+{
+	replayed = 0;
+}
+
+void InputLog::replayTicks(unsigned long long firstTick, int ticks, const std::function<void(const InputEvent&)>& applyKey,
+	const std::function<void(int)>& simulate)
+{
+	unsigned long long tick = firstTick;
+	int remaining = (int)std::min((unsigned long long)ticks, tick < endTick ? endTick - tick : 0ull);
+	InputEvent event;
+	while (nextEvent((unsigned int)tick, event))
+		applyKey(event);
+	while (remaining > 0 && nextEventTick() > tick && nextEventTick() < tick + remaining)
+	{
+		int part = (int)(nextEventTick() - tick);
+		simulate(part);
+		tick += part;
+		remaining -= part;
+		while (nextEvent((unsigned int)tick, event))
+			applyKey(event);
+	}
+	simulate(remaining);
+}
+
+void flyKey(int key, int action, float speed, float& moveX, float& moveY, float& moveZ)
+{
+	float* move;
+	float direction;
+	switch (key)
+	{
+	case 'A': move = &moveX; direction = 1.f; break;	// left
+	case 'D': move = &moveX; direction = -1.f; break;	// right
+	case 'W': move = &moveZ; direction = 1.f; break;	// forward
+	case 'S': move = &moveZ; direction = -1.f; break;	// back
+	case 'E': move = &moveY; direction = 1.f; break;	// up
+	case 'Q': move = &moveY; direction = -1.f; break;	// down
+	default: return;
+	}
+
+	// a held key's repeats leave it moving
+	if (action == keyPress)
+		*move = direction * speed;
+	else if (action == keyRelease)
+		*move = 0.f;
+}
@@ -0,0 +1,61 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+/* A key press or release and the simulation tick it came before. Events with the same tick
+   happened in the order they are stored */
+struct InputEvent
+{
+	unsigned int tick;
+	int key;
+	int action;
+};
+
+/* A recorded session's input, for replaying it as a repeatable run. Input is only ever applied
+   between ticks and the simulation doesn't depend on anything else, so feeding the events back
+   before the same ticks reproduces the session whatever the frame rate.
+   The file is a short header followed by 8 bytes per event, little endian:
+	"DRONEINP", version, ticks per second, end tick, number of events (4 bytes each)
+	each event: tick (4 bytes), key (2 bytes), action (1 byte), unused (1 byte) */
+class InputLog
+{
+public:
+	InputLog();
+	~InputLog();
+
+	void clear();
+	void record(unsigned int tick, int key, int action);
+
+	bool save(const std::string& path) const;
+	bool load(const std::string& path);
+
+	// replaying: the next event at or before tick, false once they have all been taken
+	bool nextEvent(unsigned int tick, InputEvent& event);
+
+	// the tick the next event comes before, or endTick when there are none left
+	unsigned int nextEventTick() const;
+
+	void rewind();
+
+	/* Runs a frame of ticks, the first being firstTick, with the replayed keys in between: the
+	   events due before each tick go to applyKey and each run of ticks up to the next event to
+	   simulate, which is always called last with what is left, even 0. Stops at endTick */
+	void replayTicks(unsigned long long firstTick, int ticks, const std::function<void(const InputEvent&)>& applyKey,
+		const std::function<void(int)>& simulate);
+
+	std::vector<InputEvent> events;
+	unsigned int ticksPerSecond;
+	unsigned int endTick;	// the session ran this many ticks
+
+private:
+	size_t replayed;
+};
+
+/* Fly mode's movement keys: a press sets the drone's velocity on the key's axis to speed one way
+   or the other, and releasing the key stops it */
+void flyKey(int key, int action, float speed, float& moveX, float& moveY, float& moveZ);
+
+#endif
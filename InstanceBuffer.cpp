@@ -0,0 +1,105 @@
+#include "InstanceBuffer.h"
+#include "RenderStats.h"
+
+#include <cstddef>
+
+UploadRing* InstanceBuffer::uploadRing = NULL;
+
+InstanceBuffer::InstanceBuffer()
+{
+	instanceBufferObject = 0;
+
+	// the mat4 uses 4 attribute slots and the mat3 uses 3
+	attribute_i_model = 3;
+	attribute_i_normal_matrix = 7;
+	attribute_i_colour = 10;
+	attribute_i_reflectiveness = 11;
+}
+
+InstanceBuffer::~InstanceBuffer()
+{}
+
+void InstanceBuffer::addInstance(const glm::mat4& model, const glm::mat3& normalMatrix, const glm::vec4& colour, GLfloat reflectiveness)
+{
+	InstanceData instance;
+	instance.model = model;
+	instance.normalMatrix = normalMatrix;
+	instance.colour = colour;
+	instance.reflectiveness = reflectiveness;
+	this->instances.push_back(instance);
+}
+
+void InstanceBuffer::clear()
+{
+	this->instances.clear();
+}
+
+GLsizei InstanceBuffer::numInstances() const
+{
+	return (GLsizei)this->instances.size();
+}
+
+void InstanceBuffer::bindInstances()
+{
+	GLsizei stride = sizeof(InstanceData);
+	GLsizeiptr size = sizeof(InstanceData) * this->instances.size();
+
+	// the ring needs no upload call, the attributes just point at where the instances were copied
+	GLintptr offset = uploadRing ? uploadRing->write(this->instances.data(), size, stride) : -1;
+	if (offset >= 0)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, uploadRing->bufferObject);
+	}
+	else
+	{
+		// the buffer is created on first use as the objects are constructed before there is a GL context
+		if (this->instanceBufferObject == 0)
+		{
+			glGenBuffers(1, &this->instanceBufferObject);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, this->instanceBufferObject);
+		glBufferData(GL_ARRAY_BUFFER, size, this->instances.data(), GL_STREAM_DRAW);
+		renderStats.partSetupCalls++;
+		offset = 0;
+	}
+
+	// model matrix, one column per attribute
+	for (GLuint i = 0; i < 4; i++)
+	{
+		glEnableVertexAttribArray(attribute_i_model + i);
+		glVertexAttribPointer(attribute_i_model + i, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, model) + sizeof(glm::vec4) * i));
+		glVertexAttribDivisor(attribute_i_model + i, 1);
+	}
+
+	// normal matrix, one column per attribute
+	for (GLuint i = 0; i < 3; i++)
+	{
+		glEnableVertexAttribArray(attribute_i_normal_matrix + i);
+		glVertexAttribPointer(attribute_i_normal_matrix + i, 3, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, normalMatrix) + sizeof(glm::vec3) * i));
+		glVertexAttribDivisor(attribute_i_normal_matrix + i, 1);
+	}
+
+	glEnableVertexAttribArray(attribute_i_colour);
+	glVertexAttribPointer(attribute_i_colour, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, colour)));
+	glVertexAttribDivisor(attribute_i_colour, 1);
+
+	glEnableVertexAttribArray(attribute_i_reflectiveness);
+	glVertexAttribPointer(attribute_i_reflectiveness, 1, GL_FLOAT, GL_FALSE, stride, (void*)(offset + offsetof(InstanceData, reflectiveness)));
+	glVertexAttribDivisor(attribute_i_reflectiveness, 1);
+
+	// the buffer bind and three calls for each of the 9 attribute slots
+	renderStats.partSetupCalls += 1 + 3 * (attribute_i_reflectiveness - attribute_i_model + 1);
+}
+
+void InstanceBuffer::unbindInstances()
+{
+	// disable the instanced attributes again so they do not affect the non instanced draws
+	for (GLuint i = attribute_i_model; i <= attribute_i_reflectiveness; i++)
+	{
+		glVertexAttribDivisor(i, 0);
+		glDisableVertexAttribArray(i);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	renderStats.partSetupCalls += 1 + 2 * (attribute_i_reflectiveness - attribute_i_model + 1);
+}
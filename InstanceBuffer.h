@@ -0,0 +1,48 @@
+#ifndef INSTANCEBUFFER_H
+#define INSTANCEBUFFER_H
+
+#include "wrapper_glfw.h"
+#include "UploadRing.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+// per-instance data read by poslight.vert and shadows.vert when instanced mode is on
+struct InstanceData
+{
+	glm::mat4 model;
+	glm::mat3 normalMatrix;
+	glm::vec4 colour;
+	GLfloat reflectiveness;
+};
+
+class InstanceBuffer
+{
+public:
+	InstanceBuffer();
+	~InstanceBuffer();
+
+	void addInstance(const glm::mat4& model, const glm::mat3& normalMatrix, const glm::vec4& colour, GLfloat reflectiveness);
+	void clear();
+
+	/* uploads the queued instances and points the per-instance attributes at them. They go into
+	   uploadRing when it is set and has room, otherwise into the instance buffer's own buffer */
+	void bindInstances();
+	void unbindInstances();
+
+	GLsizei numInstances() const;
+
+	GLuint instanceBufferObject;
+
+	// shared by every instance buffer, NULL to upload each one with glBufferData
+	static UploadRing* uploadRing;
+
+	GLuint attribute_i_model;
+	GLuint attribute_i_normal_matrix;
+	GLuint attribute_i_colour;
+	GLuint attribute_i_reflectiveness;
+
+private:
+	std::vector<InstanceData> instances;
+};
+
+#endif
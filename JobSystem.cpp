@@ -0,0 +1,208 @@
+#include "JobSystem.h"
+
+// the queue of the thread running the code, 0 for the owning thread and any thread outside the system
+static thread_local int threadIndex = 0;
+
+JobSystem::JobSystem()
+{
+	queued = 0;
+	stopping = false;
+	numRun = 0;
+	numStolen = 0;
+	queues.emplace_back(new WorkQueue());
+}
+
+JobSystem::~JobSystem()
+{
+	stop();
+}
+
+void JobSystem::start(int numWorkers)
+{
+	stop();
+
+	queues.clear();
+	for (int i = 0; i <= numWorkers; i++)
+		queues.emplace_back(new WorkQueue());
+
+	stopping = false;
+	for (int i = 1; i <= numWorkers; i++)
+		workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (std::thread& worker : workers)
+		worker.join();
+	workers.clear();
+}
+
+int JobSystem::numThreads() const
+{
+	return (int)workers.size() + 1;
+}
+
+JobHandle JobSystem::createJob(std::function<void()> function, const JobHandle* dependencies, int numDependencies)
+{
+	allJobs.emplace_back(new Job());
+	Job* job = allJobs.back().get();
+	job->function = function;
+	job->done = false;
+	job->finished = false;
+
+	// the extra count stops a dependency that finishes while this loop runs from queueing the job early
+	job->waitingFor = 1;
+	for (int i = 0; i < numDependencies; i++)
+	{
+		Job* dependency = dependencies[i];
+		std::lock_guard<std::mutex> lock(dependency->mutex);
+		if (!dependency->finished)
+		{
+			dependency->dependents.push_back(job);
+			job->waitingFor++;
+		}
+	}
+
+	if (--job->waitingFor == 0)
+		push(job);
+	return job;
+}
+
+JobHandle JobSystem::createJob(std::function<void()> function, const std::vector<JobHandle>& dependencies)
+{
+	return createJob(function, dependencies.data(), (int)dependencies.size());
+}
+
+JobHandle JobSystem::parallelFor(size_t count, size_t chunkSize, std::function<void(size_t, size_t)> function, const std::vector<JobHandle>& dependencies)
+{
+	chunkSize = chunkSize > 0 ? chunkSize : 1;
+	std::vector<JobHandle> chunks;
+	for (size_t begin = 0; begin < count; begin += chunkSize)
+	{
+		size_t end = begin + chunkSize < count ? begin + chunkSize : count;
+		chunks.push_back(createJob([function, begin, end]() { function(begin, end); }, dependencies));
+	}
+
+	// with nothing to do the join still waits for the dependencies
+	return createJob([]() {}, chunks.empty() ? dependencies : chunks);
+}
+
+void JobSystem::push(Job* job)
+{
+	WorkQueue& queue = *queues[threadIndex < (int)queues.size() ? threadIndex : 0];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(job);
+	}
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+Job* JobSystem::pop(int thread)
+{
+	// newest first from our own queue, it is the most likely to still be in the cache
+	{
+		WorkQueue& queue = *queues[thread];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			Job* job = queue.jobs.back();
+			queue.jobs.pop_back();
+			queued--;
+			return job;
+		}
+	}
+
+	// then the oldest from someone else's, starting with the next thread along
+	int numQueues = (int)queues.size();
+	for (int i = 1; i < numQueues; i++)
+	{
+		WorkQueue& queue = *queues[(thread + i) % numQueues];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			Job* job = queue.jobs.front();
+			queue.jobs.pop_front();
+			queued--;
+			numStolen++;
+			return job;
+		}
+	}
+	return NULL;
+}
+
+void JobSystem::run(Job* job)
+{
+	job->function();
+	numRun++;
+
+	std::vector<Job*> ready;
+	{
+		std::lock_guard<std::mutex> lock(job->mutex);
+		job->finished = true;
+		ready.swap(job->dependents);
+	}
+
+	/* Marked done before the dependents are queued, as once the last of them has run the owning
+	   thread can clear() the jobs, this one included */
+	job->done = true;
+	for (Job* dependent : ready)
+	{
+		if (--dependent->waitingFor == 0)
+			push(dependent);
+	}
+}
+
+void JobSystem::workerLoop(int thread)
+{
+	threadIndex = thread;
+	while (true)
+	{
+		Job* job = pop(thread);
+		if (job)
+		{
+			run(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		wake.wait(lock, [this]() { return queued > 0 || stopping; });
+		if (stopping)
+			return;
+	}
+}
+
+void JobSystem::wait(JobHandle job)
+{
+	while (!job->done)
+	{
+		Job* next = pop(threadIndex);
+		if (next)
+			run(next);
+		else
+			std::this_thread::yield();
+	}
+}
+
+void JobSystem::clear()
+{
+	allJobs.clear();
+}
+
+unsigned int JobSystem::jobsRun() const
+{
+	return numRun;
+}
+
+unsigned int JobSystem::jobsStolen() const
+{
+	return numStolen;
+}
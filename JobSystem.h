@@ -0,0 +1,88 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <functional>
+#include <cstddef>
+
+/* A job is a function that runs once all the jobs it depends on have finished */
+struct Job
+{
+	std::function<void()> function;
+	std::atomic<int> waitingFor;		// unfinished dependencies, plus one while the job is being created
+	std::atomic<bool> done;
+
+	std::mutex mutex;					// guards finished and dependents
+	bool finished;
+	std::vector<Job*> dependents;
+};
+
+typedef Job* JobHandle;
+
+/* A small work stealing job system. Each thread has its own queue; a thread takes the newest
+   job from its own queue, and when that is empty it steals the oldest job from another thread's.
+   A finished job queues the jobs waiting on it on the thread that finished it.
+   The thread that owns the system creates the jobs and helps run them while it waits, so with
+   no worker threads everything simply runs on that thread inside wait(). Jobs are kept until
+   clear() is called, which must only happen once every job has finished, so the job waited on
+   should depend on all the others */
+class JobSystem
+{
+public:
+	JobSystem();
+	~JobSystem();
+
+	// starts numWorkers threads besides the one that owns the system, stopping any there were
+	void start(int numWorkers);
+	void stop();
+
+	// the worker threads plus the owning thread
+	int numThreads() const;
+
+	JobHandle createJob(std::function<void()> function, const JobHandle* dependencies = NULL, int numDependencies = 0);
+	JobHandle createJob(std::function<void()> function, const std::vector<JobHandle>& dependencies);
+
+	/* Splits [0, count) into chunks of chunkSize and runs function(begin, end) on each as a job,
+	   after the dependencies. Returns a job that finishes once every chunk has */
+	JobHandle parallelFor(size_t count, size_t chunkSize, std::function<void(size_t, size_t)> function, const std::vector<JobHandle>& dependencies = std::vector<JobHandle>());
+
+	// runs jobs until this one has finished
+	void wait(JobHandle job);
+
+	// frees the jobs created so far, every one of them must have finished
+	void clear();
+
+	unsigned int jobsRun() const;
+	unsigned int jobsStolen() const;
+
+private:
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<Job*> jobs;
+	};
+
+	void push(Job* job);
+	Job* pop(int thread);
+	void run(Job* job);
+	void workerLoop(int thread);
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;		// queues[0] belongs to the owning thread
+	std::vector<std::thread> workers;
+	std::vector<std::unique_ptr<Job>> allJobs;
+
+	std::atomic<int> queued;
+	std::atomic<bool> stopping;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	std::atomic<unsigned int> numRun, numStolen;
+};
+
+#endif
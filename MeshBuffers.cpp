@@ -0,0 +1,194 @@
+#include "MeshBuffers.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <tuple>
+
+MeshBuffers::MeshBuffers()
+{
+	vertexBuffer = elementBuffer = vertexArray = 0;
+	arena = NULL;
+	format = fullVertexFormat;
+	indexType = GL_UNSIGNED_SHORT;
+	indexSize = sizeof(GLushort);
+	baseVertex = 0;
+	indexOffset = 0;
+	numVertices = numIndices = 0;
+	boundsMin = boundsMax = glm::vec3(0.f);
+}
+
+MeshBuffers::~MeshBuffers()
+{
+	// the arena's buffers stay until the arena goes
+	if (arena)
+		return;
+
+	glDeleteVertexArrays(1, &vertexArray);
+	glDeleteBuffers(1, &vertexBuffer);
+	if (elementBuffer)
+		glDeleteBuffers(1, &elementBuffer);
+}
+
+/* Points the attributes and element buffer of a new vertex array object at the buffers */
+static GLuint createVertexArray(const VertexFormat& format, GLuint vertexBuffer, GLuint elementBuffer,
+	GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute)
+{
+	// leave the previously bound vertex array current
+	GLint previousVertexArray;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &previousVertexArray);
+
+	GLuint vertexArray;
+	glGenVertexArrays(1, &vertexArray);
+	glBindVertexArray(vertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	setVertexAttributes(format, positionAttribute, normalAttribute, colourAttribute);
+	if (elementBuffer)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+
+	glBindVertexArray(previousVertexArray);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	return vertexArray;
+}
+
+std::shared_ptr<MeshBuffers> createMeshBuffers(const VertexFormat& format, const std::vector<unsigned char>& vertices,
+	const std::vector<GLuint>& indices, MeshArena* arena, GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute)
+{
+	std::shared_ptr<MeshBuffers> buffers = std::make_shared<MeshBuffers>();
+	buffers->format = format;
+	buffers->numVertices = (int)(vertices.size() / format.stride());
+	buffers->numIndices = (int)indices.size();
+
+	// 16 bit indices whenever they fit, they always do for the meshes in the arena
+	bool shortIndices = indices.empty() || *std::max_element(indices.begin(), indices.end()) <= 0xffff;
+	std::vector<GLushort> shortIndexData;
+	if (shortIndices)
+		shortIndexData.assign(indices.begin(), indices.end());
+	buffers->indexType = shortIndices ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+	buffers->indexSize = shortIndices ? sizeof(GLushort) : sizeof(GLuint);
+
+	if (arena && !indices.empty() && shortIndices && arena->add(format, vertices, shortIndexData, buffers->baseVertex, buffers->indexOffset))
+	{
+		buffers->arena = arena;
+		buffers->vertexBuffer = arena->vertexBuffer;
+		buffers->elementBuffer = arena->elementBuffer;
+		buffers->vertexArray = arena->vertexArray;
+		return buffers;
+	}
+
+	glGenBuffers(1, &buffers->vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers->vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size(), &vertices[0], GL_STATIC_DRAW);
+
+	if (!indices.empty())
+	{
+		glGenBuffers(1, &buffers->elementBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers->elementBuffer);
+		if (shortIndices)
+			glBufferData(GL_ARRAY_BUFFER, shortIndexData.size() * sizeof(GLushort), &shortIndexData[0], GL_STATIC_DRAW);
+		else
+			glBufferData(GL_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	buffers->vertexArray = createVertexArray(format, buffers->vertexBuffer, buffers->elementBuffer, positionAttribute, normalAttribute, colourAttribute);
+	return buffers;
+}
+
+MeshArena::MeshArena()
+{
+	format = compactVertexFormat;
+	vertexBuffer = elementBuffer = vertexArray = 0;
+	maxVertices = maxIndices = 0;
+	numVertices = numIndices = 0;
+}
+
+MeshArena::~MeshArena()
+{}
+
+void MeshArena::create(const VertexFormat& format, int maxVertices, int maxIndices,
+	GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute)
+{
+	this->format = format;
+	this->maxVertices = maxVertices;
+	this->maxIndices = maxIndices;
+	numVertices = numIndices = 0;
+
+	glGenBuffers(1, &vertexBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxVertices * format.stride(), NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &elementBuffer);
+	glBindBuffer(GL_ARRAY_BUFFER, elementBuffer);
+	glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)maxIndices * sizeof(GLushort), NULL, GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	vertexArray = createVertexArray(format, vertexBuffer, elementBuffer, positionAttribute, normalAttribute, colourAttribute);
+}
+
+bool MeshArena::add(const VertexFormat& format, const std::vector<unsigned char>& vertices, const std::vector<GLushort>& indices,
+	GLint& baseVertex, size_t& indexOffset)
+{
+	int meshVertices = (int)(vertices.size() / format.stride());
+	if (vertexBuffer == 0 || format.halfPositions != this->format.halfPositions || format.colours != this->format.colours ||
+		numVertices + meshVertices > maxVertices || numIndices + (int)indices.size() > maxIndices)
+		return false;
+
+	baseVertex = numVertices;
+	indexOffset = numIndices * sizeof(GLushort);
+
+	glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)numVertices * format.stride(), vertices.size(), &vertices[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, elementBuffer);
+	glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)indexOffset, indices.size() * sizeof(GLushort), &indices[0]);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	numVertices += meshVertices;
+	numIndices += (int)indices.size();
+	return true;
+}
+
+bool MeshKey::operator<(const MeshKey& other) const
+{
+	return std::tie(generator, parameters[0], parameters[1], halfPositions, colours, indexed) <
+		std::tie(other.generator, other.parameters[0], other.parameters[1], other.halfPositions, other.colours, other.indexed);
+}
+
+MeshCache::MeshCache()
+{
+	arena = NULL;
+	hits = misses = 0;
+}
+
+MeshCache::~MeshCache()
+{}
+
+std::shared_ptr<MeshBuffers> MeshCache::find(const MeshKey& key)
+{
+	std::map<MeshKey, std::weak_ptr<MeshBuffers> >::iterator found = meshes.find(key);
+	std::shared_ptr<MeshBuffers> buffers;
+	if (found != meshes.end())
+		buffers = found->second.lock();
+
+	if (buffers)
+		hits++;
+	else
+		misses++;
+	return buffers;
+}
+
+void MeshCache::insert(const MeshKey& key, const std::shared_ptr<MeshBuffers>& buffers)
+{
+	meshes[key] = buffers;
+}
+
+static GLuint boundVertexArray = 0;
+
+void bindVertexArray(GLuint vertexArray)
+{
+	if (vertexArray == boundVertexArray)
+		return;
+
+	glBindVertexArray(vertexArray);
+	boundVertexArray = vertexArray;
+	renderStats.partSetupCalls++;
+}
@@ -0,0 +1,106 @@
+#ifndef MESHBUFFERS_H
+#define MESHBUFFERS_H
+
+#include "wrapper_glfw.h"
+#include "VertexFormat.h"
+#include <vector>
+#include <map>
+#include <memory>
+#include <glm/glm.hpp>
+
+class MeshArena;
+
+/* The GL objects for one mesh, shared between every mesh object made with the same
+   parameters. They are deleted when the last mesh using them lets go. A mesh in an arena
+   uses the arena's buffers and vertex array, starting at baseVertex and indexOffset */
+struct MeshBuffers
+{
+	MeshBuffers();
+	~MeshBuffers();
+
+	GLuint vertexBuffer;
+	GLuint elementBuffer;		// 0 for a mesh drawn without indices
+	GLuint vertexArray;
+	MeshArena* arena;			// the buffers belong to the arena rather than the mesh
+
+	VertexFormat format;
+	GLenum indexType;			// GL_UNSIGNED_SHORT unless an index doesn't fit
+	GLsizei indexSize;
+	GLint baseVertex;
+	size_t indexOffset;			// in bytes
+	int numVertices;
+	int numIndices;
+
+	glm::vec3 boundsMin, boundsMax;
+};
+
+/* Creates the buffers for a mesh's interleaved vertices and indices, in the arena if there is
+   one with room, and a vertex array object with the attributes and element buffer set up */
+std::shared_ptr<MeshBuffers> createMeshBuffers(const VertexFormat& format, const std::vector<unsigned char>& vertices,
+	const std::vector<GLuint>& indices, MeshArena* arena, GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute);
+
+/* One vertex buffer and one 16 bit index buffer holding many static meshes, all in the same
+   vertex format. The meshes are drawn with glDrawElementsBaseVertex, so they all share one
+   vertex array object and switching between them doesn't need any binds */
+class MeshArena
+{
+public:
+	MeshArena();
+	~MeshArena();
+
+	void create(const VertexFormat& format, int maxVertices, int maxIndices,
+		GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute);
+
+	// copies a mesh in, returning false if it doesn't fit or isn't in the arena's format
+	bool add(const VertexFormat& format, const std::vector<unsigned char>& vertices, const std::vector<GLushort>& indices,
+		GLint& baseVertex, size_t& indexOffset);
+
+	VertexFormat format;
+	GLuint vertexBuffer, elementBuffer, vertexArray;
+	int maxVertices, maxIndices;
+	int numVertices, numIndices;
+};
+
+// the generators a mesh can come from
+enum MeshGenerator
+{
+	GENERATOR_CUBE,
+	GENERATOR_TUBE
+};
+
+/* What a mesh was made from. Meshes with equal keys have identical buffers */
+struct MeshKey
+{
+	MeshGenerator generator;
+	int parameters[2];		// e.g. the tube's segments and its thickness in thousandths
+	bool halfPositions;
+	bool colours;
+	bool indexed;
+
+	bool operator<(const MeshKey& other) const;
+};
+
+/* Hands out shared buffers for meshes that have already been made with the same key, so
+   identical meshes only take up GPU memory once. The cache only keeps weak references, a
+   mesh's buffers go once nothing is drawing it any more */
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+
+	std::shared_ptr<MeshBuffers> find(const MeshKey& key);
+	void insert(const MeshKey& key, const std::shared_ptr<MeshBuffers>& buffers);
+
+	MeshArena* arena;		// new meshes are put in here when it is set
+	unsigned int hits, misses;
+
+private:
+	std::map<MeshKey, std::weak_ptr<MeshBuffers> > meshes;
+};
+
+/* Binds a vertex array object unless it is already bound, so consecutive meshes in the
+   same arena cost no binds at all */
+void bindVertexArray(GLuint vertexArray);
+
+#endif
@@ -0,0 +1,67 @@
+#include "MeshLod.h"
+
+#include <algorithm>
+
+int lodSegments(int finestSegments, int level, int minimumSegments)
+{
+	return std::max(finestSegments >> level, std::min(minimumSegments, finestSegments));
+}
+
+float projectedSize(float radius, float distance, float pixelsPerUnit)
+{
+	// inside the sphere it covers the screen
+	if (distance <= radius)
+		return 1e9f;
+	return 2.f * radius * pixelsPerUnit / distance;
+}
+
+int selectLod(const LodSettings& settings, int numLevels, float screenSize, int currentLod)
+{
+	currentLod = std::min(std::max(currentLod, 0), numLevels - 1);
+
+	// the coarser levels need the size to drop a little below the threshold,
+	// and the finer levels need it to rise a little above
+	int lod = currentLod;
+	while (lod + 1 < numLevels && screenSize < settings.minScreenSize[lod] * (1.f - settings.hysteresis))
+		lod++;
+	while (lod > 0 && screenSize >= settings.minScreenSize[lod - 1] * (1.f + settings.hysteresis))
+		lod--;
+	return lod;
+}
+
+LodSelector::LodSelector()
+{
+	settings = defaultLodSettings;
+}
+
+LodSelector::~LodSelector()
+{}
+
+void LodSelector::reset()
+{
+	std::fill(levels.begin(), levels.end(), 0);
+}
+
+void LodSelector::update(const SceneGraph& graph, const BoundingSphere* meshBounds, const int* meshLevels,
+	glm::vec3 cameraPosition, float pixelsPerUnit)
+{
+	levels.resize(graph.nodes.size(), 0);
+
+	for (size_t i = 0; i < graph.nodes.size(); i++)
+	{
+		const SceneNode& node = graph.nodes[i];
+		if (node.mesh < 0 || meshLevels[node.mesh] <= 1)
+		{
+			levels[i] = 0;
+			continue;
+		}
+
+		// the mesh's sphere in world space, as in SceneBounds::update
+		const BoundingSphere& mesh = meshBounds[node.mesh];
+		float scale = std::max(glm::length(glm::vec3(node.world[0])), std::max(glm::length(glm::vec3(node.world[1])), glm::length(glm::vec3(node.world[2]))));
+		glm::vec3 centre = glm::vec3(node.world * glm::vec4(mesh.centre, 1.f));
+		float size = projectedSize(mesh.radius * scale, glm::length(centre - cameraPosition), pixelsPerUnit);
+
+		levels[i] = (unsigned char)selectLod(settings, meshLevels[node.mesh], size, levels[i]);
+	}
+}
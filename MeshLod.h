@@ -0,0 +1,51 @@
+#ifndef MESHLOD_H
+#define MESHLOD_H
+
+#include "SceneGraph.h"
+#include "FrustumCulling.h"
+#include <vector>
+#include <glm/glm.hpp>
+
+// the most levels of detail a mesh can have, level 0 is the finest
+const int maxLods = 4;
+
+/* Where the levels switch over. Level i is used while the mesh's projected diameter is at
+   least minScreenSize[i] pixels. The hysteresis is the fraction the size has to move past a
+   threshold before the level changes back, so a part sitting on a threshold doesn't flicker */
+struct LodSettings
+{
+	float minScreenSize[maxLods];
+	float hysteresis;
+};
+
+const LodSettings defaultLodSettings = { { 64.f, 24.f, 10.f, 0.f }, 0.15f };
+
+// segments (or sphere rings) at a level: halved for each level down to a minimum
+int lodSegments(int finestSegments, int level, int minimumSegments);
+
+// diameter in pixels of a sphere at a distance, pixelsPerUnit = screen height / (2 tan(fovy / 2))
+float projectedSize(float radius, float distance, float pixelsPerUnit);
+
+int selectLod(const LodSettings& settings, int numLevels, float screenSize, int currentLod);
+
+/* Picks a level of detail for every node of a scene graph from its mesh's projected size,
+   remembering each node's level between frames for the hysteresis */
+class LodSelector
+{
+public:
+	LodSelector();
+	~LodSelector();
+
+	/* meshLevels is the number of levels each mesh id has, and meshBounds the sphere around
+	   each mesh. Nodes without a mesh are left at level 0 */
+	void update(const SceneGraph& graph, const BoundingSphere* meshBounds, const int* meshLevels,
+		glm::vec3 cameraPosition, float pixelsPerUnit);
+
+	// puts every node back to the finest level
+	void reset();
+
+	LodSettings settings;
+	std::vector<unsigned char> levels;	// for each node
+};
+
+#endif
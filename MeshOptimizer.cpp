@@ -0,0 +1,235 @@
+#include "MeshOptimizer.h"
+
+#include <cmath>
+#include <algorithm>
+
+void deduplicateVertices(std::vector<GLfloat>& positions, std::vector<GLfloat>& normals, std::vector<GLfloat>& colours,
+	std::vector<GLuint>& indices)
+{
+	size_t numVertices = positions.size() / 3;
+	std::vector<GLfloat> uniquePositions, uniqueNormals, uniqueColours;
+	indices.resize(numVertices);
+
+	// the meshes are small, so every vertex is just compared with the unique ones so far
+	for (size_t i = 0; i < numVertices; i++)
+	{
+		size_t numUnique = uniquePositions.size() / 3;
+		size_t match = numUnique;
+		for (size_t u = 0; u < numUnique && match == numUnique; u++)
+		{
+			if (std::equal(&positions[i * 3], &positions[i * 3] + 3, &uniquePositions[u * 3]) &&
+				std::equal(&normals[i * 3], &normals[i * 3] + 3, &uniqueNormals[u * 3]) &&
+				std::equal(&colours[i * 4], &colours[i * 4] + 4, &uniqueColours[u * 4]))
+				match = u;
+		}
+
+		if (match == numUnique)
+		{
+			uniquePositions.insert(uniquePositions.end(), &positions[i * 3], &positions[i * 3] + 3);
+			uniqueNormals.insert(uniqueNormals.end(), &normals[i * 3], &normals[i * 3] + 3);
+			uniqueColours.insert(uniqueColours.end(), &colours[i * 4], &colours[i * 4] + 4);
+		}
+		indices[i] = (GLuint)match;
+	}
+
+	positions.swap(uniquePositions);
+	normals.swap(uniqueNormals);
+	colours.swap(uniqueColours);
+}
+
+void stripToTriangles(const GLuint* strip, int count, std::vector<GLuint>& triangles)
+{
+	for (int i = 2; i < count; i++)
+	{
+		GLuint a = strip[i - 2], b = strip[i - 1], c = strip[i];
+		if (a == b || b == c || a == c)
+			continue;
+
+		// every other triangle of a strip is wound the other way round
+		if (i & 1)
+			std::swap(a, b);
+		triangles.push_back(a);
+		triangles.push_back(b);
+		triangles.push_back(c);
+	}
+}
+
+/* Forsyth's scoring, with the cache size and weights from the article */
+static const int optimizerCacheSize = 32;
+
+static float vertexScore(int cachePosition, int trianglesLeft)
+{
+	if (trianglesLeft == 0)
+		return -1.f;
+
+	float score = 0.f;
+	if (cachePosition >= 0)
+	{
+		// the last triangle's vertices get a fixed score so it isn't simply extended into a strip
+		if (cachePosition < 3)
+			score = 0.75f;
+		else
+			score = std::pow(1.f - (float)(cachePosition - 3) / (optimizerCacheSize - 3), 1.5f);
+	}
+
+	// a boost for vertices with only a few triangles left to draw
+	return score + 2.f / std::sqrt((float)trianglesLeft);
+}
+
+template <typename Index>
+static void optimizeIndices(std::vector<Index>& indices, int numVertices)
+{
+	int numTriangles = (int)indices.size() / 3;
+	if (numTriangles == 0)
+		return;
+
+	// the triangles using each vertex
+	std::vector<int> trianglesLeft(numVertices, 0);
+	for (size_t i = 0; i < indices.size(); i++)
+		trianglesLeft[indices[i]]++;
+
+	std::vector<int> firstTriangle(numVertices + 1, 0);
+	for (int v = 0; v < numVertices; v++)
+		firstTriangle[v + 1] = firstTriangle[v] + trianglesLeft[v];
+	std::vector<int> vertexTriangles(indices.size());
+	std::vector<int> filled(numVertices, 0);
+	for (int t = 0; t < numTriangles; t++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			Index v = indices[t * 3 + k];
+			vertexTriangles[firstTriangle[v] + filled[v]++] = t;
+		}
+	}
+
+	std::vector<int> cachePosition(numVertices, -1);
+	std::vector<float> score(numVertices);
+	for (int v = 0; v < numVertices; v++)
+		score[v] = vertexScore(-1, trianglesLeft[v]);
+
+	std::vector<float> triangleScore(numTriangles);
+	std::vector<char> emitted(numTriangles, 0);
+	for (int t = 0; t < numTriangles; t++)
+		triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+
+	std::vector<Index> output;
+	output.reserve(indices.size());
+	std::vector<int> cache, newCache;
+	int bestTriangle = (int)(std::max_element(triangleScore.begin(), triangleScore.end()) - triangleScore.begin());
+
+	for (int drawn = 0; drawn < numTriangles; drawn++)
+	{
+		if (bestTriangle < 0)
+		{
+			// nothing in the cache has triangles left, start again from the best remaining triangle
+			float best = -1.f;
+			for (int t = 0; t < numTriangles; t++)
+			{
+				if (!emitted[t] && triangleScore[t] > best)
+				{
+					best = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+
+		emitted[bestTriangle] = 1;
+		newCache.clear();
+		for (int k = 0; k < 3; k++)
+		{
+			Index v = indices[bestTriangle * 3 + k];
+			output.push_back(v);
+			newCache.push_back(v);
+			trianglesLeft[v]--;
+
+			// move the drawn triangle to the end of the vertex's list so only the ones left are at the front
+			int* list = &vertexTriangles[firstTriangle[v]];
+			int* end = list + trianglesLeft[v] + 1;
+			std::swap(*std::find(list, end, bestTriangle), *(end - 1));
+		}
+
+		// the drawn triangle's vertices go to the front of the cache
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			if (std::find(newCache.begin(), newCache.begin() + 3, cache[c]) == newCache.begin() + 3)
+				newCache.push_back(cache[c]);
+		}
+
+		// rescore everything that was in the cache, including the vertices pushed out of it
+		for (size_t c = 0; c < newCache.size(); c++)
+		{
+			int v = newCache[c];
+			cachePosition[v] = c < (size_t)optimizerCacheSize ? (int)c : -1;
+			score[v] = vertexScore(cachePosition[v], trianglesLeft[v]);
+		}
+		if (newCache.size() > (size_t)optimizerCacheSize)
+			newCache.resize(optimizerCacheSize);
+		cache.swap(newCache);
+
+		// the next triangle is the best one using a vertex in the cache
+		bestTriangle = -1;
+		float best = -1.f;
+		for (size_t c = 0; c < cache.size(); c++)
+		{
+			int v = cache[c];
+			for (int i = 0; i < trianglesLeft[v]; i++)
+			{
+				int t = vertexTriangles[firstTriangle[v] + i];
+				triangleScore[t] = score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+				if (triangleScore[t] > best)
+				{
+					best = triangleScore[t];
+					bestTriangle = t;
+				}
+			}
+		}
+	}
+
+	indices.swap(output);
+}
+
+void optimizeVertexCache(std::vector<GLuint>& indices, int numVertices)
+{
+	optimizeIndices(indices, numVertices);
+}
+
+void optimizeVertexCache(std::vector<GLushort>& indices, int numVertices)
+{
+	optimizeIndices(indices, numVertices);
+}
+
+template <typename Index>
+static float simulateCache(const std::vector<Index>& indices, int numVertices, int cacheSize)
+{
+	if (indices.size() < 3)
+		return 0.f;
+
+	// a FIFO cache, as used by most hardware: a hit doesn't move the vertex
+	std::vector<int> cache(cacheSize, -1);
+	std::vector<char> inCache(numVertices, 0);
+	int next = 0, misses = 0;
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		Index v = indices[i];
+		if (inCache[v])
+			continue;
+
+		misses++;
+		if (cache[next] >= 0)
+			inCache[cache[next]] = 0;
+		cache[next] = v;
+		inCache[v] = 1;
+		next = (next + 1) % cacheSize;
+	}
+	return (float)misses / (indices.size() / 3);
+}
+
+float vertexCacheACMR(const std::vector<GLuint>& indices, int numVertices, int cacheSize)
+{
+	return simulateCache(indices, numVertices, cacheSize);
+}
+
+float vertexCacheACMR(const std::vector<GLushort>& indices, int numVertices, int cacheSize)
+{
+	return simulateCache(indices, numVertices, cacheSize);
+}
@@ -0,0 +1,29 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include "wrapper_glfw.h"
+#include <vector>
+
+/* Merges vertices whose position, normal and colour are all equal. positions and normals
+   have 3 floats a vertex and colours 4. The unique vertices replace the arrays' contents
+   and indices gets one entry for each of the original vertices */
+void deduplicateVertices(std::vector<GLfloat>& positions, std::vector<GLfloat>& normals, std::vector<GLfloat>& colours,
+	std::vector<GLuint>& indices);
+
+// splits triangle strips into a triangle list, keeping the winding and dropping degenerate triangles
+void stripToTriangles(const GLuint* strip, int count, std::vector<GLuint>& triangles);
+
+/* Reorders a triangle list for the post-transform vertex cache, using Tom Forsyth's
+   "Linear-Speed Vertex Cache Optimisation". Triangles that reuse recently used vertices
+   are drawn first, and vertices with few triangles left are favoured so they leave the
+   cache for good */
+void optimizeVertexCache(std::vector<GLuint>& indices, int numVertices);
+void optimizeVertexCache(std::vector<GLushort>& indices, int numVertices);
+
+/* Average cache miss ratio of a triangle list drawn through a FIFO vertex cache of
+   cacheSize entries: the number of vertices shaded for each triangle. 3 is no reuse at all,
+   0.5 is the limit for a large regular grid */
+float vertexCacheACMR(const std::vector<GLuint>& indices, int numVertices, int cacheSize = 16);
+float vertexCacheACMR(const std::vector<GLushort>& indices, int numVertices, int cacheSize = 16);
+
+#endif
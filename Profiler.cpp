@@ -0,0 +1,250 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+FrameProfiler frameProfiler;
+
+FrameProfiler::FrameProfiler()
+{
+	epoch = std::chrono::high_resolution_clock::now();
+	frames.resize(maxFrames);
+	frameCount = 0;
+	inFrame = false;
+	printSummaries = false;
+	summaryInterval = maxFrames;
+	queriesCreated = false;
+	openGpuScope = -1;
+	for (int slot = 0; slot <= gpuLatency; slot++)
+	{
+		gpuSlots[slot].count = 0;
+		gpuSlots[slot].frame = 0;
+	}
+}
+
+FrameProfiler::~FrameProfiler()
+{}
+
+double FrameProfiler::now() const
+{
+	return std::chrono::duration<double, std::micro>(std::chrono::high_resolution_clock::now() - epoch).count();
+}
+
+ProfileFrame& FrameProfiler::current()
+{
+	return frames[(frameCount - 1) % maxFrames];
+}
+
+void FrameProfiler::readGpuResults(int slot)
+{
+	GpuSlot& gpu = gpuSlots[slot];
+	ProfileFrame& frame = frames[gpu.frame % maxFrames];
+	for (int i = 0; i < gpu.count; i++)
+	{
+		// several frames on it should be long done, if not this waits for it
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(gpu.queries[i], GL_QUERY_RESULT, &elapsed);
+		if (frame.index != gpu.frame)
+			continue;
+
+		/* The GPU can't have taken longer than the time since the scope began. Some drivers
+		   (llvmpipe) give a query around the first drawing into a frame buffer a nonsense time,
+		   those are left out */
+		ProfileEvent& event = frame.events[gpu.events[i]];
+		if (elapsed / 1000.0 <= now() - event.start)
+			event.duration = elapsed / 1000.0;
+	}
+	gpu.count = 0;
+}
+
+void FrameProfiler::beginFrame()
+{
+	if (inFrame)
+		endFrame();
+
+	frameCount++;
+	int slot = (int)(frameCount % (gpuLatency + 1));
+	if (gpuSlots[slot].count > 0)
+		readGpuResults(slot);
+	gpuSlots[slot].frame = frameCount - 1;
+
+	ProfileFrame& frame = current();
+	frame.index = frameCount - 1;
+	frame.start = now();
+	frame.duration = 0.0;
+	frame.events.clear();
+	openScopes.clear();
+	openGpuScope = -1;
+	inFrame = true;
+}
+
+void FrameProfiler::endFrame()
+{
+	if (!inFrame)
+		return;
+	while (!openScopes.empty())
+		endScope();
+	if (openGpuScope >= 0)
+		endGpuScope();
+
+	ProfileFrame& frame = current();
+	frame.duration = now() - frame.start;
+	inFrame = false;
+
+	if (printSummaries && frameCount % summaryInterval == 0)
+		summarise(std::cout);
+}
+
+void FrameProfiler::beginScope(const char* name)
+{
+	if (!inFrame)
+		return;
+	ProfileFrame& frame = current();
+	ProfileEvent event = { name, now(), 0.0, (int)openScopes.size(), false };
+	openScopes.push_back((int)frame.events.size());
+	frame.events.push_back(event);
+}
+
+void FrameProfiler::endScope()
+{
+	if (!inFrame || openScopes.empty())
+		return;
+	ProfileEvent& event = current().events[openScopes.back()];
+	event.duration = now() - event.start;
+	openScopes.pop_back();
+}
+
+void FrameProfiler::beginGpuScope(const char* name)
+{
+	int slot = (int)(frameCount % (gpuLatency + 1));
+	GpuSlot& gpu = gpuSlots[slot];
+	if (!inFrame || openGpuScope >= 0 || gpu.count == maxGpuScopes)
+		return;
+
+	if (!queriesCreated)
+	{
+		for (int i = 0; i <= gpuLatency; i++)
+			glGenQueries(maxGpuScopes, gpuSlots[i].queries);
+		queriesCreated = true;
+	}
+
+	ProfileFrame& frame = current();
+	ProfileEvent event = { name, now(), -1.0, 0, true };
+	gpu.events[gpu.count] = (int)frame.events.size();
+	frame.events.push_back(event);
+
+	openGpuScope = gpu.count++;
+	glBeginQuery(GL_TIME_ELAPSED, gpu.queries[openGpuScope]);
+}
+
+void FrameProfiler::endGpuScope()
+{
+	if (openGpuScope < 0)
+		return;
+	glEndQuery(GL_TIME_ELAPSED);
+	openGpuScope = -1;
+}
+
+int FrameProfiler::numFrames() const
+{
+	// the frame in progress doesn't count
+	unsigned long long complete = inFrame ? frameCount - 1 : frameCount;
+	return (int)std::min(complete, (unsigned long long)maxFrames);
+}
+
+const ProfileFrame& FrameProfiler::frame(int age) const
+{
+	unsigned long long last = inFrame ? frameCount - 2 : frameCount - 1;
+	return frames[(last - age) % maxFrames];
+}
+
+void FrameProfiler::summarise(std::ostream& out) const
+{
+	// each scope's time in a frame is the sum of all the times it was entered
+	struct ScopeTotals
+	{
+		const char* name;
+		bool gpu;
+		double total, worst;
+		int frames;
+	};
+	std::vector<ScopeTotals> scopes;
+	std::vector<double> frameTotals;
+
+	int count = numFrames();
+	double frameTotal = 0.0, frameWorst = 0.0;
+	for (int age = count - 1; age >= 0; age--)
+	{
+		const ProfileFrame& record = frame(age);
+		frameTotal += record.duration;
+		frameWorst = std::max(frameWorst, record.duration);
+
+		frameTotals.assign(scopes.size(), -1.0);
+		for (const ProfileEvent& event : record.events)
+		{
+			if (event.duration < 0.0)
+				continue;
+			size_t s = 0;
+			while (s < scopes.size() && !(scopes[s].gpu == event.gpu && std::string(scopes[s].name) == event.name))
+				s++;
+			if (s == scopes.size())
+			{
+				ScopeTotals totals = { event.name, event.gpu, 0.0, 0.0, 0 };
+				scopes.push_back(totals);
+				frameTotals.push_back(-1.0);
+			}
+			frameTotals[s] = std::max(frameTotals[s], 0.0) + event.duration;
+		}
+		for (size_t s = 0; s < scopes.size(); s++)
+		{
+			if (frameTotals[s] < 0.0)
+				continue;
+			scopes[s].total += frameTotals[s];
+			scopes[s].worst = std::max(scopes[s].worst, frameTotals[s]);
+			scopes[s].frames++;
+		}
+	}
+	if (count == 0)
+		return;
+
+	std::ios::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+	out << "profile of the last " << count << " frames (ms)" << std::endl << std::fixed << std::setprecision(3);
+	out << "  " << std::left << std::setw(24) << "frame" << std::right << std::setw(10) << frameTotal / count / 1000.0 <<
+		"  worst " << std::setw(10) << frameWorst / 1000.0 << std::endl;
+	for (const ScopeTotals& scope : scopes)
+	{
+		out << "  " << std::left << std::setw(24) << (std::string(scope.name) + (scope.gpu ? " (gpu)" : "")) << std::right <<
+			std::setw(10) << scope.total / scope.frames / 1000.0 << "  worst " << std::setw(10) << scope.worst / 1000.0 << std::endl;
+	}
+	out.flags(flags);
+	out.precision(precision);
+}
+
+bool FrameProfiler::writeChromeTrace(const std::string& path) const
+{
+	std::ofstream file(path.c_str());
+	if (!file)
+		return false;
+
+	file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[" << std::endl;
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}}," << std::endl;
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+	for (int age = numFrames() - 1; age >= 0; age--)
+	{
+		const ProfileFrame& record = frame(age);
+		file << "," << std::endl << "{\"name\":\"frame " << record.index << "\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":" << record.start <<
+			",\"dur\":" << record.duration << "}";
+		for (const ProfileEvent& event : record.events)
+		{
+			if (event.duration < 0.0)
+				continue;
+			file << "," << std::endl << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1) <<
+				",\"ts\":" << event.start << ",\"dur\":" << event.duration << "}";
+		}
+	}
+	file << std::endl << "]}" << std::endl;
+	return (bool)file;
+}
@@ -0,0 +1,118 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "wrapper_glfw.h"
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/* A timed part of a frame. GPU scopes are timed with GL_TIME_ELAPSED queries, they start at
+   the time they were issued on the CPU and their duration is the GPU's */
+struct ProfileEvent
+{
+	const char* name;
+	double start;		// microseconds since the profiler was made
+	double duration;	// negative for a GPU scope whose result hasn't been read yet
+	int depth;
+	bool gpu;
+};
+
+struct ProfileFrame
+{
+	unsigned long long index;
+	double start, duration;
+	std::vector<ProfileEvent> events;
+};
+
+/* Records the CPU and GPU scopes of the last maxFrames frames in a ring of frame records.
+   The query results are read gpuLatency frames later, so waiting for them doesn't stall.
+   GPU scopes can't be nested in each other, CPU scopes can nest freely. Only the render
+   thread records scopes.
+   Everything is reached through the PROFILE_ macros, which are empty unless FRAME_PROFILER
+   is defined, so a normal build doesn't do any of it */
+class FrameProfiler
+{
+public:
+	static const int maxFrames = 120;
+	static const int gpuLatency = 3;
+	static const int maxGpuScopes = 16;		// in one frame, more are timed on the CPU only
+
+	FrameProfiler();
+	~FrameProfiler();
+
+	void beginFrame();
+	void endFrame();
+
+	void beginScope(const char* name);
+	void endScope();
+	void beginGpuScope(const char* name);
+	void endGpuScope();
+
+	// age 0 is the last complete frame
+	int numFrames() const;
+	const ProfileFrame& frame(int age) const;
+
+	// the average and worst time of each scope over the recorded frames, in milliseconds
+	void summarise(std::ostream& out) const;
+
+	// the recorded frames as a Chrome trace, for chrome://tracing or Perfetto. The GPU scopes are on their own track
+	bool writeChromeTrace(const std::string& path) const;
+
+	bool printSummaries;	// print a summary every summaryInterval frames
+	int summaryInterval;
+
+private:
+	double now() const;
+	ProfileFrame& current();
+	void readGpuResults(int slot);
+
+	std::chrono::high_resolution_clock::time_point epoch;
+	std::vector<ProfileFrame> frames;
+	unsigned long long frameCount;	// frames begun
+	bool inFrame;
+	std::vector<int> openScopes;	// indices into the current frame's events
+
+	// the queries issued in one frame, reused gpuLatency + 1 frames later
+	struct GpuSlot
+	{
+		GLuint queries[maxGpuScopes];
+		int events[maxGpuScopes];
+		int count;
+		unsigned long long frame;
+	};
+	GpuSlot gpuSlots[gpuLatency + 1];
+	bool queriesCreated;
+	int openGpuScope;	// the query index, or -1
+};
+
+extern FrameProfiler frameProfiler;
+
+struct ProfileScope
+{
+	ProfileScope(const char* name) { frameProfiler.beginScope(name); }
+	~ProfileScope() { frameProfiler.endScope(); }
+};
+
+// times the scope on the CPU and the GL commands issued in it on the GPU
+struct GpuProfileScope
+{
+	GpuProfileScope(const char* name) { frameProfiler.beginScope(name); frameProfiler.beginGpuScope(name); }
+	~GpuProfileScope() { frameProfiler.endGpuScope(); frameProfiler.endScope(); }
+};
+
+#ifdef FRAME_PROFILER
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#define PROFILE_FRAME_BEGIN() frameProfiler.beginFrame()
+#define PROFILE_FRAME_END() frameProfiler.endFrame()
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_GPU_SCOPE(name)
+#define PROFILE_FRAME_BEGIN()
+#define PROFILE_FRAME_END()
+#endif
+
+#endif
@@ -0,0 +1,62 @@
+#include "RenderQueue.h"
+
+#include <algorithm>
+
+uint64_t makeSortKey(unsigned int program, unsigned int mesh, unsigned int material, float depth, float maxDepth)
+{
+	// depth is stored as a fraction of maxDepth, anything behind the eye or past maxDepth is clamped
+	float fraction = std::min(std::max(depth / maxDepth, 0.f), 1.f);
+	uint64_t depthBits = (uint64_t)(fraction * 0xffffff);
+
+	return ((uint64_t)(program & 0xf) << 60) | ((uint64_t)(mesh & 0xff) << 52) |
+		((uint64_t)(material & 0xfff) << 40) | (depthBits << 16);
+}
+
+unsigned int sortKeyProgram(uint64_t key)
+{
+	return (unsigned int)(key >> 60) & 0xf;
+}
+
+unsigned int sortKeyMesh(uint64_t key)
+{
+	return (unsigned int)(key >> 52) & 0xff;
+}
+
+unsigned int sortKeyMaterial(uint64_t key)
+{
+	return (unsigned int)(key >> 40) & 0xfff;
+}
+
+RenderQueue::RenderQueue()
+{}
+
+RenderQueue::~RenderQueue()
+{}
+
+void RenderQueue::clear()
+{
+	packets.clear();
+}
+
+void RenderQueue::add(uint64_t key, int node, int drawIndex)
+{
+	DrawPacket packet = { key, node, drawIndex };
+	packets.push_back(packet);
+}
+
+void RenderQueue::sort()
+{
+	std::sort(packets.begin(), packets.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+}
+
+void RenderQueue::countStateChanges(unsigned int& meshChanges, unsigned int& materialChanges) const
+{
+	meshChanges = materialChanges = 0;
+	for (size_t i = 0; i < packets.size(); i++)
+	{
+		if (i == 0 || sortKeyMesh(packets[i].key) != sortKeyMesh(packets[i - 1].key))
+			meshChanges++;
+		if (i == 0 || sortKeyMaterial(packets[i].key) != sortKeyMaterial(packets[i - 1].key))
+			materialChanges++;
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+#include <cstdint>
+
+/* Sort key layout, most significant first, so sorting groups packets by the state that is
+   most expensive to change:
+	program		4 bits
+	mesh		8 bits
+	material	12 bits
+	depth		24 bits, front to back within the same state
+	unused		16 bits */
+uint64_t makeSortKey(unsigned int program, unsigned int mesh, unsigned int material, float depth, float maxDepth);
+unsigned int sortKeyProgram(uint64_t key);
+unsigned int sortKeyMesh(uint64_t key);
+unsigned int sortKeyMaterial(uint64_t key);
+
+/* One part to draw. node is its scene graph node and drawIndex is where its normal matrix
+   was stored while the queue was being built */
+struct DrawPacket
+{
+	uint64_t key;
+	int node;
+	int drawIndex;
+};
+
+/* Collects the parts to draw during the scene traversal so they can be sorted by state
+   before any of them are submitted */
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	void clear();
+	void add(uint64_t key, int node, int drawIndex);
+	void sort();
+
+	// how many times the mesh and material change going through the queue in its current order
+	void countStateChanges(unsigned int& meshChanges, unsigned int& materialChanges) const;
+
+	std::vector<DrawPacket> packets;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#include "RenderStats.h"
+
+RenderStats renderStats = {};
+
+void RenderStats::reset()
+{
+	drawCalls = 0;
+	instancesDrawn = 0;
+	trianglesDrawn = 0;
+	partSetupCalls = 0;
+	shadowCascadesCached = 0;
+	nodesCulled = 0;
+	meshBinds = meshBindsSkipped = 0;
+	uniformUploads = uniformUploadsSkipped = 0;
+	bytesStreamed = ringOverflows = 0;
+	fenceWaits = 0;
+	fenceWaitTime = 0.f;
+}
@@ -0,0 +1,29 @@
+#ifndef RENDERSTATS_H
+#define RENDERSTATS_H
+
+/* Counters for the work submitted to OpenGL in a frame. The mesh classes add to these
+   as they draw so that main can report how many draw calls a frame actually cost */
+struct RenderStats
+{
+	unsigned int drawCalls;
+	unsigned int instancesDrawn;
+	unsigned int trianglesDrawn;
+	/* GL calls made around the parts' draw calls: mesh and instance buffer binds with their attribute
+	   setup, the per part uniforms and the streamed uploads. display()'s own per frame calls, the
+	   clears, program and frame buffer binds and the shadow and cluster textures, aren't counted */
+	unsigned int partSetupCalls;
+	unsigned int shadowCascadesCached;	// cascades whose static casters were copied rather than drawn
+	unsigned int nodesCulled;			// parts skipped for being outside the camera or a shadow cascade
+	unsigned int meshBinds, meshBindsSkipped;			// by the render queue, skipped when the mesh was already bound
+	unsigned int uniformUploads, uniformUploadsSkipped;	// material uniforms, skipped when the material was already set
+	unsigned int bytesStreamed;		// instance and uniform data written to the upload ring
+	unsigned int ringOverflows;		// writes that didn't fit in the ring's region and were uploaded directly
+	unsigned int fenceWaits;		// frames where the upload ring had to wait for the GPU
+	float fenceWaitTime;			// microseconds spent checking and waiting on the ring's fences
+
+	void reset();
+};
+
+extern RenderStats renderStats;
+
+#endif
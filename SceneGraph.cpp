@@ -0,0 +1,199 @@
+#include "SceneGraph.h"
+
+/* Multiplies two matrices whose bottom row is (0, 0, 0, 1), which holds for every
+   translate/rotate/scale transform and skips a quarter of the work of a full multiply */
+static void affineMultiply(const glm::mat4& a, const glm::mat4& b, glm::mat4& result)
+{
+	for (int i = 0; i < 3; i++)
+	{
+		result[i] = a[0] * b[i][0] + a[1] * b[i][1] + a[2] * b[i][2];
+	}
+	result[3] = a[0] * b[3][0] + a[1] * b[3][1] + a[2] * b[3][2] + a[3];
+}
+
+glm::mat4 localTransform(const SceneNode& node)
+{
+	if (node.hasLocalMatrix)
+		return node.local;
+
+	// local = translate * rotate * scale
+	glm::mat4 local = glm::mat4_cast(node.rotation);
+	local[0] *= node.scale.x;
+	local[1] *= node.scale.y;
+	local[2] *= node.scale.z;
+	local[3] = glm::vec4(node.translation, 1.f);
+	return local;
+}
+
+bool isRotation(const glm::mat3& m)
+{
+	const float epsilon = 1e-5f;
+	glm::mat3 product = glm::transpose(m) * m;
+	for (int c = 0; c < 3; c++)
+		for (int r = 0; r < 3; r++)
+		{
+			if (glm::abs(product[c][r] - (c == r ? 1.f : 0.f)) > epsilon)
+				return false;
+		}
+	return true;
+}
+
+glm::mat3 rigidNormalMatrix(const SceneNode& node, const glm::mat3& viewRotation)
+{
+	// column i of the world matrix is R[i] * worldScale[i], so R * scale(1 / worldScale)
+	// is the world matrix with each column divided by its scale twice
+	glm::mat3 normalMatrix = viewRotation * glm::mat3(node.world);
+	normalMatrix[0] *= 1.f / (node.worldScale.x * node.worldScale.x);
+	normalMatrix[1] *= 1.f / (node.worldScale.y * node.worldScale.y);
+	normalMatrix[2] *= 1.f / (node.worldScale.z * node.worldScale.z);
+	return normalMatrix;
+}
+
+static bool isUniform(const glm::vec3& scale)
+{
+	const float epsilon = 1e-6f;
+	return glm::abs(scale.x - scale.y) <= epsilon * glm::abs(scale.x) && glm::abs(scale.x - scale.z) <= epsilon * glm::abs(scale.x);
+}
+
+SceneGraph::SceneGraph()
+{
+	numRecomputed = 0;
+	staticChanged = false;
+}
+
+SceneGraph::~SceneGraph()
+{}
+
+int SceneGraph::addNode(int parent, glm::vec3 translation, glm::quat rotation, glm::vec3 scale, int mesh, int material)
+{
+	SceneNode node;
+	node.translation = translation;
+	node.rotation = rotation;
+	node.scale = scale;
+	node.parent = parent;
+	node.dirty = true;
+	node.worldChanged = false;
+	node.local = glm::mat4(1.f);
+	node.world = glm::mat4(1.f);
+	node.rigidScale = false;
+	node.worldScale = glm::vec3(1.f);
+	node.hasLocalMatrix = false;
+	node.mesh = mesh;
+	node.material = material;
+	node.dynamic = false;
+
+	this->nodes.push_back(node);
+	return (int)this->nodes.size() - 1;
+}
+
+void SceneGraph::clear()
+{
+	this->nodes.clear();
+	this->numRecomputed = 0;
+	this->staticChanged = true;
+}
+
+void SceneGraph::setTranslation(int node, glm::vec3 translation)
+{
+	SceneNode& n = this->nodes[node];
+	if (n.translation != translation)
+	{
+		n.translation = translation;
+		n.dirty = true;
+	}
+}
+
+void SceneGraph::setRotation(int node, glm::quat rotation)
+{
+	SceneNode& n = this->nodes[node];
+	if (n.rotation != rotation)
+	{
+		n.rotation = rotation;
+		n.dirty = true;
+	}
+}
+
+void SceneGraph::setScale(int node, glm::vec3 scale)
+{
+	SceneNode& n = this->nodes[node];
+	if (n.scale != scale)
+	{
+		n.scale = scale;
+		n.dirty = true;
+	}
+}
+
+void SceneGraph::setLocalMatrix(int node, const glm::mat4& local)
+{
+	SceneNode& n = this->nodes[node];
+	n.local = local;
+	n.hasLocalMatrix = true;
+	n.dirty = true;
+}
+
+void SceneGraph::updateWorldTransforms()
+{
+	this->numRecomputed = 0;
+	this->staticChanged = false;
+	updateWorldTransforms(0, this->nodes.size(), this->numRecomputed, this->staticChanged);
+}
+
+void SceneGraph::updateWorldTransforms(size_t begin, size_t end, unsigned int& recomputed, bool& staticNodeChanged)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		SceneNode& node = this->nodes[i];
+
+		// a node only needs recomputing if it or its parent has changed, as the parent has already
+		// been visited its worldChanged flag covers every node above it
+		bool parentChanged = node.parent >= 0 && this->nodes[node.parent].worldChanged;
+		if (!node.dirty && !parentChanged)
+		{
+			node.worldChanged = false;
+			continue;
+		}
+
+		if (node.dirty)
+		{
+			node.local = localTransform(node);
+		}
+
+		const SceneNode* parent = node.parent >= 0 ? &this->nodes[node.parent] : nullptr;
+		if (parent)
+			affineMultiply(parent->world, node.local, node.world);
+		else
+			node.world = node.local;
+
+		/* rotation * scale stays in that form when combined with a child if the parent's scale is
+		   uniform, or if the child has no rotation. Anything else can add shear */
+		if (node.hasLocalMatrix || (parent && !parent->rigidScale))
+		{
+			node.rigidScale = false;
+		}
+		else if (!parent)
+		{
+			node.rigidScale = true;
+			node.worldScale = node.scale;
+		}
+		else if (isUniform(parent->worldScale))
+		{
+			node.rigidScale = true;
+			node.worldScale = parent->worldScale.x * node.scale;
+		}
+		else if (node.rotation == glm::quat(1.f, 0.f, 0.f, 0.f))
+		{
+			node.rigidScale = true;
+			node.worldScale = parent->worldScale * node.scale;
+		}
+		else
+		{
+			node.rigidScale = false;
+		}
+
+		node.dirty = false;
+		node.worldChanged = true;
+		recomputed++;
+		if (!node.dynamic)
+			staticNodeChanged = true;
+	}
+}
@@ -0,0 +1,84 @@
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+/* A node in the scene graph. The local transform is stored as translation, rotation and
+   scale (applied in that order, the same as translate * rotate * scale with glm) and the
+   world matrix is cached until the node or one of its parents changes */
+struct SceneNode
+{
+	glm::vec3 translation;
+	glm::quat rotation;
+	glm::vec3 scale;
+
+	int parent;			// index of the parent node, -1 for a root node
+	bool dirty;			// local transform has changed since the last update
+	bool worldChanged;	// world matrix was recomputed in the last update
+
+	glm::mat4 local;	// translate * rotate * scale, rebuilt only when the node is dirty
+	glm::mat4 world;
+
+	/* While a node's world matrix is only made of rotations, translations and per axis
+	   scales, rigidScale is set and the upper 3x3 of world equals R * scale(worldScale) for
+	   some rotation R. The normal matrix is then R * scale(1 / worldScale) without any inverse */
+	bool rigidScale;
+	glm::vec3 worldScale;
+
+	bool hasLocalMatrix;	// local was given directly with setLocalMatrix rather than from TRS
+
+	int mesh;			// mesh to draw for this node, -1 for nodes only used for grouping
+	int material;
+
+	bool dynamic;		// expected to move every frame, so left out of the cached static shadows
+};
+
+// builds translate * rotate * scale from the node's local transform
+glm::mat4 localTransform(const SceneNode& node);
+
+// true if the matrix is orthonormal, so it is its own inverse transpose
+bool isRotation(const glm::mat3& m);
+
+/* Normal matrix of a node with rigidScale set, seen from a view whose upper 3x3 is a pure
+   rotation. This gives the same result as transpose(inverse(mat3(view * node.world))) */
+glm::mat3 rigidNormalMatrix(const SceneNode& node, const glm::mat3& viewRotation);
+
+/* Nodes are stored in a flat array where parents always come before their children,
+   so the world transforms can be updated in a single pass over the array */
+class SceneGraph
+{
+public:
+	SceneGraph();
+	~SceneGraph();
+
+	int addNode(int parent, glm::vec3 translation, glm::quat rotation, glm::vec3 scale, int mesh = -1, int material = -1);
+	void clear();
+
+	// these only mark the node dirty if the value actually changes
+	void setTranslation(int node, glm::vec3 translation);
+	void setRotation(int node, glm::quat rotation);
+	void setScale(int node, glm::vec3 scale);
+
+	// replaces the node's TRS with any affine matrix, the node then uses the general normal matrix path
+	void setLocalMatrix(int node, const glm::mat4& local);
+
+	// recomputes the world matrix of every dirty node and everything below it
+	void updateWorldTransforms();
+
+	/* The same for nodes [begin, end) only, adding to the given counters rather than the graph's.
+	   Parents outside the range have to be before begin and already up to date, so ranges that
+	   each start on a root node can be updated at the same time on different threads */
+	void updateWorldTransforms(size_t begin, size_t end, unsigned int& recomputed, bool& staticNodeChanged);
+
+	std::vector<SceneNode> nodes;
+
+	// number of world matrices recomputed in the last update
+	unsigned int numRecomputed;
+
+	// a node that isn't dynamic was recomputed in the last update, so cached static shadows are out of date
+	bool staticChanged;
+};
+
+#endif
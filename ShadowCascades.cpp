@@ -0,0 +1,182 @@
+#include "ShadowCascades.h"
+
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include "glm/gtc/matrix_transform.hpp"
+
+ShadowCascades::ShadowCascades()
+{
+	numCascades = 3;
+	resolution = 1024;
+	shadowDistance = 30.f;
+	splitLambda = 0.75f;
+	casterDistance = 20.f;
+	refitMargin = 0.15f;
+	lightView = glm::mat4(1.f);
+	for (int i = 0; i < maxShadowCascades; i++)
+	{
+		lightSpaceMatrix[i] = glm::mat4(1.f);
+		splitDepth[i] = 0.f;
+		fittedRadius[i] = -1.f;
+	}
+	depthTexture = 0;
+	frameBuffer = 0;
+	staticDepthTexture = 0;
+	staticFrameBuffer = 0;
+	invalidateCache();
+}
+
+ShadowCascades::~ShadowCascades()
+{}
+
+/* Creates a depth texture array with a frame buffer for drawing into its layers */
+static void createDepthArray(GLuint& texture, GLuint& frameBuffer, int resolution, int layers)
+{
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+	glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT32F, resolution, resolution, layers,
+		0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+	float borderColor[] = { 10.f, 10.f, 10.f, 10.f };
+	glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, borderColor);
+
+	glGenFramebuffers(1, &frameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, 0);
+	glDrawBuffer(GL_NONE);
+	glReadBuffer(GL_NONE);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		std::cout << "shadow cascade frame buffer invalid" << std::endl;
+	}
+
+	glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void ShadowCascades::create(int numCascades, int resolution)
+{
+	this->numCascades = std::min(std::max(numCascades, 1), maxShadowCascades);
+	this->resolution = resolution;
+	for (int i = 0; i < maxShadowCascades; i++)
+		fittedRadius[i] = -1.f;
+
+	createDepthArray(depthTexture, frameBuffer, resolution, this->numCascades);
+	createDepthArray(staticDepthTexture, staticFrameBuffer, resolution, this->numCascades);
+	invalidateCache();
+}
+
+void ShadowCascades::fit(const glm::mat4& cameraView, float fovy, float aspect, float zNear, glm::vec3 lightDirection)
+{
+	lightDirection = glm::normalize(lightDirection);
+	glm::vec3 up = glm::abs(lightDirection.y) > 0.99f ? glm::vec3(0.f, 0.f, 1.f) : glm::vec3(0.f, 1.f, 0.f);
+	glm::mat4 newLightView = glm::lookAt(glm::vec3(0.f), lightDirection, up);
+	if (newLightView != lightView)
+	{
+		// the old cascades are all facing the wrong way
+		lightView = newLightView;
+		for (int i = 0; i < maxShadowCascades; i++)
+			fittedRadius[i] = -1.f;
+	}
+
+	glm::mat4 cameraToLight = lightView * glm::inverse(cameraView);
+	float tanY = std::tan(fovy * 0.5f);
+	float tanX = tanY * aspect;
+
+	float nearDepth = zNear;
+	for (int i = 0; i < numCascades; i++)
+	{
+		// blend between logarithmic and even spacing of the splits
+		float t = (float)(i + 1) / numCascades;
+		float logSplit = zNear * std::pow(shadowDistance / zNear, t);
+		float evenSplit = zNear + (shadowDistance - zNear) * t;
+		float farDepth = splitLambda * logSplit + (1.f - splitLambda) * evenSplit;
+		splitDepth[i] = farDepth;
+
+		// the slice's corners in light space
+		glm::vec3 corners[8];
+		for (int c = 0; c < 8; c++)
+		{
+			float depth = c < 4 ? nearDepth : farDepth;
+			glm::vec4 corner((c & 1 ? 1.f : -1.f) * tanX * depth, (c & 2 ? 1.f : -1.f) * tanY * depth, -depth, 1.f);
+			corners[c] = glm::vec3(cameraToLight * corner);
+		}
+
+		// a sphere around the slice keeps the same size however the camera turns
+		glm::vec3 centre(0.f);
+		for (int c = 0; c < 8; c++)
+			centre += corners[c];
+		centre /= 8.f;
+		float radius = 0.f;
+		for (int c = 0; c < 8; c++)
+			radius = std::max(radius, glm::length(corners[c] - centre));
+		radius = std::ceil(radius * 16.f) / 16.f;
+		nearDepth = farDepth;
+
+		// keep the cascade while its sphere still holds the slice's
+		glm::vec3 offset = glm::abs(centre - fittedCentre[i]);
+		if (fittedRadius[i] >= 0.f && std::max(offset.x, std::max(offset.y, offset.z)) + radius <= fittedRadius[i])
+			continue;
+
+		// only move the cascade in whole texels, with a texel of border so the sphere stays inside
+		radius *= 1.f + refitMargin;
+		float halfSize = radius * resolution / (resolution - 2);
+		float texelSize = 2.f * halfSize / resolution;
+		centre.x = std::floor(centre.x / texelSize) * texelSize;
+		centre.y = std::floor(centre.y / texelSize) * texelSize;
+
+		// the light looks down -z, casters between the cascade and the light are towards +z
+		glm::mat4 projection = glm::ortho(centre.x - halfSize, centre.x + halfSize, centre.y - halfSize, centre.y + halfSize,
+			-centre.z - radius - casterDistance, -centre.z + radius);
+		lightSpaceMatrix[i] = projection * lightView;
+		fittedCentre[i] = centre;
+		fittedRadius[i] = radius;
+	}
+}
+
+void ShadowCascades::bindCascade(int cascade)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+	glViewport(0, 0, resolution, resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowCascades::invalidateCache()
+{
+	for (int i = 0; i < maxShadowCascades; i++)
+		cacheValid[i] = false;
+}
+
+bool ShadowCascades::isCached(int cascade) const
+{
+	return cacheValid[cascade] && cachedLightSpaceMatrix[cascade] == lightSpaceMatrix[cascade];
+}
+
+void ShadowCascades::bindStaticCascade(int cascade)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, staticFrameBuffer);
+	glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepthTexture, 0, cascade);
+	glViewport(0, 0, resolution, resolution);
+	glClear(GL_DEPTH_BUFFER_BIT);
+
+	cacheValid[cascade] = true;
+	cachedLightSpaceMatrix[cascade] = lightSpaceMatrix[cascade];
+}
+
+void ShadowCascades::copyStaticCascade(int cascade)
+{
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, staticFrameBuffer);
+	glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepthTexture, 0, cascade);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, frameBuffer);
+	glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture, 0, cascade);
+	glBlitFramebuffer(0, 0, resolution, resolution, 0, 0, resolution, resolution, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glViewport(0, 0, resolution, resolution);
+}
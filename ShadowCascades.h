@@ -0,0 +1,68 @@
+#ifndef SHADOWCASCADES_H
+#define SHADOWCASCADES_H
+
+#include "wrapper_glfw.h"
+#include "UniformBuffers.h"
+#include <glm/glm.hpp>
+
+/* Cascaded shadow maps for the main light. The camera frustum up to shadowDistance is split
+   into numCascades slices in depth, and each slice gets its own orthographic shadow map sized
+   to fit it, so the cascades near the camera cover a small area at a high texel density.
+   The maps are the layers of one depth texture array */
+class ShadowCascades
+{
+public:
+	ShadowCascades();
+	~ShadowCascades();
+
+	// creates the texture array and frame buffer, numCascades is at most maxShadowCascades
+	void create(int numCascades, int resolution);
+
+	/* Fits each cascade to its slice of the camera frustum. The cascades are bounding spheres
+	   moved in whole texels so the shadows don't shimmer as the camera moves. Each one covers
+	   refitMargin more than its slice and is only refitted once the slice leaves it, so the
+	   light space matrices, and the static shadow cache, last while the camera moves a little */
+	void fit(const glm::mat4& cameraView, float fovy, float aspect, float zNear, glm::vec3 lightDirection);
+
+	// binds the cascade's layer of the texture array for drawing into
+	void bindCascade(int cascade);
+
+	/* Static shadow cache. Static casters are drawn into a second texture array that is kept
+	   until the cascade's light space matrix changes or invalidateCache() is called. Each frame
+	   the cached depth is copied into the cascade and only the dynamic casters are drawn on top */
+	void invalidateCache();
+	bool isCached(int cascade) const;
+
+	// binds the cascade's static layer for drawing the static casters into, and marks it as cached
+	void bindStaticCascade(int cascade);
+
+	// copies the cached static depth into the cascade and leaves it bound for the dynamic casters
+	void copyStaticCascade(int cascade);
+
+	int numCascades;
+	int resolution;
+	float shadowDistance;	// the cascades cover the camera frustum up to this distance
+	float splitLambda;		// 0 for evenly spaced cascades, 1 for logarithmic spacing
+	float casterDistance;	// how far behind each cascade towards the light casters are still drawn
+	float refitMargin;		// fraction of its radius each cascade covers beyond its slice
+
+	glm::mat4 lightView;
+	glm::mat4 lightSpaceMatrix[maxShadowCascades];
+	float splitDepth[maxShadowCascades];	// far view space depth of each cascade
+
+	GLuint depthTexture;
+	GLuint frameBuffer;
+
+	GLuint staticDepthTexture;
+	GLuint staticFrameBuffer;
+
+private:
+	bool cacheValid[maxShadowCascades];
+	glm::mat4 cachedLightSpaceMatrix[maxShadowCascades];
+
+	// the light space sphere each cascade was last fitted to, a negative radius when it needs fitting
+	glm::vec3 fittedCentre[maxShadowCascades];
+	float fittedRadius[maxShadowCascades];
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SIMDLANES_H
+#define SIMDLANES_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_SSE
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+#define TRANSFORM_AVX
+#include <immintrin.h>
+#endif
+
+/* The batched kernels (TransformSoA, FrustumCulling, DroneSwarm) are written once against these
+   lane types, each one wraps the arithmetic for one instruction set and width. A mask holds the
+   result of a comparison for each lane, for choosing between two values with select */
+struct ScalarLane
+{
+	typedef float type;
+	typedef bool mask;
+	static const int width = 1;
+	static type load(const float* p) { return *p; }
+	static void store(float* p, type v) { *p = v; }
+	static type set(float v) { return v; }
+	static type add(type a, type b) { return a + b; }
+	static type sub(type a, type b) { return a - b; }
+	static type mul(type a, type b) { return a * b; }
+	static type div(type a, type b) { return a / b; }
+	static type min(type a, type b) { return a < b ? a : b; }
+	static type max(type a, type b) { return a > b ? a : b; }
+	static mask less(type a, type b) { return a < b; }
+	static mask greater(type a, type b) { return a > b; }
+	static mask maskAnd(mask a, mask b) { return a && b; }
+	static mask maskOr(mask a, mask b) { return a || b; }
+	static mask maskAndNot(mask a, mask b) { return !a && b; }
+	static type select(mask m, type a, type b) { return m ? a : b; }
+};
+
+#ifdef TRANSFORM_SSE
+struct SseLane
+{
+	typedef __m128 type;
+	typedef __m128 mask;
+	static const int width = 4;
+	static type load(const float* p) { return _mm_loadu_ps(p); }
+	static void store(float* p, type v) { _mm_storeu_ps(p, v); }
+	static type set(float v) { return _mm_set1_ps(v); }
+	static type add(type a, type b) { return _mm_add_ps(a, b); }
+	static type sub(type a, type b) { return _mm_sub_ps(a, b); }
+	static type mul(type a, type b) { return _mm_mul_ps(a, b); }
+	static type div(type a, type b) { return _mm_div_ps(a, b); }
+	static type min(type a, type b) { return _mm_min_ps(a, b); }
+	static type max(type a, type b) { return _mm_max_ps(a, b); }
+	static mask less(type a, type b) { return _mm_cmplt_ps(a, b); }
+	static mask greater(type a, type b) { return _mm_cmpgt_ps(a, b); }
+	static mask maskAnd(mask a, mask b) { return _mm_and_ps(a, b); }
+	static mask maskOr(mask a, mask b) { return _mm_or_ps(a, b); }
+	static mask maskAndNot(mask a, mask b) { return _mm_andnot_ps(a, b); }
+	static type select(mask m, type a, type b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+};
+#endif
+
+#ifdef TRANSFORM_AVX
+struct AvxLane
+{
+	typedef __m256 type;
+	typedef __m256 mask;
+	static const int width = 8;
+	static type load(const float* p) { return _mm256_loadu_ps(p); }
+	static void store(float* p, type v) { _mm256_storeu_ps(p, v); }
+	static type set(float v) { return _mm256_set1_ps(v); }
+	static type add(type a, type b) { return _mm256_add_ps(a, b); }
+	static type sub(type a, type b) { return _mm256_sub_ps(a, b); }
+	static type mul(type a, type b) { return _mm256_mul_ps(a, b); }
+	static type div(type a, type b) { return _mm256_div_ps(a, b); }
+	static type min(type a, type b) { return _mm256_min_ps(a, b); }
+	static type max(type a, type b) { return _mm256_max_ps(a, b); }
+	static mask less(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static mask greater(type a, type b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static mask maskAnd(mask a, mask b) { return _mm256_and_ps(a, b); }
+	static mask maskOr(mask a, mask b) { return _mm256_or_ps(a, b); }
+	static mask maskAndNot(mask a, mask b) { return _mm256_andnot_ps(a, b); }
+	static type select(mask m, type a, type b) { return _mm256_blendv_ps(b, a, m); }
+};
+#endif
+
+#endif
@@ -0,0 +1,269 @@
+#include "Swarm.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <random>
+
+DroneSwarm::DroneSwarm()
+{
+	count = 0;
+}
+
+DroneSwarm::~DroneSwarm()
+{}
+
+size_t DroneSwarm::size() const
+{
+	return count;
+}
+
+void DroneSwarm::resize(size_t count)
+{
+	this->count = count;
+	std::vector<float>* columns[] = { &positionX, &positionY, &positionZ, &velocityX, &velocityY, &velocityZ, &pitch, &yaw, &roll, &propAngle,
+		&previousX, &previousY, &previousZ, &previousPitch, &previousYaw, &previousRoll, &previousPropAngle };
+	for (std::vector<float>* column : columns)
+		column->resize(count, 0.f);
+	lightsOn.resize(count, 1);
+}
+
+void DroneSwarm::scatter(size_t first, unsigned int seed, const FlightLimits& limits)
+{
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> across(-limits.minmaxXZ, limits.minmaxXZ);
+	std::uniform_real_distribution<float> height(limits.minYFly + 0.5f, limits.maxY);
+	std::uniform_real_distribution<float> heading(0.f, 6.2831853f);
+	std::uniform_real_distribution<float> speed(0.01f, 0.04f);
+	std::uniform_real_distribution<float> angle(0.f, 360.f);
+
+	for (size_t i = first; i < count; i++)
+	{
+		positionX[i] = across(random);
+		positionY[i] = height(random);
+		positionZ[i] = across(random);
+
+		float direction = heading(random);
+		float s = speed(random);
+		velocityX[i] = s * std::cos(direction);
+		velocityY[i] = 0.f;
+		velocityZ[i] = s * std::sin(direction);
+
+		pitch[i] = roll[i] = 0.f;
+		yaw[i] = 0.f;
+		propAngle[i] = angle(random);
+		lightsOn[i] = 1;
+	}
+	if (first < count)
+		storePrevious(first, count - first);
+}
+
+void DroneSwarm::steer(size_t first, size_t count, const FlightLimits& limits)
+{
+	// a drone at the edge would just stop, so it is sent back the way it came
+	float edge = limits.minmaxXZ - 0.05f;
+	for (size_t i = first; i < first + count; i++)
+	{
+		if ((positionX[i] >= edge && velocityX[i] > 0.f) || (positionX[i] <= -edge && velocityX[i] < 0.f))
+			velocityX[i] = -velocityX[i];
+		if ((positionZ[i] >= edge && velocityZ[i] > 0.f) || (positionZ[i] <= -edge && velocityZ[i] < 0.f))
+			velocityZ[i] = -velocityZ[i];
+	}
+}
+
+/* The rules of the old single drone update in display(), with the branches turned into
+   selects. The order matters: the height is moved first and the sideways moves test the new
+   height, and levelling out takes the two steps one after the other as it always has */
+template <typename Lane>
+static void flightKernel(DroneSwarm& swarm, size_t begin, size_t end, const FlightLimits& limits)
+{
+	typedef typename Lane::type V;
+	typedef typename Lane::mask M;
+
+	V zero = Lane::set(0.f);
+	V change = Lane::set(limits.tiltChange);
+	V maxTilt = Lane::set(limits.maxTilt), minTilt = Lane::set(-limits.maxTilt);
+	V maxXZ = Lane::set(limits.minmaxXZ), minXZ = Lane::set(-limits.minmaxXZ);
+	V maxY = Lane::set(limits.maxY), minY = Lane::set(limits.minY), minYFly = Lane::set(limits.minYFly);
+	V propSpeed = Lane::set(limits.propSpeed), fullTurn = Lane::set(360.f);
+
+	for (size_t i = begin; i < end; i += Lane::width)
+	{
+		V y = Lane::load(&swarm.positionY[i]);
+		V vy = Lane::load(&swarm.velocityY[i]);
+		M climb = Lane::maskOr(Lane::maskAnd(Lane::greater(vy, zero), Lane::less(y, maxY)), Lane::maskAnd(Lane::less(vy, zero), Lane::greater(y, minY)));
+		y = Lane::select(climb, Lane::add(y, vy), y);
+		Lane::store(&swarm.positionY[i], y);
+		M flying = Lane::greater(y, minYFly);
+
+		// forwards and backwards tilt the nose down or up
+		V z = Lane::load(&swarm.positionZ[i]);
+		V vz = Lane::load(&swarm.velocityZ[i]);
+		V p = Lane::load(&swarm.pitch[i]);
+		M forward = Lane::maskAnd(Lane::maskAnd(Lane::greater(vz, zero), Lane::less(z, maxXZ)), flying);
+		M backward = Lane::maskAndNot(forward, Lane::maskAnd(Lane::maskAnd(Lane::less(vz, zero), Lane::greater(z, minXZ)), flying));
+		V level = Lane::select(Lane::greater(p, zero), Lane::sub(p, change), p);
+		level = Lane::select(Lane::less(level, zero), Lane::add(level, change), level);
+		Lane::store(&swarm.positionZ[i], Lane::select(Lane::maskOr(forward, backward), Lane::add(z, vz), z));
+		Lane::store(&swarm.pitch[i], Lane::select(forward, Lane::max(minTilt, Lane::sub(p, change)), Lane::select(backward, Lane::min(maxTilt, Lane::add(p, change)), level)));
+
+		// sideways rolls towards the way the drone is going
+		V x = Lane::load(&swarm.positionX[i]);
+		V vx = Lane::load(&swarm.velocityX[i]);
+		V r = Lane::load(&swarm.roll[i]);
+		M right = Lane::maskAnd(Lane::maskAnd(Lane::greater(vx, zero), Lane::less(x, maxXZ)), flying);
+		M left = Lane::maskAndNot(right, Lane::maskAnd(Lane::maskAnd(Lane::less(vx, zero), Lane::greater(x, minXZ)), flying));
+		level = Lane::select(Lane::greater(r, zero), Lane::sub(r, change), r);
+		level = Lane::select(Lane::less(level, zero), Lane::add(level, change), level);
+		Lane::store(&swarm.positionX[i], Lane::select(Lane::maskOr(right, left), Lane::add(x, vx), x));
+		Lane::store(&swarm.roll[i], Lane::select(right, Lane::min(maxTilt, Lane::add(r, change)), Lane::select(left, Lane::max(minTilt, Lane::sub(r, change)), level)));
+
+		V a = Lane::load(&swarm.propAngle[i]);
+		a = Lane::select(Lane::greater(y, minY), Lane::add(a, propSpeed), a);
+		Lane::store(&swarm.propAngle[i], Lane::select(Lane::greater(a, fullTurn), Lane::sub(a, fullTurn), a));
+	}
+}
+
+void DroneSwarm::update(size_t first, size_t count, const FlightLimits& limits, TransformKernel kernel)
+{
+	// whole lanes first, then what is left over one drone at a time
+	size_t end = first + count;
+	size_t laneEnd = first;
+	switch (resolveKernel(kernel))
+	{
+#ifdef TRANSFORM_AVX
+	case KERNEL_AVX:
+		laneEnd = first + count / AvxLane::width * AvxLane::width;
+		flightKernel<AvxLane>(*this, first, laneEnd, limits);
+		break;
+#endif
+#ifdef TRANSFORM_SSE
+	case KERNEL_SSE:
+		laneEnd = first + count / SseLane::width * SseLane::width;
+		flightKernel<SseLane>(*this, first, laneEnd, limits);
+		break;
+#endif
+	default:
+		break;
+	}
+	flightKernel<ScalarLane>(*this, laneEnd, end, limits);
+}
+
+void DroneSwarm::update(const FlightLimits& limits, TransformKernel kernel)
+{
+	update(0, count, limits, kernel);
+}
+
+void DroneSwarm::storePrevious(size_t first, size_t count)
+{
+	std::copy(positionX.begin() + first, positionX.begin() + first + count, previousX.begin() + first);
+	std::copy(positionY.begin() + first, positionY.begin() + first + count, previousY.begin() + first);
+	std::copy(positionZ.begin() + first, positionZ.begin() + first + count, previousZ.begin() + first);
+	std::copy(pitch.begin() + first, pitch.begin() + first + count, previousPitch.begin() + first);
+	std::copy(yaw.begin() + first, yaw.begin() + first + count, previousYaw.begin() + first);
+	std::copy(roll.begin() + first, roll.begin() + first + count, previousRoll.begin() + first);
+	std::copy(propAngle.begin() + first, propAngle.begin() + first + count, previousPropAngle.begin() + first);
+}
+
+glm::vec3 DroneSwarm::drawnPosition(size_t i, float alpha) const
+{
+	return glm::mix(glm::vec3(previousX[i], previousY[i], previousZ[i]), glm::vec3(positionX[i], positionY[i], positionZ[i]), alpha);
+}
+
+glm::vec3 DroneSwarm::drawnAngles(size_t i, float alpha) const
+{
+	return glm::mix(glm::vec3(previousPitch[i], previousYaw[i], previousRoll[i]), glm::vec3(pitch[i], yaw[i], roll[i]), alpha);
+}
+
+float DroneSwarm::drawnPropAngle(size_t i, float alpha) const
+{
+	/* the props can turn either way and the angle can wrap round 360, so they are drawn turning
+	   the short way. Past half a turn a tick the spin looks the same either way */
+	float delta = std::remainder(propAngle[i] - previousPropAngle[i], 360.f);
+	return previousPropAngle[i] + delta * alpha;
+}
+
+/* The counts from each chunk's part of the graph, added up in order once they are all done */
+struct SwarmFrameCounts
+{
+	std::vector<unsigned int> recomputed;
+	std::vector<char> staticChanged;
+};
+
+JobHandle scheduleSwarmFrame(JobSystem& jobs, DroneSwarm& swarm, size_t firstFlown, const FlightLimits& limits, int numTicks, float alpha,
+	SceneGraph& graph, const std::vector<DroneNodes>& drones, float controlledScale, float droneScale, size_t dronesPerJob)
+{
+	size_t numDrones = swarm.size();
+	size_t numDrawn = std::min(drones.size(), numDrones);
+	size_t numChunks = (numDrones + dronesPerJob - 1) / dronesPerJob;
+
+	// one slot per chunk and one for the nodes outside the drones, the jobs run after this returns
+	std::shared_ptr<SwarmFrameCounts> counts = std::make_shared<SwarmFrameCounts>();
+	counts->recomputed.assign(numChunks + 1, 0);
+	counts->staticChanged.assign(numChunks + 1, 0);
+
+	std::vector<JobHandle> finalJobs;
+	for (size_t chunk = 0; chunk < numChunks; chunk++)
+	{
+		size_t begin = chunk * dronesPerJob;
+		size_t end = std::min(begin + dronesPerJob, numDrones);
+
+		JobHandle fly = jobs.createJob([&swarm, limits, numTicks, begin, end, firstFlown]()
+		{
+			// drone 0 is flown by the controls rather than the autopilot
+			size_t first = std::max(begin, firstFlown);
+			size_t firstSteered = std::max(first, (size_t)1);
+			for (int tick = 0; tick < numTicks && first < end; tick++)
+			{
+				swarm.storePrevious(first, end - first);
+				if (firstSteered < end)
+					swarm.steer(firstSteered, end - firstSteered, limits);
+				swarm.update(first, end - first, limits);
+			}
+		});
+
+		// drones without nodes only have to be flown
+		if (begin >= numDrawn)
+		{
+			finalJobs.push_back(fly);
+			continue;
+		}
+
+		size_t drawnEnd = std::min(end, numDrawn);
+		finalJobs.push_back(jobs.createJob([&swarm, &graph, &drones, counts, chunk, begin, drawnEnd, alpha, controlledScale, droneScale]()
+		{
+			for (size_t i = begin; i < drawnEnd; i++)
+			{
+				setDronePose(graph, drones[i], swarm.drawnPosition(i, alpha), swarm.drawnAngles(i, alpha), i == 0 ? controlledScale : droneScale);
+				setDroneMotorAngle(graph, drones[i], swarm.drawnPropAngle(i, alpha));
+			}
+
+			bool staticChanged = false;
+			graph.updateWorldTransforms(drones[begin].firstNode, drones[drawnEnd - 1].lastNode + 1, counts->recomputed[chunk], staticChanged);
+			counts->staticChanged[chunk] = staticChanged;
+		}, &fly, 1));
+	}
+
+	// everything before the first drone and after the last one, the ground for one
+	size_t dronesBegin = numDrawn > 0 ? drones[0].firstNode : graph.nodes.size();
+	size_t dronesEnd = numDrawn > 0 ? drones[numDrawn - 1].lastNode + 1 : graph.nodes.size();
+	finalJobs.push_back(jobs.createJob([&graph, counts, numChunks, dronesBegin, dronesEnd]()
+	{
+		bool staticChanged = false;
+		graph.updateWorldTransforms(0, dronesBegin, counts->recomputed[numChunks], staticChanged);
+		graph.updateWorldTransforms(dronesEnd, graph.nodes.size(), counts->recomputed[numChunks], staticChanged);
+		counts->staticChanged[numChunks] = staticChanged;
+	}));
+
+	return jobs.createJob([&graph, counts]()
+	{
+		graph.numRecomputed = 0;
+		graph.staticChanged = false;
+		for (size_t i = 0; i < counts->recomputed.size(); i++)
+		{
+			graph.numRecomputed += counts->recomputed[i];
+			graph.staticChanged = graph.staticChanged || counts->staticChanged[i];
+		}
+	}, finalJobs);
+}
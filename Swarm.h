@@ -0,0 +1,91 @@
+#ifndef SWARM_H
+#define SWARM_H
+
+#include "TransformSoA.h"
+#include "SceneGraph.h"
+#include "Drone.h"
+#include "JobSystem.h"
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+/* The flying area and how the drones move in it, the values the single drone has always flown with */
+struct FlightLimits
+{
+	float minmaxXZ;		// the drones stay within -minmaxXZ to minmaxXZ in x and z
+	float maxY;
+	float minY;			// the ground, the props stop below this
+	float minYFly;		// the drones have to be above this before they can move sideways
+	float tiltChange;	// degrees a drone tilts each update towards the way it is moving, or back to level
+	float maxTilt;
+	float propSpeed;	// degrees the props turn each update while the drone is off the ground
+};
+
+const FlightLimits defaultFlightLimits = { 9.5f, 5.f, -0.8f, -0.6f, 2.f, 30.f, 47.f };
+
+/* The simulation state of a swarm of drones as a structure of arrays, one array per value, so
+   the update works on 4 or 8 drones at a time with the same lane kernels as TransformSoA.
+   Drone 0 is the one flown with the controls, main copies its state in and out around each update */
+class DroneSwarm
+{
+public:
+	DroneSwarm();
+	~DroneSwarm();
+
+	// new drones are on the ground at the origin with everything else zero and their lights on
+	void resize(size_t count);
+	size_t size() const;
+
+	/* Spreads drones [first, size) over the flying area at random heights, each flying in a
+	   random direction. The same seed gives the same swarm */
+	void scatter(size_t first, unsigned int seed, const FlightLimits& limits = defaultFlightLimits);
+
+	// autopilot for drones [first, first + count), turning them back when they reach the edge of the area
+	void steer(size_t first, size_t count, const FlightLimits& limits = defaultFlightLimits);
+
+	/* One step of flight for drones [first, first + count): each moves by its velocity where the
+	   limits allow, tilts towards the way it is moving or back to level, and spins its props.
+	   Drones don't affect each other, so ranges can be updated in any order or at the same time */
+	void update(size_t first, size_t count, const FlightLimits& limits = defaultFlightLimits, TransformKernel kernel = KERNEL_BEST);
+	void update(const FlightLimits& limits = defaultFlightLimits, TransformKernel kernel = KERNEL_BEST);
+
+	/* The simulation runs in fixed ticks while frames are drawn whenever they are ready, so each
+	   drone keeps its state from before the last tick and is drawn part of the way from there to
+	   where it is now. storePrevious() is called before each tick */
+	void storePrevious(size_t first, size_t count);
+
+	// alpha is how far the frame is from the last tick to the next, 0 to 1
+	glm::vec3 drawnPosition(size_t i, float alpha) const;
+	glm::vec3 drawnAngles(size_t i, float alpha) const;
+	float drawnPropAngle(size_t i, float alpha) const;
+
+	std::vector<float> positionX, positionY, positionZ;
+	std::vector<float> velocityX, velocityY, velocityZ;	// movement per update, the controls set these for drone 0
+	std::vector<float> pitch, yaw, roll;				// the model angles about x, y and z, in degrees
+	std::vector<float> propAngle;
+	std::vector<unsigned char> lightsOn;
+
+	// the state before the last tick
+	std::vector<float> previousX, previousY, previousZ;
+	std::vector<float> previousPitch, previousYaw, previousRoll;
+	std::vector<float> previousPropAngle;
+
+private:
+	size_t count;
+};
+
+/* Schedules a frame of the swarm on the job system, split into chunks of dronesPerJob drones.
+   Each chunk flies its drones numTicks ticks, steering all but drone 0 with the autopilot and
+   leaving the drones before firstFlown where they are. Straight after, without waiting for the
+   other chunks, it poses the drones that have nodes alpha of the way into the next tick and
+   propagates their transforms.
+   drones[i] are the nodes of swarm drone i, drone 0 drawn at controlledScale and the rest at
+   droneScale. Their nodes have to follow each other in the graph, one more job updates the
+   nodes outside them.
+   The returned job finishes once the whole graph is up to date, with numRecomputed and
+   staticChanged set as updateWorldTransforms would. The result doesn't depend on the number
+   of threads or the order the jobs run in */
+JobHandle scheduleSwarmFrame(JobSystem& jobs, DroneSwarm& swarm, size_t firstFlown, const FlightLimits& limits, int numTicks, float alpha,
+	SceneGraph& graph, const std::vector<DroneNodes>& drones, float controlledScale, float droneScale, size_t dronesPerJob = 512);
+
+#endif
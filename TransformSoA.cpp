@@ -0,0 +1,337 @@
+#include "TransformSoA.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+
+/* result = a * b for affine matrices, a is given per transform */
+template <typename Lane>
+static void multiplyKernel(std::vector<float>* a, std::vector<float>* b, std::vector<float>* result, size_t first, size_t last)
+{
+	typedef typename Lane::type V;
+
+	for (size_t i = first; i < last; i += Lane::width)
+	{
+		V m[12];
+		for (int e = 0; e < 12; e++)
+			m[e] = Lane::load(&a[e][i]);
+
+		for (int c = 0; c < 4; c++)
+		{
+			V b0 = Lane::load(&b[c * 3][i]);
+			V b1 = Lane::load(&b[c * 3 + 1][i]);
+			V b2 = Lane::load(&b[c * 3 + 2][i]);
+			for (int r = 0; r < 3; r++)
+			{
+				V v = Lane::add(Lane::add(Lane::mul(m[r], b0), Lane::mul(m[3 + r], b1)), Lane::mul(m[6 + r], b2));
+				// the translation column also picks up a's translation
+				if (c == 3)
+					v = Lane::add(v, m[9 + r]);
+				Lane::store(&result[c * 3 + r][i], v);
+			}
+		}
+	}
+}
+
+/* modelView = view * world, normal = transpose(inverse(mat3(modelView))). The inverse transpose
+   is the cofactor matrix divided by the determinant, whose columns are the cross products of
+   the columns of the matrix */
+template <typename Lane>
+static void modelViewNormalKernel(const glm::mat4& view, std::vector<float>* world, std::vector<float>* modelView, std::vector<float>* normal, size_t count)
+{
+	typedef typename Lane::type V;
+
+	V v[12];
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 3; r++)
+			v[c * 3 + r] = Lane::set(view[c][r]);
+
+	for (size_t i = 0; i < count; i += Lane::width)
+	{
+		V mv[12];
+		for (int c = 0; c < 4; c++)
+		{
+			V w0 = Lane::load(&world[c * 3][i]);
+			V w1 = Lane::load(&world[c * 3 + 1][i]);
+			V w2 = Lane::load(&world[c * 3 + 2][i]);
+			for (int r = 0; r < 3; r++)
+			{
+				mv[c * 3 + r] = Lane::add(Lane::add(Lane::mul(v[r], w0), Lane::mul(v[3 + r], w1)), Lane::mul(v[6 + r], w2));
+				if (c == 3)
+					mv[c * 3 + r] = Lane::add(mv[c * 3 + r], v[9 + r]);
+				Lane::store(&modelView[c * 3 + r][i], mv[c * 3 + r]);
+			}
+		}
+
+		// columns a, b and c of the 3x3 part
+		V* a = &mv[0];
+		V* b = &mv[3];
+		V* c = &mv[6];
+
+		V bc[3], ca[3], ab[3];
+		for (int k = 0; k < 3; k++)
+		{
+			int k1 = (k + 1) % 3;
+			int k2 = (k + 2) % 3;
+			bc[k] = Lane::sub(Lane::mul(b[k1], c[k2]), Lane::mul(b[k2], c[k1]));
+			ca[k] = Lane::sub(Lane::mul(c[k1], a[k2]), Lane::mul(c[k2], a[k1]));
+			ab[k] = Lane::sub(Lane::mul(a[k1], b[k2]), Lane::mul(a[k2], b[k1]));
+		}
+
+		V det = Lane::add(Lane::add(Lane::mul(a[0], bc[0]), Lane::mul(a[1], bc[1])), Lane::mul(a[2], bc[2]));
+		V invDet = Lane::div(Lane::set(1.f), det);
+
+		for (int k = 0; k < 3; k++)
+		{
+			Lane::store(&normal[k][i], Lane::mul(bc[k], invDet));
+			Lane::store(&normal[3 + k][i], Lane::mul(ca[k], invDet));
+			Lane::store(&normal[6 + k][i], Lane::mul(ab[k], invDet));
+		}
+	}
+}
+
+TransformKernel resolveKernel(TransformKernel kernel)
+{
+	if (kernel == KERNEL_BEST)
+	{
+#if defined(TRANSFORM_AVX)
+		return KERNEL_AVX;
+#elif defined(TRANSFORM_SSE)
+		return KERNEL_SSE;
+#else
+		return KERNEL_SCALAR;
+#endif
+	}
+	if (!transformKernelAvailable(kernel))
+		return KERNEL_SCALAR;
+	return kernel;
+}
+
+bool transformKernelAvailable(TransformKernel kernel)
+{
+	switch (kernel)
+	{
+#ifdef TRANSFORM_SSE
+	case KERNEL_SSE:
+		return true;
+#endif
+#ifdef TRANSFORM_AVX
+	case KERNEL_AVX:
+		return true;
+#endif
+	case KERNEL_SCALAR:
+	case KERNEL_BEST:
+		return true;
+	default:
+		return false;
+	}
+}
+
+const char* transformKernelName(TransformKernel kernel)
+{
+	switch (resolveKernel(kernel))
+	{
+	case KERNEL_SSE:
+		return "sse";
+	case KERNEL_AVX:
+		return "avx";
+	default:
+		return "scalar";
+	}
+}
+
+static void setIdentity(std::vector<float>* m, size_t i)
+{
+	for (int e = 0; e < 12; e++)
+		m[e][i] = (e == 0 || e == 4 || e == 8) ? 1.f : 0.f;
+}
+
+static void setAffine(std::vector<float>* m, size_t i, const glm::mat4& value)
+{
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 3; r++)
+			m[c * 3 + r][i] = value[c][r];
+}
+
+static glm::mat4 getAffine(const std::vector<float>* m, size_t i)
+{
+	glm::mat4 value(1.f);
+	for (int c = 0; c < 4; c++)
+		for (int r = 0; r < 3; r++)
+			value[c][r] = m[c * 3 + r][i];
+	return value;
+}
+
+TransformSoA::TransformSoA()
+{
+	count = 0;
+}
+
+TransformSoA::~TransformSoA()
+{}
+
+void TransformSoA::resize(size_t count)
+{
+	size_t padded = (count + 7) & ~(size_t)7;
+	size_t oldPadded = this->local[0].size();
+
+	for (int e = 0; e < 12; e++)
+	{
+		local[e].resize(padded);
+		world[e].resize(padded);
+		modelView[e].resize(padded);
+		parentWorld[e].resize(padded);
+	}
+	for (int e = 0; e < 9; e++)
+		normal[e].resize(padded);
+
+	// new slots start as identity so the padding never divides by a zero determinant
+	for (size_t i = oldPadded; i < padded; i++)
+	{
+		setIdentity(local, i);
+		setIdentity(world, i);
+		setIdentity(parentWorld, i);
+	}
+
+	parent.resize(count, -1);
+	this->count = count;
+}
+
+size_t TransformSoA::size() const
+{
+	return count;
+}
+
+void TransformSoA::setLocal(size_t i, const glm::mat4& m)
+{
+	setAffine(local, i, m);
+}
+
+void TransformSoA::setWorld(size_t i, const glm::mat4& m)
+{
+	setAffine(world, i, m);
+}
+
+glm::mat4 TransformSoA::getWorld(size_t i) const
+{
+	return getAffine(world, i);
+}
+
+glm::mat4 TransformSoA::getModelView(size_t i) const
+{
+	return getAffine(modelView, i);
+}
+
+glm::mat3 TransformSoA::getNormal(size_t i) const
+{
+	glm::mat3 value;
+	for (int c = 0; c < 3; c++)
+		for (int r = 0; r < 3; r++)
+			value[c][r] = normal[c * 3 + r][i];
+	return value;
+}
+
+void TransformSoA::buildFromSceneGraph(const SceneGraph& graph)
+{
+	size_t numNodes = graph.nodes.size();
+
+	// depth of every node, parents always come before their children in the graph
+	std::vector<int> depth(numNodes);
+	int maxDepth = 0;
+	for (size_t i = 0; i < numNodes; i++)
+	{
+		int p = graph.nodes[i].parent;
+		depth[i] = p >= 0 ? depth[p] + 1 : 0;
+		maxDepth = std::max(maxDepth, depth[i]);
+	}
+
+	// counting sort of the nodes by depth
+	levelStart.assign(maxDepth + 2, 0);
+	for (size_t i = 0; i < numNodes; i++)
+		levelStart[depth[i] + 1]++;
+	for (int d = 1; d <= maxDepth + 1; d++)
+		levelStart[d] += levelStart[d - 1];
+
+	resize(numNodes);
+	slotOfNode.resize(numNodes);
+	std::vector<size_t> next(levelStart.begin(), levelStart.end() - 1);
+	for (size_t i = 0; i < numNodes; i++)
+		slotOfNode[i] = (int)next[depth[i]]++;
+
+	for (size_t i = 0; i < numNodes; i++)
+	{
+		const SceneNode& node = graph.nodes[i];
+		size_t slot = slotOfNode[i];
+		parent[slot] = node.parent >= 0 ? slotOfNode[node.parent] : -1;
+		setLocal(slot, localTransform(node));
+	}
+}
+
+void TransformSoA::updateWorld(TransformKernel kernel)
+{
+	kernel = resolveKernel(kernel);
+
+	for (size_t level = 0; level + 1 < levelStart.size(); level++)
+	{
+		size_t first = levelStart[level];
+		size_t last = levelStart[level + 1];
+
+		// gather the parent matrices next to their children so the multiply reads contiguously
+		for (size_t i = first; i < last; i++)
+		{
+			if (parent[i] >= 0)
+			{
+				for (int e = 0; e < 12; e++)
+					parentWorld[e][i] = world[e][parent[i]];
+			}
+			else
+			{
+				setIdentity(parentWorld, i);
+			}
+		}
+
+		// levels start at any index so the first few transforms of a level are done one at a time
+		size_t alignedFirst = std::min(last, (first + 7) & ~(size_t)7);
+		multiplyKernel<ScalarLane>(parentWorld, local, world, first, alignedFirst);
+		size_t alignedLast = alignedFirst + ((last - alignedFirst) & ~(size_t)7);
+
+		switch (kernel)
+		{
+#ifdef TRANSFORM_AVX
+		case KERNEL_AVX:
+			multiplyKernel<AvxLane>(parentWorld, local, world, alignedFirst, alignedLast);
+			break;
+#endif
+#ifdef TRANSFORM_SSE
+		case KERNEL_SSE:
+			multiplyKernel<SseLane>(parentWorld, local, world, alignedFirst, alignedLast);
+			break;
+#endif
+		default:
+			multiplyKernel<ScalarLane>(parentWorld, local, world, alignedFirst, alignedLast);
+			break;
+		}
+		multiplyKernel<ScalarLane>(parentWorld, local, world, alignedLast, last);
+	}
+}
+
+void TransformSoA::computeModelViewNormal(const glm::mat4& view, TransformKernel kernel)
+{
+	size_t padded = world[0].size();
+
+	switch (resolveKernel(kernel))
+	{
+#ifdef TRANSFORM_AVX
+	case KERNEL_AVX:
+		modelViewNormalKernel<AvxLane>(view, world, modelView, normal, padded);
+		break;
+#endif
+#ifdef TRANSFORM_SSE
+	case KERNEL_SSE:
+		modelViewNormalKernel<SseLane>(view, world, modelView, normal, padded);
+		break;
+#endif
+	default:
+		modelViewNormalKernel<ScalarLane>(view, world, modelView, normal, padded);
+		break;
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef TRANSFORMSOA_H
+#define TRANSFORMSOA_H
+
+#include "SceneGraph.h"
+#include <vector>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+// which implementation of the batched kernels to run, KERNEL_BEST picks the widest one compiled in
+enum TransformKernel
+{
+	KERNEL_SCALAR,
+	KERNEL_SSE,
+	KERNEL_AVX,
+	KERNEL_BEST
+};
+
+bool transformKernelAvailable(TransformKernel kernel);
+
+// KERNEL_BEST becomes the widest kernel compiled in, and kernels that aren't compiled in become scalar
+TransformKernel resolveKernel(TransformKernel kernel);
+const char* transformKernelName(TransformKernel kernel);
+
+/* Structure of arrays storage for affine transforms. Each matrix element has its own array
+   so the kernels can work on 4 (SSE) or 8 (AVX) transforms at once. Affine matrices only keep
+   their top 3 rows, element [column][row] is stored in array column * 3 + row. The arrays are
+   padded to a multiple of 8 transforms so the kernels never need a scalar tail */
+class TransformSoA
+{
+public:
+	TransformSoA();
+	~TransformSoA();
+
+	void resize(size_t count);
+	size_t size() const;
+
+	void setLocal(size_t i, const glm::mat4& m);
+	void setWorld(size_t i, const glm::mat4& m);
+	glm::mat4 getWorld(size_t i) const;
+	glm::mat4 getModelView(size_t i) const;
+	glm::mat3 getNormal(size_t i) const;
+
+	/* Copies the hierarchy of a scene graph. The transforms are reordered by depth so every
+	   node of one level can be multiplied by its parent in one batch, slotOfNode maps a scene
+	   graph node to its index here */
+	void buildFromSceneGraph(const SceneGraph& graph);
+
+	// world = parent world * local for every transform, one level of the hierarchy at a time
+	void updateWorld(TransformKernel kernel = KERNEL_BEST);
+
+	// modelView = view * world and normal = transpose(inverse(mat3(modelView))) for every transform
+	void computeModelViewNormal(const glm::mat4& view, TransformKernel kernel = KERNEL_BEST);
+
+	std::vector<float> local[12];
+	std::vector<float> world[12];
+	std::vector<float> modelView[12];
+	std::vector<float> normal[9];
+
+	std::vector<int> parent;		// parent index for each transform, -1 for roots
+	std::vector<size_t> levelStart;	// first index of each level of the hierarchy
+	std::vector<int> slotOfNode;
+
+private:
+	size_t count;
+	std::vector<float> parentWorld[12];	// parent matrices gathered for the level being updated
+};
+
+#endif
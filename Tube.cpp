@@ -1,4 +1,8 @@
 #include "Tube.h"
+#include "UnitTube.h"
+#include "RenderStats.h"
+
+#include <cstring>
 
 #define PI 3.14159265358979f
 
@@ -10,14 +14,15 @@ Tube::Tube()
 	attribute_v_colours = 1;
 	attribute_v_normal = 2;
 	numTubeVertices = 0;
+	useVertexArray = true;
 }
 
 Tube::~Tube()
 {}
 
-void Tube::makeTube(GLuint numSegments, GLfloat thickness)
+void Tube::makeTube(GLuint numSegments, GLfloat thickness, const VertexFormat& format, MeshCache* cache)
 {
-	GLuint numvertices = 8 * (numSegments);
+	GLuint numvertices = tubeVertexCount(numSegments);
 
 	// Store the number of sphere vertices in an attribute because we need it later when drawing it
 	this->numTubeVertices = numvertices;
@@ -35,97 +40,105 @@ void Tube::makeTube(GLuint numSegments, GLfloat thickness)
 		this->thickness = thickness;
 	}
 
-	// Create the temporary arrays to stro
-	GLfloat* pVertices = new GLfloat[numvertices * 3];
-	GLfloat* pNormals = new GLfloat[numvertices * 3];
-	GLfloat* pColours = new GLfloat[numvertices * 4];
-	this->makeUnitTube(pVertices);
-
-	for (int i = 0; i < numvertices; i++)
+	// tubes with the same segments, thickness and format can share their buffers
+	MeshKey key = { GENERATOR_TUBE, { (int)numSegments, 0 }, format.halfPositions, format.colours, true };
+	std::memcpy(&key.parameters[1], &this->thickness, sizeof(float));
+	if (cache)
 	{
-		pColours[i * 4] = pVertices[i * 3];
-		pColours[i * 4 + 1] = pVertices[i * 3 + 1];
-		pColours[i * 4 + 2] = pVertices[i * 3 + 2];
-		pColours[i * 4 + 3] = 1.f;
+		buffers = cache->find(key);
+		if (buffers)
+		{
+			boundsMin = buffers->boundsMin;
+			boundsMax = buffers->boundsMax;
+			return;
+		}
 	}
 
-	// sets normals for top and bottom disks
-	for (int i = 0; i < numvertices / 2; i++)
+	// the drone's tubes are built at compile time, anything else is generated now
+	const UnitTubeTable* table = findUnitTube(numSegments, this->thickness);
+	const GLfloat *pVertices, *pNormals, *pColours;
+	std::vector<GLuint> indices;
+	if (table)
 	{
-		pNormals[i * 3] = 0;
-		pNormals[(i * 3) + 1] = 0;
-		pNormals[(i * 3) + 2] = pVertices[(i * 3) + 2];
+		pVertices = table->positions;
+		pNormals = table->normals;
+		pColours = table->colours;
+		indices.assign(table->indices, table->indices + numvertices + 8);
+	}
+	else
+	{
+		// the generator's arrays are kept between calls, so making tubes doesn't allocate once they're big enough
+		static TubeGenerator generator;
+		generator.generate(numSegments, this->thickness);
+		pVertices = generator.positions.data();
+		pNormals = generator.normals.data();
+		pColours = generator.colours.data();
+		makeStripIndices(numSegments, indices);
 	}
 
-	for (int i = numvertices / 2; i < numvertices; i++)
+	// bounding box of the vertices, used for culling
+	boundsMin = boundsMax = glm::vec3(pVertices[0], pVertices[1], pVertices[2]);
+	for (GLuint i = 0; i < numvertices; i++)
 	{
-		pNormals[i * 3] = pVertices[(i * 3)];
-		pNormals[(i * 3) + 1] = pVertices[(i * 3) + 1];
-		pNormals[(i * 3) + 2] = 0;
+		glm::vec3 position(pVertices[i * 3], pVertices[i * 3 + 1], pVertices[i * 3 + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
 	}
 
+	/* Interleave the positions, normals and colours into one vertex buffer */
+	std::vector<unsigned char> vertices;
+	interleaveVertices(format, pVertices, pNormals, pColours, numvertices, vertices);
+
+	buffers = createMeshBuffers(format, vertices, indices, cache ? cache->arena : NULL, attribute_v_coord, attribute_v_normal, attribute_v_colours);
+	buffers->boundsMin = boundsMin;
+	buffers->boundsMax = boundsMax;
+	if (cache)
+		cache->insert(key, buffers);
+}
+
 
-	/* Generate the vertex buffer object */
-	glGenBuffers(1, &this->tubeBufferObject);
-	glBindBuffer(GL_ARRAY_BUFFER, this->tubeBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 3, pVertices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+/* points the vertex attributes and element buffer at the tube's buffers in the bound vertex array
+   object, returns the number of GL calls made */
+int Tube::specifyAttributes()
+{
+	glBindBuffer(GL_ARRAY_BUFFER, buffers->vertexBuffer);
+	int calls = 1 + setVertexAttributes(buffers->format, attribute_v_coord, attribute_v_normal, attribute_v_colours);
 
-	/* Store the normals in a buffer object */
-	glGenBuffers(1, &this->tubeNormals);
-	glBindBuffer(GL_ARRAY_BUFFER, this->tubeNormals);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 3, pNormals, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	/* Bind the indexed vertex buffer */
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->elementBuffer);
+	return calls + 1;
+}
 
-	/* Store the colours in a buffer object */
-	glGenBuffers(1, &this->tubeColours);
-	glBindBuffer(GL_ARRAY_BUFFER, this->tubeColours);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(GLfloat) * numvertices * 4, pColours, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-	GLuint numindices = numvertices + 8;
-	GLuint* pindices = new GLuint[numindices];
+/* One triangle strip for each of the top, bottom, outside and inside surfaces. Each strip
+   goes round the tube's numSegments * 2 vertices for the surface and repeats the first two */
+void Tube::makeStripIndices(GLuint numSegments, std::vector<GLuint>& indices)
+{
+	GLuint numvertices = 8 * numSegments;
+	indices.resize(numvertices + 8);
 
-	for (int i = 0; i < 4; i++)
+	for (GLuint i = 0; i < 4; i++)
 	{
-		for (int j = 0; j < (numvertices/4); j++)
+		for (GLuint j = 0; j < (numvertices / 4); j++)
 		{
-			pindices[i * ((numvertices / 4)  + 2) + j] = i * (numvertices / 4) + j;
+			indices[i * ((numvertices / 4) + 2) + j] = i * (numvertices / 4) + j;
 		}
-		pindices[i * ((numvertices / 4) + 2) + (numvertices / 4)] = i * (numvertices / 4);
-		pindices[i * ((numvertices / 4) + 2) + (numvertices / 4) + 1] = i * (numvertices / 4) + 1;
-	}
-	
-	// Generate a buffer for the indices
-	glGenBuffers(1, &elementbuffer);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, numindices * sizeof(GLuint), pindices, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	delete pindices;
-	delete pColours;
-	delete pVertices;
+		indices[i * ((numvertices / 4) + 2) + (numvertices / 4)] = i * (numvertices / 4);
+		indices[i * ((numvertices / 4) + 2) + (numvertices / 4) + 1] = i * (numvertices / 4) + 1;
+	}
 }
 
 
-void Tube::drawTube(int drawmode)
+void Tube::bindTube(int drawmode)
 {
-	GLuint i;
-
-	/* Draw the vertices as GL_POINTS */
-	glBindBuffer(GL_ARRAY_BUFFER, this->tubeBufferObject);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(0);
-
-	/* Bind the sphere normals */
-	glEnableVertexAttribArray(2);
-	glBindBuffer(GL_ARRAY_BUFFER, this->tubeNormals);
-	glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-
-	/* Bind the sphere colours */
-	glBindBuffer(GL_ARRAY_BUFFER, this->tubeColours);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 0, 0);
-	glEnableVertexAttribArray(1);
+	if (useVertexArray)
+	{
+		bindVertexArray(buffers->vertexArray);
+	}
+	else
+	{
+		renderStats.partSetupCalls += specifyAttributes();
+	}
 
 	glPointSize(3.f);
 
@@ -134,87 +147,142 @@ void Tube::drawTube(int drawmode)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	else
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	renderStats.partSetupCalls += 2;	// point size and polygon mode
+}
+
+
+void Tube::drawTube(int drawmode)
+{
+	bindTube(drawmode);
+	drawTubeBound(drawmode);
+}
+
+
+// byte offset of one of the four strips in the element buffer
+GLvoid* Tube::stripOffset(int strip) const
+{
+	return (GLvoid*)(buffers->indexOffset + strip * ((this->numTubeVertices / 4) + 2) * buffers->indexSize);
+}
 
+
+// draws the tube using the buffers bound by bindTube
+void Tube::drawTubeBound(int drawmode)
+{
 	if (drawmode == 2)
 	{
-		glDrawArrays(GL_POINTS, 0, this->numTubeVertices);
+		glDrawArrays(GL_POINTS, buffers->baseVertex, this->numTubeVertices);
+		renderStats.drawCalls++;
 	}
 	else
 	{
-		/* Bind the indexed vertex buffer */
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementbuffer);
-
 		for (int i = 0; i < 4; i++)
 		{
-			glDrawElements(GL_TRIANGLE_STRIP, this->numSegments * 2 + 2, GL_UNSIGNED_INT, (GLvoid*)(i * ((this->numTubeVertices/4) + 2) * 4));
+			glDrawElementsBaseVertex(GL_TRIANGLE_STRIP, this->numSegments * 2 + 2, buffers->indexType, stripOffset(i), buffers->baseVertex);
 		}
+		renderStats.drawCalls += 4;
 	}
+	renderStats.instancesDrawn++;
+	renderStats.trianglesDrawn += 8 * numSegments;
 }
 
 
-void Tube::makeUnitTube(GLfloat* pVertices)
+// draws every queued instance of the tube and empties the queue
+void Tube::drawTubeInstanced(int drawmode)
 {
-	float segmentAngleIncrement = (2 * PI) / this->numSegments;
+	GLsizei numInstances = instances.numInstances();
+	if (numInstances == 0)
+		return;
 
-	int numVerticesPerSection = (this->numSegments * 2);
+	bindTube(drawmode);
+	instances.bindInstances();
 
-	// top disk
-	for (int i = 0; i < this->numSegments; i++)
+	if (drawmode == 2)
 	{
-		// to effectively set the index to 0 for the last vertices to finish the loop with repeating vertices
-		//int segmentIdx = i % this->numSegments;
-
-		// outside vertices
-		pVertices[i * 6] = 0.5f * sin(segmentAngleIncrement * i);
-		pVertices[(i * 6) + 1] = 0.5f * cos(segmentAngleIncrement * i);
-		pVertices[(i * 6) + 2] = 0.5f;
-
-		// inside vertices
-		pVertices[(i * 6) + 3] = (0.5f - (this->thickness * 0.5f)) * sin(segmentAngleIncrement * i);
-		pVertices[(i * 6) + 4] = (0.5f - (this->thickness * 0.5f)) * cos(segmentAngleIncrement * i);
-		pVertices[(i * 6) + 5] = 0.5f;
+		glDrawArraysInstanced(GL_POINTS, buffers->baseVertex, this->numTubeVertices, numInstances);
+		renderStats.drawCalls++;
 	}
-
-	for (int i = 0; i < this->numSegments * 6; i++)
+	else
 	{
-		// outside vertices
-		if (i % 3 != 2)
+		// one strip for each of the top, bottom, outside and inside surfaces
+		for (int i = 0; i < 4; i++)
 		{
-			// copies the x and y coordinates from the previous disk
-			pVertices[(numVerticesPerSection * 3) + i] = pVertices[i];
+			glDrawElementsInstancedBaseVertex(GL_TRIANGLE_STRIP, this->numSegments * 2 + 2, buffers->indexType, stripOffset(i), numInstances, buffers->baseVertex);
 		}
-		else
+		renderStats.drawCalls += 4;
+	}
+	renderStats.instancesDrawn += numInstances;
+	renderStats.trianglesDrawn += 8 * numSegments * numInstances;
+
+	instances.unbindInstances();
+	instances.clear();
+}
+
+
+/* Writes the tube's vertices in four sections of numSegments * 2: the top disk, the bottom
+   disk, the outside and the inside, each going round the segments with an outer and inner
+   (or top and bottom) vertex per segment. sin and cos are only worked out once per segment */
+void generateTube(GLuint numSegments, GLfloat thickness, GLfloat* positions, GLfloat* normals, GLfloat* colours)
+{
+	float segmentAngleIncrement = (2 * PI) / numSegments;
+	float innerRadius = 0.5f - (thickness * 0.5f);
+
+	GLuint numVerticesPerSection = numSegments * 2;
+	GLfloat* top = positions;
+	GLfloat* bottom = positions + numVerticesPerSection * 3;
+	GLfloat* outside = positions + numVerticesPerSection * 6;
+	GLfloat* inside = positions + numVerticesPerSection * 9;
+
+	for (GLuint i = 0; i < numSegments; i++)
+	{
+		// auto keeps whatever type sin and cos return for a float, so the products round the same way as they always have
+		auto sinAngle = sin(segmentAngleIncrement * i);
+		auto cosAngle = cos(segmentAngleIncrement * i);
+
+		GLfloat outerX = 0.5f * sinAngle, outerY = 0.5f * cosAngle;
+		GLfloat innerX = innerRadius * sinAngle, innerY = innerRadius * cosAngle;
+
+		GLfloat topVertices[6] = { outerX, outerY, 0.5f, innerX, innerY, 0.5f };
+		GLfloat bottomVertices[6] = { outerX, outerY, -0.5f, innerX, innerY, -0.5f };
+		GLfloat outsideVertices[6] = { outerX, outerY, 0.5f, outerX, outerY, -0.5f };
+		GLfloat insideVertices[6] = { innerX, innerY, 0.5f, innerX, innerY, -0.5f };
+		for (int k = 0; k < 6; k++)
 		{
-			// sets the z coordinate to the negative of the previous disk
-			pVertices[(numVerticesPerSection * 3) + i] = -pVertices[i];
+			top[i * 6 + k] = topVertices[k];
+			bottom[i * 6 + k] = bottomVertices[k];
+			outside[i * 6 + k] = outsideVertices[k];
+			inside[i * 6 + k] = insideVertices[k];
 		}
 	}
-	
-	// generates the outside surface
-	for (int i = 0; i < this->numSegments; i++)
-	{
-		// copies outside vertices from the top disk
-		pVertices[((numVerticesPerSection * 3) * 2) + (i * 6)] = pVertices[(i * 6)];
-		pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + 1] = pVertices[(i * 6) + 1];
-		pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + 2] = pVertices[(i * 6) + 2];
 
-		// copies outside vertices from bottom disk
-		pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + 3] = pVertices[(numVerticesPerSection * 3) + (i * 6) ];
-		pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + 4] = pVertices[(numVerticesPerSection * 3) + (i * 6) + 1];
-		pVertices[((numVerticesPerSection * 3) * 2) + (i * 6) + 5] = pVertices[(numVerticesPerSection * 3) + (i * 6) + 2];
+	GLuint numvertices = tubeVertexCount(numSegments);
+	for (GLuint i = 0; i < numvertices; i++)
+	{
+		// the disks' normals point along z, the outside and inside point away from the axis
+		bool disk = i < numvertices / 2;
+		normals[i * 3] = disk ? 0 : positions[i * 3];
+		normals[i * 3 + 1] = disk ? 0 : positions[i * 3 + 1];
+		normals[i * 3 + 2] = disk ? positions[i * 3 + 2] : 0;
+
+		colours[i * 4] = positions[i * 3];
+		colours[i * 4 + 1] = positions[i * 3 + 1];
+		colours[i * 4 + 2] = positions[i * 3 + 2];
+		colours[i * 4 + 3] = 1.f;
 	}
+}
 
-	// generates the inside surface
-	for (int i = 0; i < this->numSegments; i++)
-	{
-		// copies outside vertices from the top disk
-		pVertices[((numVerticesPerSection * 3) * 3) + (i * 6)] = pVertices[(i * 6) + 3];
-		pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + 1] = pVertices[(i * 6) + 4];
-		pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + 2] = pVertices[(i * 6) + 5];
 
-		// copies outside vertices from bottom disk
-		pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + 3] = pVertices[((numVerticesPerSection * 3))+(i * 6) + 3];
-		pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + 4] = pVertices[((numVerticesPerSection * 3))+(i * 6) + 4];
-		pVertices[((numVerticesPerSection * 3) * 3) + (i * 6) + 5] = pVertices[((numVerticesPerSection * 3))+(i * 6) + 5];
-	}
-}
\ No newline at end of file
+TubeGenerator::TubeGenerator()
+{}
+
+TubeGenerator::~TubeGenerator()
+{}
+
+void TubeGenerator::generate(GLuint numSegments, GLfloat thickness)
+{
+	// resize only allocates when the tube is bigger than any before it
+	GLuint numvertices = tubeVertexCount(numSegments);
+	positions.resize(numvertices * 3);
+	normals.resize(numvertices * 3);
+	colours.resize(numvertices * 4);
+	generateTube(numSegments, thickness, positions.data(), normals.data(), colours.data());
+}
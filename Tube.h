@@ -4,6 +4,35 @@
 #include "wrapper_glfw.h"
 #include <vector>
 #include <glm/glm.hpp>
+#include "InstanceBuffer.h"
+#include "VertexFormat.h"
+#include "MeshBuffers.h"
+
+// 8 vertices a segment: the top and bottom disks, the outside and the inside
+inline GLuint tubeVertexCount(GLuint numSegments)
+{
+	return 8 * numSegments;
+}
+
+/* Generates a unit tube into caller provided arrays of tubeVertexCount(numSegments) vertices:
+   3 floats each for positions and normals and 4 for colours. thickness is from 0 to 1 and
+   doesn't get clamped. Nothing is allocated */
+void generateTube(GLuint numSegments, GLfloat thickness, GLfloat* positions, GLfloat* normals, GLfloat* colours);
+
+/* Keeps the arrays for generateTube between calls, so making many tubes only allocates
+   when a tube needs more room than the ones before it */
+class TubeGenerator
+{
+public:
+	TubeGenerator();
+	~TubeGenerator();
+
+	void generate(GLuint numSegments, GLfloat thickness);
+
+	std::vector<GLfloat> positions;
+	std::vector<GLfloat> normals;
+	std::vector<GLfloat> colours;
+};
 
 class Tube
 {
@@ -11,25 +40,44 @@ public:
 	Tube();
 	~Tube();
 
-	void makeTube(GLuint numSegments, GLfloat thickness);
+	/* the vertices are interleaved in the given format, see VertexFormat.h. With a cache, a tube
+	   made before with the same parameters shares its buffers rather than making new ones */
+	void makeTube(GLuint numSegments, GLfloat thickness, const VertexFormat& format = fullVertexFormat, MeshCache* cache = NULL);
 	void drawTube(int drawmode);
+	void drawTubeInstanced(int drawmode);
+
+	// the indices of the tube's four triangle strips, numSegments * 2 + 2 each
+	static void makeStripIndices(GLuint numSegments, std::vector<GLuint>& indices);
+
+	/* drawTube split in two, so a run of tubes only binds the buffers once.
+	   drawTubeBound draws with whatever bindTube last set up */
+	void bindTube(int drawmode);
+	void drawTubeBound(int drawmode);
 
-	// Define vertex buffer object names (e.g as globals)
-	GLuint tubeBufferObject;
-	GLuint tubeNormals;
-	GLuint tubeColours;
-	GLuint elementbuffer;
+	// the interleaved vertices, strip indices and vertex array object, possibly shared with other tubes
+	std::shared_ptr<MeshBuffers> buffers;
 
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_colours;
 
+	/* Draw from the vertex array object holding the attribute layout and element buffer. With
+	   useVertexArray off they are specified again on every bind instead */
+	bool useVertexArray;
+
 	int numTubeVertices;
 	int numSegments;
 	float thickness;
 
+	// object space bounding box, set by makeTube
+	glm::vec3 boundsMin, boundsMax;
+
+	// instances queued for the next drawTubeInstanced call
+	InstanceBuffer instances;
+
 private:
-	void makeUnitTube(GLfloat* pVertices);
+	int specifyAttributes();
+	GLvoid* stripOffset(int strip) const;
 };
 
 
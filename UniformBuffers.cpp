@@ -0,0 +1,116 @@
+#include "UniformBuffers.h"
+#include "RenderStats.h"
+
+#include <cstddef>
+#include <iostream>
+
+// the C++ structs have to match the std140 layout in the shaders
+static_assert(sizeof(FrameUniforms) == 448, "FrameUniforms does not match the std140 layout of FrameBlock");
+static_assert(sizeof(LightData) == 32, "LightData does not match the std140 layout of Light");
+static_assert(offsetof(LightUniforms, lights) == 16, "LightUniforms does not match the std140 layout of LightBlock");
+
+UniformBuffer::UniformBuffer()
+{
+	bufferObject = 0;
+	bindingPoint = 0;
+	size = 0;
+	boundToRing = false;
+}
+
+UniformBuffer::~UniformBuffer()
+{}
+
+void UniformBuffer::create(GLsizeiptr size, GLuint bindingPoint)
+{
+	this->size = size;
+	this->bindingPoint = bindingPoint;
+
+	glGenBuffers(1, &this->bufferObject);
+	glBindBuffer(GL_UNIFORM_BUFFER, this->bufferObject);
+	glBufferData(GL_UNIFORM_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	// the buffer stays attached to its binding point, programs pick it up through their block binding
+	glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, this->bufferObject);
+}
+
+void UniformBuffer::bindToProgram(GLuint program, const char* blockName)
+{
+	GLuint blockIndex = glGetUniformBlockIndex(program, blockName);
+	if (blockIndex == GL_INVALID_INDEX)
+	{
+		std::cout << "uniform block " << blockName << " not found" << std::endl;
+		return;
+	}
+	glUniformBlockBinding(program, blockIndex, this->bindingPoint);
+}
+
+void UniformBuffer::update(const void* data, GLsizeiptr size, UploadRing* ring)
+{
+	if (ring)
+	{
+		static GLint offsetAlignment = 0;
+		if (offsetAlignment == 0)
+			glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &offsetAlignment);
+
+		// the bound range covers the whole block, as the shader may be given no less
+		GLintptr offset = ring->write(data, this->size, offsetAlignment);
+		if (offset >= 0)
+		{
+			glBindBufferRange(GL_UNIFORM_BUFFER, this->bindingPoint, ring->bufferObject, offset, this->size);
+			renderStats.partSetupCalls++;
+			boundToRing = true;
+			return;
+		}
+	}
+
+	glBindBuffer(GL_UNIFORM_BUFFER, this->bufferObject);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	renderStats.partSetupCalls += 3;
+
+	if (boundToRing)
+	{
+		glBindBufferBase(GL_UNIFORM_BUFFER, this->bindingPoint, this->bufferObject);
+		renderStats.partSetupCalls++;
+		boundToRing = false;
+	}
+}
+
+LightBuffer::LightBuffer()
+{
+	data.numLights = 0;
+}
+
+void LightBuffer::create()
+{
+	buffer.create(sizeof(LightUniforms), lightBlockBinding);
+}
+
+void LightBuffer::clear()
+{
+	data.numLights = 0;
+}
+
+bool LightBuffer::addLight(glm::vec3 position, glm::vec3 colour, GLuint mode)
+{
+	if (data.numLights >= (GLuint)maxNumLights)
+		return false;
+
+	LightData& light = data.lights[data.numLights++];
+	light.position = glm::vec4(position, 1.f);
+	light.colour = colour;
+	light.mode = mode;
+	return true;
+}
+
+void LightBuffer::upload(UploadRing* ring)
+{
+	// only the lights in use are sent
+	buffer.update(&data, offsetof(LightUniforms, lights) + sizeof(LightData) * data.numLights, ring);
+}
+
+int LightBuffer::numLights() const
+{
+	return (int)data.numLights;
+}
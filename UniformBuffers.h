@@ -0,0 +1,94 @@
+#ifndef UNIFORMBUFFERS_H
+#define UNIFORMBUFFERS_H
+
+#include "wrapper_glfw.h"
+#include "UploadRing.h"
+#include <glm/glm.hpp>
+
+// must match MAX_LIGHTS in poslight.frag
+const int maxNumLights = 64;
+
+// must match MAX_CASCADES in poslight.vert and poslight.frag
+const int maxShadowCascades = 4;
+
+// binding points shared by every program that uses the blocks
+const GLuint frameBlockBinding = 0;
+const GLuint lightBlockBinding = 1;
+
+/* std140 layout of FrameBlock in poslight.vert and poslight.frag */
+struct FrameUniforms
+{
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 lightSpaceMatrix[maxShadowCascades];
+	float cascadeSplits[maxShadowCascades];	// far view space depth of each cascade
+	GLuint colourMode;
+	GLuint attenuationMode;
+	GLuint unused;
+	GLuint numCascades;
+	glm::uvec4 clusterCount;	// tiles in x and y, depth slices, and 1 when clustered lighting is on
+	glm::vec4 clusterScale;		// tile size in pixels, depth slice scale and bias
+};
+
+/* std140 layout of the Light struct, the uint fills the space after the vec3 */
+struct LightData
+{
+	glm::vec4 position;
+	glm::vec3 colour;
+	GLuint mode;	// 1 for the light that casts shadows
+};
+
+/* std140 layout of LightBlock in poslight.frag */
+struct LightUniforms
+{
+	GLuint numLights;
+	GLuint padding[3];
+	LightData lights[maxNumLights];
+};
+
+/* A uniform buffer object holding the data for one uniform block */
+class UniformBuffer
+{
+public:
+	UniformBuffer();
+	~UniformBuffer();
+
+	void create(GLsizeiptr size, GLuint bindingPoint);
+
+	// connects the named block of the program to this buffer's binding point
+	void bindToProgram(GLuint program, const char* blockName);
+
+	/* one upload of the first size bytes of the block. With a ring the whole block is copied into
+	   it and the binding point is moved to that range of the ring, so data must hold the whole block */
+	void update(const void* data, GLsizeiptr size, UploadRing* ring = NULL);
+
+	GLuint bufferObject;
+	GLuint bindingPoint;
+	GLsizeiptr size;
+
+private:
+	bool boundToRing;	// the binding point is on a range of the ring rather than bufferObject
+};
+
+/* Collects the lights for a frame and sends them in one upload */
+class LightBuffer
+{
+public:
+	LightBuffer();
+
+	void create();
+	void clear();
+
+	// returns false once maxNumLights lights have been added
+	bool addLight(glm::vec3 position, glm::vec3 colour, GLuint mode = 0);
+	void upload(UploadRing* ring = NULL);
+
+	int numLights() const;
+
+	UniformBuffer buffer;
+
+private:
+	LightUniforms data;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "UnitTube.h"
+
+/* The arms are 15 segments and the motor parts 40, halved for each level of detail down to 6
+   (see lodSegments). Tubes not listed here are still generated when they're made */
+static constexpr UnitTube<15, 100> arm0;
+static constexpr UnitTube<7, 100> arm1;
+static constexpr UnitTube<6, 100> arm2;
+
+static constexpr UnitTube<40, 100> bell0;
+static constexpr UnitTube<20, 100> bell1;
+static constexpr UnitTube<10, 100> bell2;
+
+static constexpr UnitTube<40, 850> stator0;
+static constexpr UnitTube<20, 850> stator1;
+static constexpr UnitTube<10, 850> stator2;
+static constexpr UnitTube<6, 850> stator3;
+
+static constexpr UnitTube<40, 700> shaft0;
+static constexpr UnitTube<20, 700> shaft1;
+static constexpr UnitTube<10, 700> shaft2;
+static constexpr UnitTube<6, 700> shaft3;
+
+const UnitTubeTable unitTubeTables[] =
+{
+	unitTubeTable(arm0), unitTubeTable(arm1), unitTubeTable(arm2),
+	unitTubeTable(bell0), unitTubeTable(bell1), unitTubeTable(bell2),
+	unitTubeTable(stator0), unitTubeTable(stator1), unitTubeTable(stator2), unitTubeTable(stator3),
+	unitTubeTable(shaft0), unitTubeTable(shaft1), unitTubeTable(shaft2), unitTubeTable(shaft3),
+};
+
+const int numUnitTubeTables = sizeof(unitTubeTables) / sizeof(unitTubeTables[0]);
+
+const UnitTubeTable* findUnitTube(GLuint numSegments, GLfloat thickness)
+{
+	for (int i = 0; i < numUnitTubeTables; i++)
+	{
+		if (unitTubeTables[i].numSegments == numSegments && unitTubeTables[i].thickness == thickness)
+			return &unitTubeTables[i];
+	}
+	return NULL;
+}
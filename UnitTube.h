@@ -0,0 +1,133 @@
+#ifndef UNITTUBE_H
+#define UNITTUBE_H
+
+#include "wrapper_glfw.h"
+#include "Tube.h"
+
+/* sin and cos that can be evaluated by the compiler, a Taylor series after bringing x into
+   -pi to pi. They are good to a few units in the last place of a double, well past float */
+constexpr double constexprSin(double x)
+{
+	const double pi = 3.14159265358979323846;
+	while (x > pi)
+		x -= 2 * pi;
+	while (x < -pi)
+		x += 2 * pi;
+
+	double term = x, sum = x;
+	for (int n = 1; n < 16; n++)
+	{
+		term *= -x * x / ((2 * n) * (2 * n + 1));
+		sum += term;
+	}
+	return sum;
+}
+
+constexpr double constexprCos(double x)
+{
+	return constexprSin(x + 3.14159265358979323846 / 2);
+}
+
+/* A unit tube worked out entirely at compile time, the same vertices generateTube makes and the
+   strip indices of Tube::makeStripIndices. Thickness is in thousandths since a template can't take
+   a float. A constexpr UnitTube is plain data in the executable, so a tube made from one only has
+   its vertices interleaved and uploaded */
+template <int Segments, int ThicknessPermille>
+struct UnitTube
+{
+	static constexpr int numSegments = Segments;
+	static constexpr int numVertices = 8 * Segments;
+	static constexpr int numIndices = numVertices + 8;
+
+	GLfloat thickness;
+	GLfloat positions[numVertices * 3];
+	GLfloat normals[numVertices * 3];
+	GLfloat colours[numVertices * 4];
+	GLushort indices[numIndices];
+
+	constexpr UnitTube() : thickness(ThicknessPermille / 1000.f), positions(), normals(), colours(), indices()
+	{
+		static_assert(Segments > 0 && numVertices <= 65536, "a unit tube has 16 bit indices");
+		static_assert(ThicknessPermille >= 0 && ThicknessPermille <= 1000, "thickness is from 0 to 1");
+
+		// the float steps of generateTube, with the trig done in double as sin(float) is on most compilers
+		float segmentAngleIncrement = (2 * 3.14159265358979f) / Segments;
+		float innerRadius = 0.5f - (thickness * 0.5f);
+
+		const int section = Segments * 2 * 3;
+		for (int i = 0; i < Segments; i++)
+		{
+			double sinAngle = constexprSin(segmentAngleIncrement * i);
+			double cosAngle = constexprCos(segmentAngleIncrement * i);
+
+			GLfloat outerX = (GLfloat)(0.5f * sinAngle), outerY = (GLfloat)(0.5f * cosAngle);
+			GLfloat innerX = (GLfloat)(innerRadius * sinAngle), innerY = (GLfloat)(innerRadius * cosAngle);
+
+			// top, bottom, outside and inside, as in generateTube
+			setPosition(i * 6, outerX, outerY, 0.5f);
+			setPosition(i * 6 + 3, innerX, innerY, 0.5f);
+			setPosition(section + i * 6, outerX, outerY, -0.5f);
+			setPosition(section + i * 6 + 3, innerX, innerY, -0.5f);
+			setPosition(section * 2 + i * 6, outerX, outerY, 0.5f);
+			setPosition(section * 2 + i * 6 + 3, outerX, outerY, -0.5f);
+			setPosition(section * 3 + i * 6, innerX, innerY, 0.5f);
+			setPosition(section * 3 + i * 6 + 3, innerX, innerY, -0.5f);
+		}
+
+		for (int i = 0; i < numVertices; i++)
+		{
+			bool disk = i < numVertices / 2;
+			normals[i * 3] = disk ? 0.f : positions[i * 3];
+			normals[i * 3 + 1] = disk ? 0.f : positions[i * 3 + 1];
+			normals[i * 3 + 2] = disk ? positions[i * 3 + 2] : 0.f;
+
+			colours[i * 4] = positions[i * 3];
+			colours[i * 4 + 1] = positions[i * 3 + 1];
+			colours[i * 4 + 2] = positions[i * 3 + 2];
+			colours[i * 4 + 3] = 1.f;
+		}
+
+		const int stripVertices = numVertices / 4;
+		for (int strip = 0; strip < 4; strip++)
+		{
+			for (int j = 0; j < stripVertices; j++)
+				indices[strip * (stripVertices + 2) + j] = (GLushort)(strip * stripVertices + j);
+			indices[strip * (stripVertices + 2) + stripVertices] = (GLushort)(strip * stripVertices);
+			indices[strip * (stripVertices + 2) + stripVertices + 1] = (GLushort)(strip * stripVertices + 1);
+		}
+	}
+
+private:
+	constexpr void setPosition(int offset, GLfloat x, GLfloat y, GLfloat z)
+	{
+		positions[offset] = x;
+		positions[offset + 1] = y;
+		positions[offset + 2] = z;
+	}
+};
+
+/* A compile time tube without its template parameters, so makeTube can look one up */
+struct UnitTubeTable
+{
+	GLuint numSegments;
+	GLfloat thickness;
+	const GLfloat* positions;
+	const GLfloat* normals;
+	const GLfloat* colours;
+	const GLushort* indices;
+};
+
+template <int Segments, int ThicknessPermille>
+constexpr UnitTubeTable unitTubeTable(const UnitTube<Segments, ThicknessPermille>& tube)
+{
+	return { (GLuint)Segments, tube.thickness, tube.positions, tube.normals, tube.colours, tube.indices };
+}
+
+/* The tubes built at compile time: every level of detail of the drone's arms and motors */
+extern const UnitTubeTable unitTubeTables[];
+extern const int numUnitTubeTables;
+
+// the compile time tube with these parameters, or NULL when it has to be generated
+const UnitTubeTable* findUnitTube(GLuint numSegments, GLfloat thickness);
+
+#endif
@@ -0,0 +1,155 @@
+#include "UploadRing.h"
+#include "RenderStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// glBufferStorage is GL 4.4, newer than the loaded functions, so it is looked up at run time
+typedef void (APIENTRY *BufferStorageFunction)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// std::min takes it by reference, so it needs a definition
+const int UploadRing::maxFrames;
+
+// glfwExtensionSupported needs a GLFW context, this works in any
+static bool extensionSupported(const char* name)
+{
+	GLint numExtensions = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &numExtensions);
+	for (GLint i = 0; i < numExtensions; i++)
+	{
+		if (std::strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), name) == 0)
+			return true;
+	}
+	return false;
+}
+
+UploadRing::UploadRing()
+{
+	bufferObject = 0;
+	frameSize = 0;
+	numFrames = 0;
+	frame = 0;
+	used = 0;
+	mapped = NULL;
+	for (int i = 0; i < maxFrames; i++)
+		fences[i] = 0;
+}
+
+UploadRing::~UploadRing()
+{}
+
+void UploadRing::create(GLsizeiptr frameSize, int numFrames, GLProcLookup getProcAddress)
+{
+	this->frameSize = frameSize;
+	this->numFrames = std::min(std::max(numFrames, 1), maxFrames);
+	GLsizeiptr size = frameSize * this->numFrames;
+
+	glGenBuffers(1, &bufferObject);
+	glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+
+	BufferStorageFunction bufferStorage = NULL;
+	if (extensionSupported("GL_ARB_buffer_storage"))
+		bufferStorage = (BufferStorageFunction)getProcAddress("glBufferStorage");
+
+	if (bufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		bufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+		mapped = (unsigned char*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+	}
+	if (!mapped)
+	{
+		glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+		std::cout << "upload ring: persistent mapping not available, mapping each write instead" << std::endl;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	// start on the last region so the first beginFrame moves to region 0
+	frame = this->numFrames - 1;
+	used = 0;
+}
+
+bool UploadRing::isPersistent() const
+{
+	return mapped != NULL;
+}
+
+void UploadRing::beginFrame()
+{
+	frame = (frame + 1) % numFrames;
+	used = 0;
+
+	GLsync& fence = fences[frame];
+	if (!fence)
+		return;
+
+	// normally the GPU finished this region two frames ago and the first check returns at once
+	std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+	GLenum result = glClientWaitSync(fence, 0, 0);
+	if (result == GL_TIMEOUT_EXPIRED)
+	{
+		renderStats.fenceWaits++;
+		do
+		{
+			result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		} while (result == GL_TIMEOUT_EXPIRED);
+	}
+	renderStats.fenceWaitTime += std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+	glDeleteSync(fence);
+	fence = 0;
+	renderStats.partSetupCalls += 2;
+}
+
+void UploadRing::endFrame()
+{
+	if (used == 0)
+		return;
+	fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	renderStats.partSetupCalls++;
+}
+
+GLintptr UploadRing::write(const void* data, GLsizeiptr size, GLsizeiptr alignment)
+{
+	// aligned within the whole buffer, as the offset is what the attribute or uniform binding sees
+	GLintptr regionStart = frame * frameSize;
+	GLintptr offset = (regionStart + used + alignment - 1) / alignment * alignment;
+	if (offset + size > regionStart + frameSize)
+	{
+		renderStats.ringOverflows++;
+		return -1;
+	}
+
+	if (mapped)
+	{
+		std::memcpy(mapped + offset, data, size);
+	}
+	else
+	{
+		// the fence on this region has already been waited on, so nothing the GPU reads is overwritten
+		GLint previousBuffer;
+		glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &previousBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, bufferObject);
+		void* range = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+		if (range)
+		{
+			std::memcpy(range, data, size);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, previousBuffer);
+		renderStats.partSetupCalls += 5;
+		if (!range)
+			return -1;
+	}
+
+	used = offset + size - regionStart;
+	renderStats.bytesStreamed += (unsigned int)size;
+	return offset;
+}
@@ -0,0 +1,53 @@
+#ifndef UPLOADRING_H
+#define UPLOADRING_H
+
+#include "wrapper_glfw.h"
+
+// finds a GL function in the current context, glfwGetProcAddress or HeadlessContext::getProcAddress
+typedef GLFWglproc (*GLProcLookup)(const char* name);
+
+/* A streaming buffer for the data that changes every frame, the instance transforms and the
+   uniform blocks. The buffer is split into one region for each frame in flight; the CPU writes
+   a frame's data into its region while the GPU is still reading the regions of the frames before.
+   Each region is fenced when its frame is submitted, and only waited on when the ring comes back
+   round to it, so normally nothing stalls.
+   With GL_ARB_buffer_storage the whole buffer is mapped once, persistently and coherently, and
+   writes are plain copies. Without it every write maps its range unsynchronized, which the fences
+   make safe just the same */
+class UploadRing
+{
+public:
+	UploadRing();
+	~UploadRing();
+
+	/* frameSize bytes for each of numFrames frames. glBufferStorage is looked up with the
+	   function of whatever made the context */
+	void create(GLsizeiptr frameSize, int numFrames, GLProcLookup getProcAddress);
+
+	/* Moves on to the next frame's region, first waiting for the GPU to finish the frame that
+	   last used it. The time spent waiting is added to renderStats */
+	void beginFrame();
+
+	// fences the frame's region once everything using it has been submitted
+	void endFrame();
+
+	/* Copies data into this frame's region at an offset that is a multiple of alignment, which
+	   doesn't have to be a power of two. Returns the offset in the buffer, or -1 when the region is full */
+	GLintptr write(const void* data, GLsizeiptr size, GLsizeiptr alignment);
+
+	bool isPersistent() const;
+
+	GLuint bufferObject;
+	GLsizeiptr frameSize;
+	int numFrames;
+
+private:
+	static const int maxFrames = 4;
+
+	GLsync fences[maxFrames];
+	int frame;				// the region being written
+	GLsizeiptr used;		// bytes written to it so far
+	unsigned char* mapped;	// the whole buffer when persistently mapped, otherwise NULL
+};
+
+#endif
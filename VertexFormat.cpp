@@ -0,0 +1,142 @@
+#include "VertexFormat.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+GLsizei VertexFormat::stride() const
+{
+	return normalOffset() + 4 + (colours ? 4 : 0);
+}
+
+GLsizei VertexFormat::normalOffset() const
+{
+	return halfPositions ? 8 : 12;
+}
+
+GLsizei VertexFormat::colourOffset() const
+{
+	return normalOffset() + 4;
+}
+
+/* 10 bits signed for each of x, y and z, with x in the lowest bits. w is left at 0 */
+GLuint packNormal(float x, float y, float z)
+{
+	float length = std::sqrt(x * x + y * y + z * z);
+	if (length > 0.f)
+	{
+		x /= length;
+		y /= length;
+		z /= length;
+	}
+
+	float components[3] = { x, y, z };
+	GLuint packed = 0;
+	for (int i = 0; i < 3; i++)
+	{
+		int value = (int)std::lround(std::min(std::max(components[i], -1.f), 1.f) * 511.f);
+		packed |= ((GLuint)value & 0x3ff) << (i * 10);
+	}
+	return packed;
+}
+
+/* Rounds to the nearest half float. Values too small for a normal half are flushed to zero
+   and values too large become infinity, neither of which happen with the unit meshes */
+GLushort floatToHalf(float value)
+{
+	GLuint bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+
+	GLuint sign = (bits >> 16) & 0x8000;
+	int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	GLuint mantissa = bits & 0x7fffff;
+
+	if (exponent <= 0)
+		return (GLushort)sign;
+	if (exponent >= 31)
+		return (GLushort)(sign | 0x7c00);
+
+	// round to nearest, a carry out of the mantissa correctly moves up the exponent
+	GLuint half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+		half++;
+	return (GLushort)half;
+}
+
+float halfToFloat(GLushort half)
+{
+	GLuint sign = (GLuint)(half & 0x8000) << 16;
+	GLuint exponent = (half >> 10) & 0x1f;
+	GLuint mantissa = half & 0x3ff;
+
+	GLuint bits = sign;
+	if (exponent == 31)
+		bits |= 0x7f800000 | (mantissa << 13);
+	else if (exponent != 0)
+		bits |= ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+	float value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+void interleaveVertices(const VertexFormat& format, const GLfloat* positions, const GLfloat* normals, const GLfloat* colours,
+	int numVertices, std::vector<unsigned char>& out)
+{
+	GLsizei stride = format.stride();
+	out.assign((size_t)stride * numVertices, 0);
+
+	for (int i = 0; i < numVertices; i++)
+	{
+		unsigned char* vertex = &out[(size_t)i * stride];
+
+		if (format.halfPositions)
+		{
+			GLushort position[4] = { floatToHalf(positions[i * 3]), floatToHalf(positions[i * 3 + 1]), floatToHalf(positions[i * 3 + 2]), floatToHalf(1.f) };
+			std::memcpy(vertex, position, sizeof(position));
+		}
+		else
+		{
+			std::memcpy(vertex, &positions[i * 3], sizeof(GLfloat) * 3);
+		}
+
+		GLuint normal = packNormal(normals[i * 3], normals[i * 3 + 1], normals[i * 3 + 2]);
+		std::memcpy(vertex + format.normalOffset(), &normal, sizeof(normal));
+
+		if (format.colours)
+		{
+			for (int c = 0; c < 4; c++)
+				vertex[format.colourOffset() + c] = (unsigned char)std::lround(std::min(std::max(colours[i * 4 + c], 0.f), 1.f) * 255.f);
+		}
+	}
+}
+
+int setVertexAttributes(const VertexFormat& format, GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute)
+{
+	GLsizei stride = format.stride();
+	int calls = 0;
+
+	glEnableVertexAttribArray(positionAttribute);
+	if (format.halfPositions)
+		glVertexAttribPointer(positionAttribute, 4, GL_HALF_FLOAT, GL_FALSE, stride, 0);
+	else
+		glVertexAttribPointer(positionAttribute, 3, GL_FLOAT, GL_FALSE, stride, 0);
+	calls += 2;
+
+	glEnableVertexAttribArray(normalAttribute);
+	glVertexAttribPointer(normalAttribute, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, (void*)(size_t)format.normalOffset());
+	calls += 2;
+
+	if (format.colours)
+	{
+		glEnableVertexAttribArray(colourAttribute);
+		glVertexAttribPointer(colourAttribute, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)(size_t)format.colourOffset());
+		calls += 2;
+	}
+	else
+	{
+		glDisableVertexAttribArray(colourAttribute);
+		calls++;
+	}
+	return calls;
+}
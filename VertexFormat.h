@@ -0,0 +1,41 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include "wrapper_glfw.h"
+#include <vector>
+
+/* Layout of an interleaved mesh vertex. Each vertex holds, in order:
+	position	3 floats, or 4 half floats (w = 1) with halfPositions
+	normal		GL_INT_2_10_10_10_REV, normalised
+	colour		4 normalised unsigned bytes, left out without colours
+   With colours off the colour attribute is disabled and the shader gets the constant
+   attribute value, which is fine as long as colourMode is 1 */
+struct VertexFormat
+{
+	bool halfPositions;
+	bool colours;
+
+	GLsizei stride() const;
+	GLsizei normalOffset() const;
+	GLsizei colourOffset() const;
+};
+
+// float positions with colours, the same values as the old separate buffers held
+const VertexFormat fullVertexFormat = { false, true };
+
+// half positions and no colours, 12 bytes a vertex rather than 40
+const VertexFormat compactVertexFormat = { true, false };
+
+GLuint packNormal(float x, float y, float z);
+GLushort floatToHalf(float value);
+float halfToFloat(GLushort half);
+
+/* Interleaves separate position (3 floats), normal (3 floats) and colour (4 floats) arrays
+   into the format's layout. The normals are normalised before they are packed */
+void interleaveVertices(const VertexFormat& format, const GLfloat* positions, const GLfloat* normals, const GLfloat* colours,
+	int numVertices, std::vector<unsigned char>& out);
+
+// points the attributes at the interleaved vertices in the bound GL_ARRAY_BUFFER, returns the number of GL calls made
+int setVertexAttributes(const VertexFormat& format, GLuint positionAttribute, GLuint normalAttribute, GLuint colourAttribute);
+
+#endif
@@ -0,0 +1,10 @@
+/* The benchmarks on their own, the same as running the program with --bench.
+   Each argument is a benchmark name, with none they all run */
+
+#include "wrapper_glfw.h"
+#include "Benchmarks.h"
+
+int main(int argc, char* argv[])
+{
+	return runBenchmarks(argc - 1, argv + 1);
+}
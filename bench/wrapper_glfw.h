@@ -0,0 +1,13 @@
+#ifndef BENCH_WRAPPER_GLFW_H
+#define BENCH_WRAPPER_GLFW_H
+
+/* Stands in for common/wrapper_glfw.h in the benchmark build, which runs without a window.
+   The benchmarks never call OpenGL, the prototypes only have to link against the system's GL
+   library, so this needs one that exports the core functions (Mesa's libGL does) */
+#define GL_GLEXT_PROTOTYPES 1
+#include <GL/glcorearb.h>
+
+// UploadRing.h names the type of GL function lookups with it
+typedef void (*GLFWglproc)(void);
+
+#endif
@@ -4,6 +4,8 @@
 */
 
 #include "cubev2.h"
+#include "RenderStats.h"
+#include "MeshOptimizer.h"
 
 /* I don't like using namespaces in header files but have less issues with them in
 seperate cpp files */
@@ -18,6 +20,8 @@ Cubev2::Cubev2()
 	attribute_v_colours = 1;
 	attribute_v_normal = 2;
 	numvertices = 12;
+	indexed = false;
+	useVertexArray = true;
 }
 
 
@@ -26,160 +30,216 @@ Cubev2::~Cubev2()
 }
 
 
-/* Make a cube from hard-coded vertex positions and normals  */
-void Cubev2::makeCube()
+/* Define vertices for a cube in 12 triangles */
+static const GLfloat cubePositions[] =
 {
-	/* Define vertices for a cube in 12 triangles */
-	GLfloat vertexPositions[] =
+	-0.5f, 0.5f, -0.5f,
+	-0.5f, -0.5f, -0.5f,
+	0.5f, -0.5f, -0.5f,
+
+	0.5f, -0.5f, -0.5f,
+	0.5f, 0.5f, -0.5f,
+	-0.5f, 0.5f, -0.5f,
+
+	0.5f, -0.5f, -0.5f,
+	0.5f, -0.5f, 0.5f,
+	0.5f, 0.5f, -0.5f,
+
+	0.5f, -0.5f, 0.5f,
+	0.5f, 0.5f, 0.5f,
+	0.5f, 0.5f, -0.5f,
+
+	0.5f, -0.5f, 0.5f,
+	-0.5f, -0.5f, 0.5f,
+	0.5f, 0.5f, 0.5f,
+
+	-0.5f, -0.5f, 0.5f,
+	-0.5f, 0.5f, 0.5f,
+	0.5f, 0.5f, 0.5f,
+
+	-0.5f, -0.5f, 0.5f,
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, 0.5f, 0.5f,
+
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, 0.5f, -0.5f,
+	-0.5f, 0.5f, 0.5f,
+
+	-0.5f, -0.5f, 0.5f,
+	0.5f, -0.5f, 0.5f,
+	0.5f, -0.5f, -0.5f,
+
+	0.5f, -0.5f, -0.5f,
+	-0.5f, -0.5f, -0.5f,
+	-0.5f, -0.5f, 0.5f,
+
+	-0.5f, 0.5f, -0.5f,
+	0.5f, 0.5f, -0.5f,
+	0.5f, 0.5f, 0.5f,
+
+	0.5f, 0.5f, 0.5f,
+	-0.5f, 0.5f, 0.5f,
+	-0.5f, 0.5f, -0.5f,
+};
+
+/* Manually specified colours for our cube */
+static const GLfloat cubeColours[] = {
+	0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,
+	0.0f, 0.0f, 1.0f, 1.0f,
+
+	0.0f, 1.0f, 0.0f, 1.0f,
+	0.0f, 1.0f, 0.0f, 1.0f,
+	0.0f, 1.0f, 0.0f, 1.0f,
+	0.0f, 1.0f, 0.0f, 1.0f,
+	0.0f, 1.0f, 0.0f, 1.0f,
+	0.0f, 1.0f, 0.0f, 1.0f,
+
+	1.0f, 1.0f, 0.0f, 1.0f,
+	1.0f, 1.0f, 0.0f, 1.0f,
+	1.0f, 1.0f, 0.0f, 1.0f,
+	1.0f, 1.0f, 0.0f, 1.0f,
+	1.0f, 1.0f, 0.0f, 1.0f,
+	1.0f, 1.0f, 0.0f, 1.0f,
+
+	1.0f, 0.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 0.0f, 1.0f,
+	1.0f, 0.0f, 0.0f, 1.0f,
+
+	1.0f, 0.0f, 1.0f, 1.0f,
+	1.0f, 0.0f, 1.0f, 1.0f,
+	1.0f, 0.0f, 1.0f, 1.0f,
+	1.0f, 0.0f, 1.0f, 1.0f,
+	1.0f, 0.0f, 1.0f, 1.0f,
+	1.0f, 0.0f, 1.0f, 1.0f,
+
+	0.0f, 1.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f, 1.0f,
+	0.0f, 1.0f, 1.0f, 1.0f,
+};
+
+/* Manually specified normals for our cube */
+static const GLfloat cubeNormals[] =
+{
+	0, 0, -1.f, 0, 0, -1.f, 0, 0, -1.f,
+	0, 0, -1.f, 0, 0, -1.f, 0, 0, -1.f,
+	1.f, 0, 0, 1.f, 0, 0, 1.f, 0, 0,
+	1.f, 0, 0, 1.f, 0, 0, 1.f, 0, 0,
+	0, 0, 1.f, 0, 0, 1.f, 0, 0, 1.f,
+	0, 0, 1.f, 0, 0, 1.f, 0, 0, 1.f,
+	-1.f, 0, 0, -1.f, 0, 0, -1.f, 0, 0,
+	-1.f, 0, 0, -1.f, 0, 0, -1.f, 0, 0,
+	0, -1.f, 0, 0, -1.f, 0, 0, -1.f, 0,
+	0, -1.f, 0, 0, -1.f, 0, 0, -1.f, 0,
+	0, 1.f, 0, 0, 1.f, 0, 0, 1.f, 0,
+	0, 1.f, 0, 0, 1.f, 0, 0, 1.f, 0,
+};
+
+
+/* The 24 distinct vertices of the cube, four for each face, and the indices of its
+   12 triangles in vertex cache order */
+void Cubev2::makeIndexedCube(std::vector<GLfloat>& positions, std::vector<GLfloat>& normals, std::vector<GLfloat>& colours,
+	std::vector<GLushort>& indices)
+{
+	positions.assign(cubePositions, cubePositions + 12 * 9);
+	normals.assign(cubeNormals, cubeNormals + 12 * 9);
+	colours.assign(cubeColours, cubeColours + 12 * 12);
+
+	std::vector<GLuint> uniqueIndices;
+	deduplicateVertices(positions, normals, colours, uniqueIndices);
+	indices.assign(uniqueIndices.begin(), uniqueIndices.end());
+	optimizeVertexCache(indices, (int)positions.size() / 3);
+}
+
+
+/* Make a cube from hard-coded vertex positions and normals. The indexed cube shares the
+   vertices of each face between its two triangles */
+void Cubev2::makeCube(const VertexFormat& format, bool indexed, MeshCache* cache)
+{
+	this->indexed = indexed;
+
+	// every cube in the same format is the same, so they can all share one set of buffers
+	MeshKey key = { GENERATOR_CUBE, { 0, 0 }, format.halfPositions, format.colours, indexed };
+	if (cache)
 	{
-		-0.5f, 0.5f, -0.5f,
-		-0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, -0.5f,
-
-		0.5f, -0.5f, -0.5f,
-		0.5f, 0.5f, -0.5f,
-		-0.5f, 0.5f, -0.5f,
-
-		0.5f, -0.5f, -0.5f,
-		0.5f, -0.5f, 0.5f,
-		0.5f, 0.5f, -0.5f,
-
-		0.5f, -0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-		0.5f, 0.5f, -0.5f,
-
-		0.5f, -0.5f, 0.5f,
-		-0.5f, -0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-
-		-0.5f, -0.5f, 0.5f,
-		-0.5f, 0.5f, 0.5f,
-		0.5f, 0.5f, 0.5f,
-
-		-0.5f, -0.5f, 0.5f,
-		-0.5f, -0.5f, -0.5f,
-		-0.5f, 0.5f, 0.5f,
-
-		-0.5f, -0.5f, -0.5f,
-		-0.5f, 0.5f, -0.5f,
-		-0.5f, 0.5f, 0.5f,
-
-		-0.5f, -0.5f, 0.5f,
-		0.5f, -0.5f, 0.5f,
-		0.5f, -0.5f, -0.5f,
-
-		0.5f, -0.5f, -0.5f,
-		-0.5f, -0.5f, -0.5f,
-		-0.5f, -0.5f, 0.5f,
-
-		-0.5f, 0.5f, -0.5f,
-		0.5f, 0.5f, -0.5f,
-		0.5f, 0.5f, 0.5f,
-
-		0.5f, 0.5f, 0.5f,
-		-0.5f, 0.5f, 0.5f,
-		-0.5f, 0.5f, -0.5f,
-	};
-
-	/* Manually specified colours for our cube */
-	float vertexColours[] = {
-		0.0f, 0.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 1.0f, 1.0f,
-		0.0f, 0.0f, 1.0f, 1.0f,
-
-		0.0f, 1.0f, 0.0f, 1.0f,
-		0.0f, 1.0f, 0.0f, 1.0f,
-		0.0f, 1.0f, 0.0f, 1.0f,
-		0.0f, 1.0f, 0.0f, 1.0f,
-		0.0f, 1.0f, 0.0f, 1.0f,
-		0.0f, 1.0f, 0.0f, 1.0f,
-
-		1.0f, 1.0f, 0.0f, 1.0f,
-		1.0f, 1.0f, 0.0f, 1.0f,
-		1.0f, 1.0f, 0.0f, 1.0f,
-		1.0f, 1.0f, 0.0f, 1.0f,
-		1.0f, 1.0f, 0.0f, 1.0f,
-		1.0f, 1.0f, 0.0f, 1.0f,
-
-		1.0f, 0.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 0.0f, 1.0f,
-		1.0f, 0.0f, 0.0f, 1.0f,
-
-		1.0f, 0.0f, 1.0f, 1.0f,
-		1.0f, 0.0f, 1.0f, 1.0f,
-		1.0f, 0.0f, 1.0f, 1.0f,
-		1.0f, 0.0f, 1.0f, 1.0f,
-		1.0f, 0.0f, 1.0f, 1.0f,
-		1.0f, 0.0f, 1.0f, 1.0f,
-
-		0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f, 1.0f,
-		0.0f, 1.0f, 1.0f, 1.0f,
-	};
-
-	/* Manually specified normals for our cube */
-	GLfloat normals[] =
+		buffers = cache->find(key);
+		if (buffers)
+		{
+			boundsMin = buffers->boundsMin;
+			boundsMax = buffers->boundsMax;
+			return;
+		}
+	}
+
+	// bounding box of the vertices, used for culling
+	boundsMin = boundsMax = glm::vec3(cubePositions[0], cubePositions[1], cubePositions[2]);
+	for (int i = 0; i < numvertices * 3; i++)
 	{
-		0, 0, -1.f, 0, 0, -1.f, 0, 0, -1.f,
-		0, 0, -1.f, 0, 0, -1.f, 0, 0, -1.f,
-		1.f, 0, 0, 1.f, 0, 0, 1.f, 0, 0,
-		1.f, 0, 0, 1.f, 0, 0, 1.f, 0, 0,
-		0, 0, 1.f, 0, 0, 1.f, 0, 0, 1.f,
-		0, 0, 1.f, 0, 0, 1.f, 0, 0, 1.f,
-		-1.f, 0, 0, -1.f, 0, 0, -1.f, 0, 0,
-		-1.f, 0, 0, -1.f, 0, 0, -1.f, 0, 0,
-		0, -1.f, 0, 0, -1.f, 0, 0, -1.f, 0,
-		0, -1.f, 0, 0, -1.f, 0, 0, -1.f, 0,
-		0, 1.f, 0, 0, 1.f, 0, 0, 1.f, 0,
-		0, 1.f, 0, 0, 1.f, 0, 0, 1.f, 0,
-	};
-
-	/* Create the vertex buffer for the cube */
-	glGenBuffers(1, &positionBufferObject);
-	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexPositions), vertexPositions, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	/* Create the colours buffer for the cube */
-	glGenBuffers(1, &colourObject);
-	glBindBuffer(GL_ARRAY_BUFFER, colourObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(vertexColours), vertexColours, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-	/* Create the normals  buffer for the cube */
-	glGenBuffers(1, &normalsBufferObject);
-	glBindBuffer(GL_ARRAY_BUFFER, normalsBufferObject);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(normals), normals, GL_STATIC_DRAW);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
+		glm::vec3 position(cubePositions[i * 3], cubePositions[i * 3 + 1], cubePositions[i * 3 + 2]);
+		boundsMin = glm::min(boundsMin, position);
+		boundsMax = glm::max(boundsMax, position);
+	}
+
+	/* Interleave the vertices, the unindexed cube has no element buffer */
+	std::vector<unsigned char> vertices;
+	std::vector<GLuint> indices;
+	if (indexed)
+	{
+		std::vector<GLfloat> positions, normals, colours;
+		std::vector<GLushort> shortIndices;
+		makeIndexedCube(positions, normals, colours, shortIndices);
+		interleaveVertices(format, &positions[0], &normals[0], &colours[0], (int)positions.size() / 3, vertices);
+		indices.assign(shortIndices.begin(), shortIndices.end());
+	}
+	else
+	{
+		interleaveVertices(format, cubePositions, cubeNormals, cubeColours, numvertices * 3, vertices);
+	}
+
+	buffers = createMeshBuffers(format, vertices, indices, cache ? cache->arena : NULL, attribute_v_coord, attribute_v_normal, attribute_v_colours);
+	buffers->boundsMin = boundsMin;
+	buffers->boundsMax = boundsMax;
+	if (cache)
+		cache->insert(key, buffers);
 }
 
 
-/* Draw the cube by bining the VBOs and drawing triangles */
-void Cubev2::drawCube(int drawmode)
+/* Point the vertex attributes at the cube's vertex buffer in the currently bound vertex array object,
+   returns the number of GL calls made */
+int Cubev2::specifyAttributes()
 {
-	/* Bind cube vertices. Note that this is in attribute index attribute_v_coord */
-	glBindBuffer(GL_ARRAY_BUFFER, positionBufferObject);
-	glEnableVertexAttribArray(attribute_v_coord);
-	glVertexAttribPointer(attribute_v_coord, 3, GL_FLOAT, GL_FALSE, 0, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, buffers->vertexBuffer);
+	int calls = 1 + setVertexAttributes(buffers->format, attribute_v_coord, attribute_v_normal, attribute_v_colours);
+	if (indexed)
+	{
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers->elementBuffer);
+		calls++;
+	}
+	return calls;
+}
 
-	/* Bind cube colours. Note that this is in attribute index attribute_v_colours */
-	glBindBuffer(GL_ARRAY_BUFFER, colourObject);
-	glEnableVertexAttribArray(attribute_v_colours);
-	glVertexAttribPointer(attribute_v_colours, 4, GL_FLOAT, GL_FALSE, 0, 0);
 
-	/* Bind cube normals. Note that this is in attribute index attribute_v_normal */
-	glEnableVertexAttribArray(attribute_v_normal);
-	glBindBuffer(GL_ARRAY_BUFFER, normalsBufferObject);
-	glVertexAttribPointer(attribute_v_normal, 3, GL_FLOAT, GL_FALSE, 0, 0);
+/* Bind the cube's vertex array object, or specify the attributes again if that is switched
+   off, and set the polygon mode */
+void Cubev2::bindCube(int drawmode)
+{
+	if (useVertexArray)
+	{
+		bindVertexArray(buffers->vertexArray);
+	}
+	else
+	{
+		renderStats.partSetupCalls += specifyAttributes();
+	}
 
 	glPointSize(3.f);
 
@@ -188,14 +248,66 @@ void Cubev2::drawCube(int drawmode)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 	else
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+	renderStats.partSetupCalls += 2;	// point size and polygon mode
+}
+
+
+/* Draw the cube by bining the VBOs and drawing triangles */
+void Cubev2::drawCube(int drawmode)
+{
+	bindCube(drawmode);
+	drawCubeBound(drawmode);
+}
+
 
+/* Draw the cube using the VBOs bound by bindCube */
+void Cubev2::drawCubeBound(int drawmode)
+{
 	// Draw points
 	if (drawmode == 2)
 	{
-		glDrawArrays(GL_POINTS, 0, numvertices * 3);
+		glDrawArrays(GL_POINTS, buffers->baseVertex, buffers->numVertices);
+	}
+	else if (indexed)
+	{
+		glDrawElementsBaseVertex(GL_TRIANGLES, buffers->numIndices, buffers->indexType, (GLvoid*)buffers->indexOffset, buffers->baseVertex);
 	}
 	else // Draw the cube in triangles
 	{
 		glDrawArrays(GL_TRIANGLES, 0, numvertices * 3);
 	}
+	renderStats.drawCalls++;
+	renderStats.instancesDrawn++;
+	renderStats.trianglesDrawn += numvertices;
+}
+
+
+/* Draw every queued instance of the cube in a single draw call and empty the queue */
+void Cubev2::drawCubeInstanced(int drawmode)
+{
+	GLsizei numInstances = instances.numInstances();
+	if (numInstances == 0)
+		return;
+
+	bindCube(drawmode);
+	instances.bindInstances();
+
+	if (drawmode == 2)
+	{
+		glDrawArraysInstanced(GL_POINTS, buffers->baseVertex, buffers->numVertices, numInstances);
+	}
+	else if (indexed)
+	{
+		glDrawElementsInstancedBaseVertex(GL_TRIANGLES, buffers->numIndices, buffers->indexType, (GLvoid*)buffers->indexOffset, numInstances, buffers->baseVertex);
+	}
+	else
+	{
+		glDrawArraysInstanced(GL_TRIANGLES, 0, numvertices * 3, numInstances);
+	}
+	renderStats.drawCalls++;
+	renderStats.instancesDrawn += numInstances;
+	renderStats.trianglesDrawn += numvertices * numInstances;
+
+	instances.unbindInstances();
+	instances.clear();
 }
\ No newline at end of file
@@ -8,6 +8,9 @@ Iain Martin November 2018
 #include "wrapper_glfw.h"
 #include <vector>
 #include <glm/glm.hpp>
+#include "InstanceBuffer.h"
+#include "VertexFormat.h"
+#include "MeshBuffers.h"
 
 class Cubev2
 {
@@ -15,18 +18,42 @@ public:
 	Cubev2();
 	~Cubev2();
 
-	void makeCube();
+	/* the vertices are interleaved in the given format, see VertexFormat.h. The indexed cube has
+	   24 vertices and 16 bit indices rather than 36 vertices drawn in order. With a cache, cubes
+	   made in the same format share their buffers */
+	void makeCube(const VertexFormat& format = fullVertexFormat, bool indexed = true, MeshCache* cache = NULL);
+
+	// the indexed cube's vertices and its indices in vertex cache order, without creating any buffers
+	static void makeIndexedCube(std::vector<GLfloat>& positions, std::vector<GLfloat>& normals, std::vector<GLfloat>& colours,
+		std::vector<GLushort>& indices);
 	void drawCube(int drawmode);
+	void drawCubeInstanced(int drawmode);
+
+	/* drawCube split in two, so a run of cubes only binds the buffers once.
+	   drawCubeBound draws with whatever bindCube last set up */
+	void bindCube(int drawmode);
+	void drawCubeBound(int drawmode);
 
-	// Define vertex buffer object names (e.g as globals)
-	GLuint positionBufferObject;
-	GLuint colourObject;
-	GLuint normalsBufferObject;
+	// the interleaved vertices, indices and vertex array object, possibly shared with other cubes
+	std::shared_ptr<MeshBuffers> buffers;
+	bool indexed;
 
 	GLuint attribute_v_coord;
 	GLuint attribute_v_normal;
 	GLuint attribute_v_colours;
 
-	int numvertices;
+	/* Draw from the vertex array object holding the attribute layout. With useVertexArray off
+	   the attributes are specified again on every bind instead */
+	bool useVertexArray;
+
+	int numvertices;		// the number of triangles
+
+	// object space bounding box, set by makeCube
+	glm::vec3 boundsMin, boundsMax;
+
+	// instances queued for the next drawCubeInstanced call
+	InstanceBuffer instances;
 
+private:
+	int specifyAttributes();
 };
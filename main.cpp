@@ -1,6 +1,7 @@
 
 /* Link to static libraries, could define these as linker inputs in the project settings instead
-if you prefer */
+if you prefer. Other compilers get them from the CMake build */
+#ifdef _MSC_VER
 #ifdef _DEBUG
 #pragma comment(lib, "glfw3D.lib")
 #pragma comment(lib, "glloadD.lib")
@@ -9,12 +10,21 @@ if you prefer */
 #pragma comment(lib, "glload.lib")
 #endif
 #pragma comment(lib, "opengl32.lib")
+#endif
 
 /* Include the header to the GLFW wrapper class which
    also includes the OpenGL extension initialisation*/
 #include "wrapper_glfw.h"
 #include <iostream>
-#include <stack>
+#include <thread>
+#include <algorithm>
+#include <functional>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 
    /* Include GLM core and matrix extensions*/
 #include <glm/glm.hpp>
@@ -24,7 +34,27 @@ if you prefer */
 // Include headers for our objects
 #include "sphere.h"
 #include "cubev2.h"
-#include "tube.h"
+#include "Tube.h"
+#include "RenderStats.h"
+#include "SceneGraph.h"
+#include "Drone.h"
+#include "TransformSoA.h"
+#include "UniformBuffers.h"
+#include "ClusteredLights.h"
+#include "ShadowCascades.h"
+#include "FrustumCulling.h"
+#include "RenderQueue.h"
+#include "MeshBuffers.h"
+#include "MeshLod.h"
+#include "UploadRing.h"
+#include "Swarm.h"
+#include "JobSystem.h"
+#include "FixedTimestep.h"
+#include "Headless.h"
+#include "Profiler.h"
+#include "InputLog.h"
+#include "FrameTimings.h"
+#include "Benchmarks.h"
 
 /* Define buffer object indices */
 GLuint elementbuffer;
@@ -36,9 +66,17 @@ GLuint vao;			/* Vertex array (Containor) object. This is the index of the VAO t
 
 // globals for shadow mapping
 GLuint shadowProgram;	// shader program for shadow rendering
-GLuint depthMapFBO; // depth map for shadows
-GLuint depthMap; // idx for texture for shadow map
-const unsigned int SHADOW_WIDTH = 4096, SHADOW_HEIGHT = 4096;
+ShadowCascades shadowCascades; // depth maps for shadows, each covering part of the view
+const int numShadowCascades = 3, shadowMapSize = 1024;
+bool shadowCacheMode; // keep the static casters' depth between frames
+
+// which nodes render() draws, the shadow cache draws the static and dynamic ones separately
+enum DrawFilter
+{
+	DRAW_ALL,
+	DRAW_STATIC,
+	DRAW_DYNAMIC
+};
 GLuint shadowsModelID, shadowsLightSpaceMatrixID;
 
 GLuint colourmode;	/* Index of a uniform to switch the colour mode in the vertex shader
@@ -63,38 +101,170 @@ GLfloat moveX, moveY, moveZ;
 
 
 /* Uniforms*/
-GLuint modelID, viewID, projectionID, normalMatrixID, viewPosID;
-GLuint colourModeID, emitModeID, attenuationModeID;
-GLuint colourOverrideID, reflectivenessID, numLightsID;
-GLuint lightSpaceMatrixID, shadowMapID;
-
-const int maxNumLights = 10;
-GLuint lightPosID[maxNumLights];
-GLuint lightColourID[maxNumLights];
-GLuint lightModeID[maxNumLights];
-int numLights;
+GLuint modelID, normalMatrixID, viewPosID;
+GLuint emitModeID;
+GLuint colourOverrideID, reflectivenessID;
+GLuint shadowMapID;
+
+/* Camera and light uniforms shared by the whole frame, each sent in a single upload */
+FrameUniforms frameUniforms;
+UniformBuffer frameBuffer;
+LightBuffer lightBuffer;
+
+/* The instances and uniform blocks are streamed through a persistently mapped ring, three frames
+   deep, instead of a glBufferData or glBufferSubData call for each one */
+UploadRing uploadRing;
+bool uploadRingMode;
+const GLsizeiptr uploadRingFrameSize = 8 * 1024 * 1024;
+
+// globals for clustered lighting, where the drone lights are binned into clusters instead of
+// every fragment looping over all of them
+bool clusteredMode;
+LightClusters lightClusters;
+std::vector<ClusterLight> clusterLights;
+const size_t maxClusterLights = 512;	// nearest drone lights kept in clustered mode
+GLuint clusterGridID, clusterLightIndicesID, clusterLightsID;
 
 int controlMode;
 
+// globals for instanced rendering and draw call reporting
+bool instancedMode;
+bool vertexArrayMode;	// each mesh draws from its own vertex array object, rather than specifying its attributes every time
+GLuint instancedID, shadowsInstancedID;	// 1 only while the instanced draws are made, the other draws use the model uniforms
+bool showRenderStats;
+unsigned int statsFrames, statsDrawCalls, statsInstances, statsShadowCached, statsCulled;
+unsigned int statsBinds, statsBindsSkipped, statsUploads, statsUploadsSkipped, statsPartSetupCalls, statsTriangles;
+unsigned int statsBytesStreamed, statsFenceWaits;
+float statsFenceWaitTime;
+
 
 GLfloat aspect_ratio;		/* Aspect ratio of the window defined in the reshape callback*/
 int windowWidth, windowHeight;
 GLuint numspherevertices;
 
-/* Global instances of our objects */
-Tube tube;
-Tube motorBell, motorStator, motorShaft;
+/* Global instances of our objects. The tubes and the sphere have a chain of levels of
+   detail, level 0 being the finest */
+Tube tube[maxLods];
+Tube motorBell[maxLods], motorStator[maxLods], motorShaft[maxLods];
 Cubev2 cube;
-Sphere sphere;
+Sphere sphere[maxLods];
+const int sphereRings = 20;
+
+/* The scene graph holding the drone and the ground plane */
+SceneGraph scene;
+DroneNodes drone;
+int groundPlaneNode;
+
+/* Swarm mode. The flight state of every drone is kept in the swarm's table, drone 0 is the one
+   flown with the controls and the rest fly themselves. Only the first maxDrawnDrones have nodes
+   in the scene graph, the rest are simulated but not drawn */
+DroneSwarm swarm;
+std::vector<DroneNodes> swarmDrones;	// swarmDrones[0] is drone
+std::vector<int> nodeDrone;				// the drone each scene node belongs to, -1 for the ground
+const int swarmSizes[] = { 1, 1000, 10000, 100000 };
+int swarmSizeIndex;
+const int maxDrawnDrones = 10000;
+const float swarmDroneScale = 0.3f;
+
+// the swarm is flown and posed in chunks spread over every core, or just the render thread with it off
+JobSystem jobs;
+bool multithreadedMode;
+
+/* The drones, the camera turning and the props of the view mode drone move in fixed ticks of
+   1/60 of a second whatever the frame rate, and are drawn between the last two ticks.
+   The speeds are per tick, so they are the same as they were at 60 frames a second */
+FixedTimestep timestep;
+GLfloat previousAngle_y, previousMotorAngle;	// the view mode values before the last tick
+unsigned int statsTicks;
+
+/* Headless mode draws a scripted flight into a frame buffer object with no window, on a clock
+   that moves on by a fixed amount each frame rather than with real time */
+bool headlessMode;
+double headlessTime;
+GLuint screenFrameBuffer;	// what the scene is finally drawn into, 0 for the window
+
+/* The shaders are loaded from SHADER_DIR, which the CMake build sets to the source directory so
+   the program can be run from anywhere. Otherwise they are next to the working directory */
+#ifndef SHADER_DIR
+#define SHADER_DIR ""
+#endif
+
+/* Input recording and replay. The keys are logged with the tick they came before, and a replay
+   feeds them back before the same ticks, ignoring the keyboard, so a session can be run again
+   as a repeatable benchmark. A replay in the window writes each frame's time to replayTimings */
+InputLog inputLog;
+bool recordingInput, replayingInput;
+FrameTimingLog replayTimings;
+std::chrono::high_resolution_clock::time_point lastFrameStart;
+GLFWwindow* window;
+
+// nodes drawn this frame and their normal matrices. Nodes that are only rotated, translated and
+// scaled get theirs directly, the rest are calculated together in drawTransforms
+std::vector<int> drawList;
+std::vector<glm::mat3> drawNormals;
+std::vector<int> generalNormalList;
+TransformSoA drawTransforms;
+
+// bounding spheres of the meshes and of every node, for culling against the camera and shadow cascades
+BoundingSphere meshBounds[NUM_MESHES];
+SceneBounds sceneBounds;
+bool cullingMode;
+
+// parts are sorted by state in renderQueue before being drawn, sortDepthRange is the depth the sort key covers
+RenderQueue renderQueue;
+
+// the static meshes share one vertex and index buffer, and meshes made with the same parameters share buffers
+MeshArena meshArena;
+MeshCache meshCache;
+const int meshArenaVertices = 8192, meshArenaIndices = 16384;
+
+// the level of detail of each node, picked from its size on screen
+LodSelector lodSelector;
+bool lodMode;
+int meshLevels[NUM_MESHES];
+const float sortDepthRange = 100.f;
 
 using namespace std;
 using namespace glm;
 
+// one worker for every core but the render thread's
+int workerThreads()
+{
+	return std::max((int)std::thread::hardware_concurrency(), 1) - 1;
+}
+
+/* Rebuilds the scene graph for a swarm of numDrones drones. Drone 0 keeps its state, the
+   others are scattered over the flying area */
+void buildSwarm(int numDrones)
+{
+	scene.clear();
+	swarmDrones.clear();
+	int numDrawn = std::min(numDrones, maxDrawnDrones);
+	for (int i = 0; i < numDrawn; i++)
+		swarmDrones.push_back(buildDrone(scene));
+	drone = swarmDrones[0];
+	groundPlaneNode = buildGroundPlane(scene);
+
+	nodeDrone.assign(scene.nodes.size(), -1);
+	for (int i = 0; i < numDrawn; i++)
+	{
+		for (int node = swarmDrones[i].firstNode; node <= swarmDrones[i].lastNode; node++)
+			nodeDrone[node] = i;
+	}
+
+	swarm.resize(numDrones);
+	swarm.scatter(1, 1234);
+
+	// every node is new, so nothing from the old scene can be reused
+	shadowCascades.invalidateCache();
+	lodSelector.reset();
+}
+
 /*
 This function is called before entering the main rendering loop.
 Use it for all your initialisation stuff
 */
-void init(GLWrapper* glw)
+void init(std::function<GLuint(const char*, const char*)> loadShader, GLProcLookup getProcAddress)
 {
 	/* Set the object transformation controls to their initial values */
 	speed = 0.025f;
@@ -111,7 +281,6 @@ void init(GLWrapper* glw)
 	emitmode = 0;
 	attenuationmode = 1; // Attenuation is on by default
 	motorAngle = 0;
-	numLights = 0;
 	controlMode = 2;
 
 	//control mode 2 defaults
@@ -130,11 +299,26 @@ void init(GLWrapper* glw)
 	y = 0;
 	z = 4;
 	lightsOn = true;
+	instancedMode = true;
+	showRenderStats = false;
+	clusteredMode = false;
+	shadowCacheMode = true;
+	cullingMode = true;
+	vertexArrayMode = true;
+	lodMode = true;
+	uploadRingMode = true;
+	multithreadedMode = true;
+	jobs.start(multithreadedMode ? workerThreads() : 0);
+	statsFrames = statsDrawCalls = statsInstances = statsShadowCached = statsCulled = 0;
+	statsBinds = statsBindsSkipped = statsUploads = statsUploadsSkipped = statsPartSetupCalls = statsTriangles = 0;
+	statsBytesStreamed = statsFenceWaits = statsTicks = 0;
+	statsFenceWaitTime = 0.f;
+	previousAngle_y = previousMotorAngle = 0;
 
 	/* Load and build the vertex and fragment shaders */
 	try
 	{
-		shadowProgram = glw->LoadShader(".\\shadows.vert", ".\\shadows.frag");
+		shadowProgram = loadShader(SHADER_DIR "shadows.vert", SHADER_DIR "shadows.frag");
 	}
 	catch (exception& e)
 	{
@@ -145,37 +329,10 @@ void init(GLWrapper* glw)
 
 	shadowsModelID = glGetUniformLocation(shadowProgram, "model");
 	shadowsLightSpaceMatrixID = glGetUniformLocation(shadowProgram, "lightSpaceMatrix");
+	shadowsInstancedID = glGetUniformLocation(shadowProgram, "instanced");
 
-	// generates the frame buffer for the shadow map
-	glGenFramebuffers(1, &depthMapFBO);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-
-	// generates the texture for the shadow map
-	glGenTextures(1, &depthMap);
-	glBindTexture(GL_TEXTURE_2D, depthMap);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT,
-		SHADOW_WIDTH, SHADOW_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-	float borderColor[] = { 10.f, 10.f, 10.f, 10.f };
-	glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-	// attaches the texture to the frame buffer
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-	glDrawBuffer(GL_NONE);
-	glReadBuffer(GL_NONE);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		cout << "frame buffer invalid" << endl;
-		cin.ignore();
-		exit(0);
-	}
-
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	// generates the texture array and frame buffer for the shadow maps
+	shadowCascades.create(numShadowCascades, shadowMapSize);
 
 	
 
@@ -189,7 +346,7 @@ void init(GLWrapper* glw)
 	/* Load and build the vertex and fragment shaders */
 	try
 	{
-		program = glw->LoadShader(".\\poslight.vert", ".\\poslight.frag");
+		program = loadShader(SHADER_DIR "poslight.vert", SHADER_DIR "poslight.frag");
 	}
 	catch (exception& e)
 	{
@@ -200,39 +357,62 @@ void init(GLWrapper* glw)
 
 	/* Define uniforms to send to vertex shader */
 	modelID = glGetUniformLocation(program, "model");
-	colourModeID = glGetUniformLocation(program, "colourMode");
 	emitModeID = glGetUniformLocation(program, "emitMode");
-	attenuationModeID = glGetUniformLocation(program, "attenuationMode");
-	viewID = glGetUniformLocation(program, "view");
-	projectionID = glGetUniformLocation(program, "projection");
 	normalMatrixID = glGetUniformLocation(program, "normalMatrix");
-	for (int i = 0; i < maxNumLights; i++)
-	{
-		std::string str = "lightPos[" + std::to_string(i) + "]";
-		lightPosID[i] = glGetUniformLocation(program, str.c_str());
-
-		str = "lightColour[" + std::to_string(i) + "]";
-		lightColourID[i] = glGetUniformLocation(program, str.c_str());
-
-		str = "lightMode[" + std::to_string(i) + "]";
-		lightModeID[i] = glGetUniformLocation(program, str.c_str());
-	}
-	numLightsID = glGetUniformLocation(program, "numLights");
 	viewPosID = glGetUniformLocation(program, "viewPos");
 	colourOverrideID = glGetUniformLocation(program, "colourOverride");
 	reflectivenessID = glGetUniformLocation(program, "reflectiveness");
-	lightSpaceMatrixID = glGetUniformLocation(program, "lightSpaceMatrix");
+	instancedID = glGetUniformLocation(program, "instanced");
 	shadowMapID = glGetUniformLocation(program, "shadowMap");
+	clusterGridID = glGetUniformLocation(program, "clusterGrid");
+	clusterLightIndicesID = glGetUniformLocation(program, "clusterLightIndices");
+	clusterLightsID = glGetUniformLocation(program, "clusterLights");
+
+	/* The per-frame values and lights are read from uniform buffers, found by block index */
+	frameBuffer.create(sizeof(FrameUniforms), frameBlockBinding);
+	frameBuffer.bindToProgram(program, "FrameBlock");
+	lightBuffer.create();
+	lightBuffer.buffer.bindToProgram(program, "LightBlock");
+
+	uploadRing.create(uploadRingFrameSize, 3, getProcAddress);
+	InstanceBuffer::uploadRing = uploadRingMode ? &uploadRing : NULL;
 	
 
 	/* create our sphere and cube objects */
 
-	sphere.makeSphere(20, 20);
-	tube.makeTube(15, 0.1);
-	motorBell.makeTube(40, 0.1);
-	motorStator.makeTube(40, 0.85);
-	motorShaft.makeTube(40, 0.7);
-	cube.makeCube();
+	for (int lod = 0; lod < maxLods; lod++)
+	{
+		int rings = lodSegments(sphereRings, lod, 4);
+		sphere[lod].makeSphere(rings, rings);
+	}
+	// every part is drawn with colourMode 1, so the meshes are made without vertex colours.
+	// They are all packed into one arena, and identical meshes share their buffers
+	meshArena.create(compactVertexFormat, meshArenaVertices, meshArenaIndices, cube.attribute_v_coord, cube.attribute_v_normal, cube.attribute_v_colours);
+	meshCache.arena = &meshArena;
+	// the coarser levels halve the segments each time, levels that come out the same share buffers
+	for (int lod = 0; lod < maxLods; lod++)
+	{
+		tube[lod].makeTube(lodSegments(15, lod, 6), 0.1, compactVertexFormat, &meshCache);
+		motorBell[lod].makeTube(lodSegments(40, lod, 6), 0.1, compactVertexFormat, &meshCache);
+		motorStator[lod].makeTube(lodSegments(40, lod, 6), 0.85, compactVertexFormat, &meshCache);
+		motorShaft[lod].makeTube(lodSegments(40, lod, 6), 0.7, compactVertexFormat, &meshCache);
+	}
+	cube.makeCube(compactVertexFormat, true, &meshCache);
+	for (int mesh = 0; mesh < NUM_MESHES; mesh++)
+		meshLevels[mesh] = mesh == MESH_CUBE ? 1 : maxLods;
+	cout << "mesh arena: " << meshArena.numVertices << " vertices, " << meshArena.numIndices << " indices, " <<
+		meshCache.misses << " meshes made, " << meshCache.hits << " shared" << endl;
+
+	meshBounds[MESH_CUBE] = sphereFromBox(cube.boundsMin, cube.boundsMax);
+	meshBounds[MESH_TUBE] = sphereFromBox(tube[0].boundsMin, tube[0].boundsMax);
+	meshBounds[MESH_MOTOR_BELL] = sphereFromBox(motorBell[0].boundsMin, motorBell[0].boundsMax);
+	meshBounds[MESH_MOTOR_STATOR] = sphereFromBox(motorStator[0].boundsMin, motorStator[0].boundsMax);
+	meshBounds[MESH_MOTOR_SHAFT] = sphereFromBox(motorShaft[0].boundsMin, motorShaft[0].boundsMax);
+	meshBounds[MESH_SPHERE] = sphereFromBox(vec3(-1.f), vec3(1.f));
+
+	// build the scene graph, the static parts keep their world matrices from here on
+	swarmSizeIndex = 0;
+	buildSwarm(swarmSizes[swarmSizeIndex]);
 
 	// print instructions
 	cout << endl <<
@@ -264,567 +444,333 @@ void init(GLWrapper* glw)
 		endl <<
 		"##### General Buttons #####" << endl <<
 		"[F] Turn lights on the drone on/off (on by default)" << endl <<
-		"[,] Switch between draw modes to see the triangles or vertices" << endl;
+		"[,] Switch between draw modes to see the triangles or vertices" << endl <<
+		"[I] Switch instanced rendering on/off (on by default)" << endl <<
+		"[C] Show/hide the number of draw calls per frame" << endl <<
+		"[L] Switch clustered lighting for the drone lights on/off (off by default)" << endl <<
+		"[K] Switch caching of the static shadows on/off (on by default)" << endl <<
+		"[U] Switch frustum culling on/off (on by default)" << endl <<
+		"[V] Switch vertex array objects per mesh on/off (on by default)" << endl <<
+		"[M] Switch levels of detail for the tubes and spheres on/off (on by default)" << endl <<
+		"[B] Switch streaming through the upload ring on/off (on by default)" << endl <<
+		"[N] Change the size of the swarm flying with the drone (1, 1000, 10000, 100000 drones)" << endl <<
+		"[J] Switch updating the swarm on every core on/off (on by default)" << endl;
+#ifdef FRAME_PROFILER
+	cout <<
+		"[G] Show/hide a profile of the last " << FrameProfiler::maxFrames << " frames every " << frameProfiler.summaryInterval << " frames" << endl <<
+		"[H] Save the last " << FrameProfiler::maxFrames << " frames as a Chrome trace, profile.json" << endl;
+#endif
 
 }
 
-void render(mat4& view, GLuint renderModelID)
+/* A tube mesh at one of its levels of detail, NULL for the meshes that aren't tubes */
+Tube* tubeMesh(int mesh, int lod)
 {
+	switch (mesh)
+	{
+	case MESH_TUBE: return &tube[lod];
+	case MESH_MOTOR_BELL: return &motorBell[lod];
+	case MESH_MOTOR_STATOR: return &motorStator[lod];
+	case MESH_MOTOR_SHAFT: return &motorShaft[lod];
+	}
+	return NULL;
+}
 
-	mat3 normalmatrix;
+/* Binds a mesh's buffers so any number of its parts can be drawn with drawBoundMesh */
+void bindMesh(int mesh, int lod)
+{
+	if (mesh == MESH_CUBE)
+		cube.bindCube(drawmode);
+	else
+		tubeMesh(mesh, lod)->bindTube(drawmode);
+}
 
-	vec3 framePlateScale = vec3(1.f, 0.015f, 0.3f);
-	vec3 frameArmScale = vec3(0.8f, 0.03f, 0.15f);
-	vec3 standoffScale = vec3(0.025f, 0.17f, 0.025f);
-
-	vec3 motorBellScale = vec3(0.15f, 0.085f, 0.15f);
-	vec3 motorStatorScale = vec3(0.125f, 0.08f, 0.125f);
-	vec3 motorShaftScale = vec3(0.025f, 0.085f, 0.025f);
-	vec3 motorStrutsScale = vec3(0.011f, 0.011f, 0.14f);
-	vec3 groundPlaneScale = vec3(20.f, 0.0001f, 20.f);
-
-	vec4 frameColour = vec4(0.20f, 0.20f, 0.20f, 1.f);
-	vec4 motorColour = vec4(0.60f, 0.60f, 0.60f, 1.f);
-	vec4 motorStatorColour = vec4(0.88f, 0.44f, 0.f, 1.f);
-	vec4 standoffColour = vec4(1.f, 0.f, 0.f, 1.f);
-	vec3 groundPlaneColour = vec3(0.8f, 0.8f, 0.8f);
-
-	GLfloat frameReflect = 0.f;
-	GLfloat motorReflect = 8.f;
-	GLfloat motorStatorReflect = 2.f;
-	GLfloat standoffReflect = 1.f;
-
-	// Define our model transformation in a stack and 
-	// push the identity matrix onto the stack
-	stack<mat4> model;
-	model.push(mat4(1.0f));
-
-	// This block of code draws the drone
-	model.push(model.top());
-	{
-		// Define the global model transformations (rotate and scale). Note, we're not modifying thel ight source position
-		//model.top() = rotate(model.top(), -radians(angle_x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-		//model.top() = rotate(model.top(), -radians(angle_y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-		//model.top() = rotate(model.top(), -radians(angle_z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-		model.top() = translate(model.top(), vec3(x, y, z)); // translating xyz
-
-		// rotates the model after transforming it so these transformations do not affect the translation
-		model.top() = rotate(model.top(), -radians(modelAngle_x), glm::vec3(1, 0, 0)); //rotating in clockwise direction around x-axis
-		model.top() = rotate(model.top(), -radians(modelAngle_y), glm::vec3(0, 1, 0)); //rotating in clockwise direction around y-axis
-		model.top() = rotate(model.top(), -radians(modelAngle_z), glm::vec3(0, 0, 1)); //rotating in clockwise direction around z-axis
-
-		model.top() = rotate(model.top(), -radians(90.f), glm::vec3(0, 1, 0)); //rotates 90 degrees to align the drone along the axis which make controls easier
-
-		model.top() = scale(model.top(), vec3(model_scale, model_scale, model_scale));//scale equally in all axis
-		
-		// light sources on drone
-		if (lightsOn)
-		{
-			for (int i = 0; i < 4; i++)
-			{
-				/* Draw a small sphere in the lightsource position to visually represent the light source */
-				model.push(model.top());
-				{
-					model.top() = rotate(model.top(), -radians((90 * i) + 45.f), glm::vec3(0, 1, 0));
-					model.top() = translate(model.top(), vec3(0.7f, -0.08f, 0.f));
-					model.top() = scale(model.top(), vec3(0.02f, 0.02f, 0.02f)); // make a small sphere
-
-					// calculate and set uniforms for the lights colour and position
-					vec3 lightPos = view * model.top() * vec4(1.0f);
-					vec3 lightColour;
-					if (i > 0 && i < 3)
-						lightColour = vec3(0.6f, 0.1f, 0.1f);
-					else
-						lightColour = vec3(0.1f, 0.6f, 0.1f);
-					glUniform4fv(lightPosID[numLights], 1, &lightPos[0]);
-					glUniform3fv(lightColourID[numLights], 1, &lightColour[0]);
-					glUniform1ui(numLightsID, ++numLights);
-					// Recalculate the normal matrix and send the model and normal matrices to the vertex shader																							// Recalculate the normal matrix and send to the vertex shader																								// Recalculate the normal matrix and send to the vertex shader																								// Recalculate the normal matrix and send to the vertex shader																						// Recalculate the normal matrix and send to the vertex shader
-					glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-					normalmatrix = transpose(inverse(mat3(view * model.top())));
-					glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-					/* Draw our lightposition sphere  with emit mode on*/
-					emitmode = 1;
-					glUniform1ui(emitModeID, emitmode);
-					sphere.drawSphere(drawmode);
-					emitmode = 0;
-					glUniform1ui(emitModeID, emitmode);
-				}
-				model.pop();
-			}
-		}
+void drawBoundMesh(int mesh, int lod)
+{
+	if (mesh == MESH_CUBE)
+		cube.drawCubeBound(drawmode);
+	else
+		tubeMesh(mesh, lod)->drawTubeBound(drawmode);
+}
 
+InstanceBuffer* meshInstances(int mesh, int lod)
+{
+	if (mesh == MESH_CUBE)
+		return &cube.instances;
+	return &tubeMesh(mesh, lod)->instances;
+}
 
-		// frame top and bottom plates
-		model.push(model.top());
-		{
+/* Draws everything queued in the instance buffers with one instanced draw for each mesh and level.
+   The program's instanced uniform is only set for these draws, the spheres are drawn without
+   instancing and their instance attributes aren't there to read */
+void flushInstances(GLuint renderInstancedID)
+{
+	glUniform1ui(renderInstancedID, 1);
+	cube.drawCubeInstanced(drawmode);
+	for (int mesh = MESH_TUBE; mesh <= MESH_MOTOR_SHAFT; mesh++)
+	{
+		for (int lod = 0; lod < maxLods; lod++)
+			tubeMesh(mesh, lod)->drawTubeInstanced(drawmode);
+	}
+	glUniform1ui(renderInstancedID, 0);
+	renderStats.partSetupCalls += 2;
+}
 
-			model.top() = translate(model.top(), vec3(0.f, -0.085f, 0.f));
-			model.top() = scale(model.top(), framePlateScale);
-
-			// set the reflectiveness uniform
-			glUniform1f(reflectivenessID, frameReflect);
-			// set the colour uniform
-			glUniform4fv(colourOverrideID, 1, &frameColour[0]);
-			// Send the model uniform and normal matrix to the currently bound shader,
-			glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-			// Recalculate the normal matrix and send to the vertex shader
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+// the level of detail a node is drawn at this frame
+int nodeLod(int node)
+{
+	return lodMode ? lodSelector.levels[node] : 0;
+}
 
-			cube.drawCube(drawmode);
-		}
-		model.pop();
+/* Sends a material to the main shader, unless it is the one already there. The shadow
+   shader has no material uniforms so nothing is sent while it is bound */
+void setMaterial(int material, GLuint renderModelID, int& currentMaterial)
+{
+	if (renderModelID != modelID)
+		return;
+	if (material == currentMaterial)
+	{
+		renderStats.uniformUploadsSkipped++;
+		return;
+	}
 
-		model.push(model.top());
-		{
-			model.top() = translate(model.top(), vec3(0.f, 0.085f, 0.f));
-			model.top() = scale(model.top(), framePlateScale);
-
-			// set the reflectiveness uniform
-			glUniform1f(reflectivenessID, frameReflect);
-			// set the colour uniform
-			glUniform4fv(colourOverrideID, 1, &frameColour[0]);
-			// Send the model uniform and normal matrix to the currently bound shader,
-			glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-			// Recalculate the normal matrix and send to the vertex shader
-			normalmatrix = transpose(inverse(mat3(view * model.top())));
-			glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+	const Material& m = materials[material];
+	glUniform1f(reflectivenessID, m.reflectiveness);
+	glUniform4fv(colourOverrideID, 1, &m.colour[0]);
+	// emissive materials are drawn with emit mode on
+	emitmode = m.emissive ? 1 : 0;
+	glUniform1ui(emitModeID, emitmode);
+	renderStats.uniformUploads++;
+	renderStats.partSetupCalls += 3;
+	currentMaterial = material;
+}
 
-			cube.drawCube(drawmode);
-		}
-		model.pop();
+/* Draws the sorted queue. Meshes are only bound and materials only sent when they change
+   from the packet before, and the skipped binds and uploads are counted in renderStats */
+void submitQueue(GLuint renderModelID)
+{
+	PROFILE_SCOPE("submit");
+	int boundMesh = -1;
+	int currentMaterial = -1;
 
-		// arms
-		for (int i = 0; i < 4; i++)
-		{
-			model.push(model.top());
-			{
-				model.top() = rotate(model.top(), -radians((90 * i) + 45.f), glm::vec3(0, 1, 0));
-				model.top() = translate(model.top(), vec3(0.45f, -0.1f, 0.f));
-				model.top() = scale(model.top(), frameArmScale);
-
-				// set the reflectiveness uniform
-				glUniform1f(reflectivenessID, frameReflect);
-				// set the colour uniform
-				glUniform4fv(colourOverrideID, 1, &frameColour[0]);
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-				cube.drawCube(drawmode);
-			}
-			model.pop();
-		}
+	// the shadow shader has no lighting, render() only works out normal matrices for the main program
+	bool mainProgram = renderModelID == modelID;
+	const mat3 noNormalMatrix(1.f);
 
+	for (size_t i = 0; i < renderQueue.packets.size(); i++)
+	{
+		const DrawPacket& packet = renderQueue.packets[i];
+		const SceneNode& node = scene.nodes[packet.node];
+		const mat3& normalmatrix = mainProgram ? drawNormals[packet.drawIndex] : noNormalMatrix;
+		int lod = nodeLod(packet.node);
 
-		//motors 
-		for (int i = 0; i < 4; i++)
+		if (instancedMode && node.mesh != MESH_SPHERE)
 		{
-			model.push(model.top());
-			{
-
-				model.push(model.top());
-				{
-					model.top() = rotate(model.top(), -radians((90 * i) + 45.f), glm::vec3(0, 1, 0));
-					model.top() = translate(model.top(), vec3(0.77f, -0.02f, 0.f));
-
-
-					// moving bits
-					model.push(model.top());
-					{
-
-						if (i % 2 == 0)
-						{
-							model.top() = rotate(model.top(), -radians(motorAngle), glm::vec3(0, 1, 0));
-						}
-						else
-						{
-							model.top() = rotate(model.top(), radians(motorAngle), glm::vec3(0, 1, 0));
-						}
-
-						model.push(model.top());
-						{
-							model.top() = translate(model.top(), vec3(0.f, 0.042f, 0.f));
-							for (int j = 0; j < 3; j++)
-							{
-								model.push(model.top());
-								{
-									model.top() = rotate(model.top(), -radians(120.f * j), glm::vec3(0, 1, 0));
-									model.push(model.top());
-									{
-										if (i % 2 == 0)
-										{
-											model.top() = rotate(model.top(), -radians(10.f), glm::vec3(1, 0, 0));
-										}
-										else
-										{
-											model.top() = rotate(model.top(), radians(10.f), glm::vec3(1, 0, 0));
-										}
-										model.top() = translate(model.top(), vec3(0.15f, 0.03f, 0.f));
-										model.top() = scale(model.top(), vec3(0.3f,0.01f,0.05f));
-
-										// set the reflectiveness uniform
-										glUniform1f(reflectivenessID, motorReflect);
-										// set the colour uniform
-										glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-										// Send the model uniform and normal matrix to the currently bound shader,
-										glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-										// Recalculate the normal matrix and send to the vertex shader
-										normalmatrix = transpose(inverse(mat3(view * model.top())));
-										glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-										cube.drawCube(drawmode);
-									}
-									model.pop();
-									model.push(model.top());
-									{
-										model.top() = translate(model.top(), vec3(0.015f, 0.f, 0.f));
-										model.top() = scale(model.top(), motorStrutsScale);
-
-										// set the reflectiveness uniform
-										glUniform1f(reflectivenessID, motorReflect);
-										// set the colour uniform
-										glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-										// Send the model uniform and normal matrix to the currently bound shader,
-										glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-										// Recalculate the normal matrix and send to the vertex shader
-										normalmatrix = transpose(inverse(mat3(view * model.top())));
-										glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-										cube.drawCube(drawmode);
-									}
-									model.pop();
-									model.push(model.top());
-									{
-										model.top() = translate(model.top(), vec3(-0.015f, 0.f, 0.f));
-										model.top() = scale(model.top(), motorStrutsScale);
-
-										// set the reflectiveness uniform
-										glUniform1f(reflectivenessID, motorReflect);
-										// set the colour uniform
-										glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-										// Send the model uniform and normal matrix to the currently bound shader,
-										glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-										// Recalculate the normal matrix and send to the vertex shader
-										normalmatrix = transpose(inverse(mat3(view * model.top())));
-										glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-										cube.drawCube(drawmode);
-									}
-									model.pop();
-								}
-								model.pop();
-							}
-						}
-						model.pop();
-
-						// motor shaft
-						model.push(model.top());
-						{
-							model.top() = translate(model.top(), vec3(0.f, 0.06f, 0.f));
-							model.top() = scale(model.top(), motorShaftScale);
-							model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-							// set the reflectiveness uniform
-							glUniform1f(reflectivenessID, motorReflect);
-							// set the colour uniform
-							glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-							// Send the model uniform and normal matrix to the currently bound shader,
-							glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-							// Recalculate the normal matrix and send to the vertex shader
-							normalmatrix = transpose(inverse(mat3(view * model.top())));
-							glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-							motorShaft.drawTube(drawmode);
-						}
-						model.pop();
-
-						// motor bell
-						model.push(model.top());
-						{
-							model.top() = scale(model.top(), motorBellScale);
-							model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-							// set the reflectiveness uniform
-							glUniform1f(reflectivenessID, motorReflect);
-							// set the colour uniform
-							glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-							// Send the model uniform and normal matrix to the currently bound shader,
-							glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-							// Recalculate the normal matrix and send to the vertex shader
-							normalmatrix = transpose(inverse(mat3(view * model.top())));
-							glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-							motorBell.drawTube(drawmode);
-						}
-						model.pop();
-					}
-					model.pop();
-
-					// motor base 
-					model.push(model.top());
-					{
-						model.top() = translate(model.top(), vec3(0.f, -0.06f, 0.f));
-						model.top() = scale(model.top(), vec3(0.12f, 0.01f, 0.04f));
-
-						// set the reflectiveness uniform
-						glUniform1f(reflectivenessID, motorReflect);
-						// set the colour uniform
-						glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-						// Send the model uniform and normal matrix to the currently bound shader,
-						glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-						// Recalculate the normal matrix and send to the vertex shader
-						normalmatrix = transpose(inverse(mat3(view * model.top())));
-						glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-						cube.drawCube(drawmode);
-					}
-					model.pop();
-
-					model.push(model.top());
-					{
-						model.top() = translate(model.top(), vec3(0.f, -0.06f, 0.f));
-						model.top() = scale(model.top(), vec3(0.04f, 0.01f, 0.12f));
-
-						// set the reflectiveness uniform
-						glUniform1f(reflectivenessID, motorReflect);
-						// set the colour uniform
-						glUniform4fv(colourOverrideID, 1, &motorColour[0]);
-						// Send the model uniform and normal matrix to the currently bound shader,
-						glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-						// Recalculate the normal matrix and send to the vertex shader
-						normalmatrix = transpose(inverse(mat3(view * model.top())));
-						glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-						cube.drawCube(drawmode);
-					}
-					model.pop();
-
-					// motor stator
-					model.push(model.top());
-					{
-						model.top() = translate(model.top(), vec3(0.f, -0.015f, 0.f));
-						model.top() = scale(model.top(), motorStatorScale);
-						model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-						// set the reflectiveness uniform
-						glUniform1f(reflectivenessID, motorStatorReflect);
-						// set the colour uniform
-						glUniform4fv(colourOverrideID, 1, &motorStatorColour[0]);
-						// Send the model uniform and normal matrix to the currently bound shader,
-						glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-						// Recalculate the normal matrix and send to the vertex shader
-						normalmatrix = transpose(inverse(mat3(view * model.top())));
-						glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-						motorStator.drawTube(drawmode);
-					}
-					model.pop();
-
-				}
-				model.pop();
-			}
-			model.pop();
+			const Material& material = materials[node.material];
+			meshInstances(node.mesh, lod)->addInstance(node.world, normalmatrix, material.colour, material.reflectiveness);
+			continue;
 		}
 
-
-		model.push(model.top());
+		setMaterial(node.material, renderModelID, currentMaterial);
+		glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(node.world[0][0]));
+		renderStats.partSetupCalls++;
+		if (mainProgram)
 		{
+			glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+			renderStats.partSetupCalls++;
 		}
-		model.pop();
 
-		// standoffs
+		if (node.mesh == MESH_SPHERE)
 		{
+			// the sphere sets up its attributes in the shared vertex array object, not a mesh's own
+			if (vertexArrayMode)
+				bindVertexArray(vao);
+			// the sphere binds its own buffers so the next mesh has to be bound again
+			sphere[lod].drawSphere(drawmode);
+			int rings = lodSegments(sphereRings, lod, 4);
+			renderStats.drawCalls++;
+			renderStats.trianglesDrawn += 2 * rings * rings;
+			boundMesh = -1;
+			continue;
+		}
 
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(0.45f, 0.00f, 0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-				// set the reflectiveness uniform
-				glUniform1f(reflectivenessID, standoffReflect);
-				// set the colour uniform
-				glUniform4fv(colourOverrideID, 1, &standoffColour[0]);
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
-
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(0.2f, 0.00f, 0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
-
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(-0.2f, 0.00f, 0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
-
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(-0.45f, 0.00f, 0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
-
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(0.45f, 0.00f, -0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
-
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
+		// each level of detail is a separate mesh
+		int meshLod = node.mesh * maxLods + lod;
+		if (meshLod == boundMesh)
+		{
+			renderStats.meshBindsSkipped++;
+		}
+		else
+		{
+			bindMesh(node.mesh, lod);
+			renderStats.meshBinds++;
+			boundMesh = meshLod;
+		}
+		drawBoundMesh(node.mesh, lod);
+	}
 
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(0.2f, 0.00f, -0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
+	// leave emit mode off for whatever is drawn next
+	if (currentMaterial >= 0 && emitmode != 0)
+	{
+		emitmode = 0;
+		glUniform1ui(emitModeID, emitmode);
+	}
 
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
+	if (instancedMode)
+		flushInstances(renderModelID == modelID ? instancedID : shadowsInstancedID);
 
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+	// leave the shared vertex array object bound rather than a mesh's
+	if (vertexArrayMode)
+		bindVertexArray(vao);
+}
 
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
+/* Normal matrices for the nodes in drawList. They only need an inverse for nodes that are not
+   just rotated and scaled, and those are worked out together by drawTransforms */
+void computeDrawNormals(const mat4& view)
+{
+	mat3 viewRotation = mat3(view);
+	bool rigidView = isRotation(viewRotation);
 
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(-0.2f, 0.00f, -0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
+	drawNormals.resize(drawList.size());
+	generalNormalList.clear();
+	for (size_t i = 0; i < drawList.size(); i++)
+	{
+		const SceneNode& node = scene.nodes[drawList[i]];
+		if (rigidView && node.rigidScale)
+			drawNormals[i] = rigidNormalMatrix(node, viewRotation);
+		else
+			generalNormalList.push_back((int)i);
+	}
 
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
+	if (!generalNormalList.empty())
+	{
+		drawTransforms.resize(generalNormalList.size());
+		for (size_t i = 0; i < generalNormalList.size(); i++)
+		{
+			drawTransforms.setWorld(i, scene.nodes[drawList[generalNormalList[i]]].world);
+		}
+		drawTransforms.computeModelViewNormal(view);
+		for (size_t i = 0; i < generalNormalList.size(); i++)
+		{
+			drawNormals[generalNormalList[i]] = drawTransforms.getNormal(i);
+		}
+	}
+}
 
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+/* Draws every node of the scene graph using the world matrices calculated by
+   scene.updateWorldTransforms(), with normal matrices from computeDrawNormals() in the main pass.
+   The filter picks the static or dynamic nodes only, for the shadow cache. Nodes outside the
+   frustum of viewProjection are skipped before anything is sent for them.
+   The nodes are put in renderQueue and sorted by program, mesh, material and depth before
+   they are drawn, so parts sharing a mesh or material are drawn one after the other */
+void render(mat4& view, const mat4& viewProjection, GLuint renderModelID, DrawFilter filter = DRAW_ALL)
+{
+	PROFILE_SCOPE("render");
+	if (cullingMode)
+	{
+		PROFILE_SCOPE("cull");
+		sceneBounds.cull(scene, frustumFromMatrix(viewProjection));
+	}
 
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
+	drawList.clear();
+	for (size_t i = 0; i < scene.nodes.size(); i++)
+	{
+		const SceneNode& node = scene.nodes[i];
+
+		// nodes without a mesh are only used to group their children
+		if (node.mesh < 0)
+			continue;
+		if (node.mesh == MESH_SPHERE && !swarm.lightsOn[nodeDrone[i]])
+			continue;
+		if ((filter == DRAW_STATIC && node.dynamic) || (filter == DRAW_DYNAMIC && !node.dynamic))
+			continue;
+		if (cullingMode && !sceneBounds.visible[i])
+		{
+			renderStats.nodesCulled++;
+			continue;
+		}
 
-			model.push(model.top());
-			{
-				model.top() = translate(model.top(), vec3(-0.45f, 0.00f, -0.12f));
-				model.top() = scale(model.top(), standoffScale);
-				model.top() = rotate(model.top(), -radians(90.f), glm::vec3(1, 0, 0));
+		drawList.push_back((int)i);
+	}
 
-				// Send the model uniform and normal matrix to the currently bound shader,
-				glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
+	// the shadow passes don't use normals, so only the main pass works them out
+	if (renderModelID == modelID)
+		computeDrawNormals(view);
 
-				// Recalculate the normal matrix and send to the vertex shader
-				normalmatrix = transpose(inverse(mat3(view * model.top())));
-				glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
+	unsigned int programIndex = renderModelID == modelID ? 0 : 1;
+	renderQueue.clear();
+	for (size_t i = 0; i < drawList.size(); i++)
+	{
+		const SceneNode& node = scene.nodes[drawList[i]];
+		float depth = -(view * node.world[3]).z;
+		renderQueue.add(makeSortKey(programIndex, node.mesh * maxLods + nodeLod(drawList[i]), node.material, depth, sortDepthRange), drawList[i], (int)i);
+	}
+	{
+		PROFILE_SCOPE("sort");
+		renderQueue.sort();
+	}
 
-				/* Draw our cube*/
-				tube.drawTube(drawmode);
-			}
-			model.pop();
+	submitQueue(renderModelID);
+}
 
+/* Runs ticks ticks of the simulation, the view mode animation here and the swarm in its jobs,
+   then poses the drones alpha of the way through the next tick */
+static void simulate(int ticks, float alpha)
+{
+	if (controlMode == 1)
+	{
+		for (int tick = 0; tick < ticks; tick++)
+		{
+			previousAngle_y = angle_y;
+			angle_y += angle_inc_y;
+			previousMotorAngle = motorAngle;
+			motorAngle += motorAngleInc;
 		}
 	}
-	model.pop();
 
-	// ground plane
-	model.push(model.top());
+	// the controlled drone goes through the same batch update as the rest of the swarm, with the controls as its velocity
+	swarm.positionX[0] = x;
+	swarm.positionY[0] = y;
+	swarm.positionZ[0] = z;
+	swarm.velocityX[0] = moveX;
+	swarm.velocityY[0] = moveY;
+	swarm.velocityZ[0] = moveZ;
+	swarm.pitch[0] = modelAngle_x;
+	swarm.yaw[0] = modelAngle_y;
+	swarm.roll[0] = modelAngle_z;
+	swarm.propAngle[0] = motorAngle;
+	swarm.lightsOn[0] = lightsOn;
+	if (controlMode == 1)
 	{
+		// the drone is only drawn between the ticks, it doesn't fly
+		swarm.storePrevious(0, 1);
+		swarm.previousPropAngle[0] = previousMotorAngle;
+	}
 
-		model.top() = translate(model.top(), vec3(0.f, -1.f, 0.f));
-		model.top() = scale(model.top(), groundPlaneScale);
-
-		// set the reflectiveness uniform
-		glUniform1f(reflectivenessID, frameReflect);
-		// set the colour uniform
-		glUniform4fv(colourOverrideID, 1, &groundPlaneColour[0]);
-		// Send the model uniform and normal matrix to the currently bound shader,
-		glUniformMatrix4fv(renderModelID, 1, GL_FALSE, &(model.top()[0][0]));
-		// Recalculate the normal matrix and send to the vertex shader
-		normalmatrix = transpose(inverse(mat3(view * model.top())));
-		glUniformMatrix3fv(normalMatrixID, 1, GL_FALSE, &normalmatrix[0][0]);
-
-		cube.drawCube(drawmode);
+	/* Fly the swarm and pose the drones on the job system, only the drone poses and motors
+	   change so the rest of the scene keeps its cached transforms. In view mode the controlled
+	   drone stays where it is. Drawing starts once the whole scene graph is up to date */
+	FlightLimits limits = defaultFlightLimits;
+	limits.tiltChange = modelAngleChange;
+	{
+		PROFILE_SCOPE("swarm");
+		jobs.wait(scheduleSwarmFrame(jobs, swarm, controlMode == 2 ? 0 : 1, limits, ticks, alpha, scene, swarmDrones, model_scale, swarmDroneScale));
+		jobs.clear();
 	}
-	model.pop();
-}
 
-void resetLights()
-{
-	numLights = 0;
-	for (int i = 0; i < maxNumLights; i++)
+	if (controlMode == 2)
 	{
-		vec4 temp(0.f);
-		glUniform4fv(lightPosID[numLights], 1, &temp[0]);
-		glUniform3fv(lightColourID[numLights], 1, &temp[0]);
+		x = swarm.positionX[0];
+		y = swarm.positionY[0];
+		z = swarm.positionZ[0];
+		modelAngle_x = swarm.pitch[0];
+		modelAngle_z = swarm.roll[0];
+		motorAngle = swarm.propAngle[0];
 	}
-	glUniform1ui(numLightsID, 0);
 }
 
+static void handleKey(int key, int action);
+
 /* Called to update the display. Note that this function is called in the event loop in the wrapper
    class because we registered display as a callback function */
 void display()
@@ -839,16 +785,56 @@ void display()
 	mat4 view;
 	
 
-	// render shadow maps
-	glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-	glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-	glClear(GL_DEPTH_BUFFER_BIT);
-	glUseProgram(shadowProgram);
+	chrono::high_resolution_clock::time_point frameStart = chrono::high_resolution_clock::now();
+	PROFILE_FRAME_BEGIN();
+	renderStats.reset();
 
-	resetLights();
+	// this frame's part of the ring, waiting if the GPU is still reading it from three frames ago
+	uploadRing.beginFrame();
 
-	projection = ortho(-10.f, 10.f, -10.f, 10.f, 0.1f, 20.f);
+	// the ticks that are due since the last frame
+	int ticks = timestep.advance(headlessMode ? headlessTime : glfwGetTime());
+	float alpha = timestep.alpha();
+
+	/* A replay's input goes in between the ticks it was recorded before, so the frame's ticks
+	   are run in parts split at the events. The replay stops at the tick the session ended on */
+	if (replayingInput)
+		inputLog.replayTicks(timestep.ticks - ticks, ticks, [](const InputEvent& event) { handleKey(event.key, event.action); },
+			[alpha](int part) { simulate(part, alpha); });
+	else
+		simulate(ticks, alpha);
+	{
+		PROFILE_SCOPE("scene bounds");
+		sceneBounds.update(scene, meshBounds);
+	}
 
+	// the camera is worked out first so the shadow cascades can be fitted to it
+	projection = perspective(radians(60.f), aspect_ratio, 0.1f, 100.f);
+
+	if (controlMode == 1)
+	{
+		view = lookAt(
+			vec3(0, 0, -4), // Camera is at (0,0,4), in World Space
+			vec3(0, 0, 0), // and looks at the origin
+			vec3(0, 1, 0)  // Head is up (set to 0,-1,0 to look upside-down)
+		);
+
+		view = rotate(view, -angle_x, vec3(1, 0, 0));
+		view = rotate(view, radians(mix(previousAngle_y, angle_y, alpha)), vec3(0, 1, 0));
+		
+	}
+	else if (controlMode == 2)
+	{
+		GLfloat temp = x / z;
+		if (abs(x) < 0.01 || abs(z) < 0.01)
+			temp = 0;
+
+		view = lookAt(
+			vec3(0, 2, 0), // Camera is at (0,0,4), in World Space
+			swarm.drawnPosition(0, alpha), // and looks at the drone where it is drawn
+			vec3(0, 1, 0)  // Head is up (set to 0,-1,0 to look upside-down)
+		);
+	}
 
 	vec3 lightPos;
 	if (controlMode == 1)
@@ -860,18 +846,50 @@ void display()
 		lightPos = vec3(0.f, 4.f, 0.f);
 	}
 
-	view = glm::lookAt(lightPos,
-		vec3(x, y, z),
-		vec3(0.0f, 1.0f, 0.0f));
+	// pick each part's level of detail from its size on screen, the shadows are drawn at the same levels
+	if (lodMode)
+	{
+		PROFILE_SCOPE("lod");
+		lodSelector.update(scene, meshBounds, meshLevels, vec3(inverse(view)[3]), windowHeight / (2.f * tan(radians(30.f))));
+	}
 
-	mat4 lightSpace = projection * view;
+	// render shadow maps, one for each cascade
+	{
+		PROFILE_GPU_SCOPE("shadow pass");
+		shadowCascades.fit(view, radians(60.f), aspect_ratio, 0.1f, swarm.drawnPosition(0, alpha) - lightPos);
 
+		glUseProgram(shadowProgram);
 
-	glUniformMatrix4fv(shadowsLightSpaceMatrixID, 1, GL_FALSE, &lightSpace[0][0]);
+		// the static casters only need drawing again when they or the cascade have moved
+		if (scene.staticChanged || !shadowCacheMode)
+			shadowCascades.invalidateCache();
 
-	render(view,shadowsModelID);
+		for (int i = 0; i < shadowCascades.numCascades; i++)
+		{
+			glUniformMatrix4fv(shadowsLightSpaceMatrixID, 1, GL_FALSE, &shadowCascades.lightSpaceMatrix[i][0][0]);
+			if (shadowCacheMode)
+			{
+				if (shadowCascades.isCached(i))
+				{
+					renderStats.shadowCascadesCached++;
+				}
+				else
+				{
+					shadowCascades.bindStaticCascade(i);
+					render(shadowCascades.lightView, shadowCascades.lightSpaceMatrix[i], shadowsModelID, DRAW_STATIC);
+				}
+				shadowCascades.copyStaticCascade(i);
+				render(shadowCascades.lightView, shadowCascades.lightSpaceMatrix[i], shadowsModelID, DRAW_DYNAMIC);
+			}
+			else
+			{
+				shadowCascades.bindCascade(i);
+				render(shadowCascades.lightView, shadowCascades.lightSpaceMatrix[i], shadowsModelID);
+			}
+		}
+	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, screenFrameBuffer);
 	glUseProgram(0);
 	
 	// render actual view
@@ -891,127 +909,135 @@ void display()
 	/* Make the compiled shader program current */
 	glUseProgram(program);
 
-	projection = perspective(radians(60.f), aspect_ratio, 0.1f, 100.f);
+	// main light, the one that casts the shadows
+	lightBuffer.clear();
+	lightBuffer.addLight(lightPos, vec3(10.f), 1);
 
-	if (controlMode == 1)
+	/* light sources on every drawn drone with its lights on, cut down to the nearest ones that
+	   reach the view. In clustered mode they only light the clusters they reach, otherwise they
+	   fill the rest of the light block */
+	lightClusters.setFrustum(radians(60.f), aspect_ratio, 0.1f, 100.f, windowWidth, windowHeight);
+	clusterLights.clear();
+	for (size_t d = 0; d < swarmDrones.size(); d++)
 	{
-		view = lookAt(
-			vec3(0, 0, -4), // Camera is at (0,0,4), in World Space
-			vec3(0, 0, 0), // and looks at the origin
-			vec3(0, 1, 0)  // Head is up (set to 0,-1,0 to look upside-down)
-		);
-
-		view = rotate(view, -angle_x, vec3(1, 0, 0));
-		view = rotate(view, radians(angle_y), vec3(0, 1, 0));
-		
+		if (!swarm.lightsOn[d])
+			continue;
+		for (int i = 0; i < 4; i++)
+		{
+			ClusterLight light;
+			light.position = view * scene.nodes[swarmDrones[d].lights[i]].world * vec4(1.0f);
+			light.colour = droneLightColour(i);
+			light.radius = attenuationmode == 1 ? lightRadius(light.colour) : 200.f;	// no falloff without attenuation
+			clusterLights.push_back(light);
+		}
 	}
-	else if (controlMode == 2)
+	lightClusters.cullLights(clusterLights, clusteredMode ? maxClusterLights : maxNumLights - 1);
+	if (!clusteredMode)
 	{
-		GLfloat temp = x / z;
-		if (abs(x) < 0.01 || abs(z) < 0.01)
-			temp = 0;
-
-		view = lookAt(
-			vec3(0, 2, 0), // Camera is at (0,0,4), in World Space
-			vec3(x, y, z), // and looks at the origin
-			vec3(0, 1, 0)  // Head is up (set to 0,-1,0 to look upside-down)
-		);
+		for (const ClusterLight& light : clusterLights)
+			lightBuffer.addLight(light.position, light.colour);
+	}
+	{
+		PROFILE_SCOPE("uniform uploads");
+		lightBuffer.upload(uploadRingMode ? &uploadRing : NULL);
 	}
 
-	resetLights();
-	vec3 lightColour = vec3(10.f);
-	glUniform4fv(lightPosID[numLights], 1, &lightPos[0]);
-	glUniform1ui(lightModeID[numLights], 1);
-	glUniform3fv(lightColourID[numLights], 1, &lightColour[0]);
-	glUniform1ui(numLightsID, ++numLights);
+	if (clusteredMode)
+	{
+		PROFILE_SCOPE("light clusters");
+		lightClusters.assignLights(clusterLights);
+		lightClusters.upload(clusterLights);
+		lightClusters.bindTextures(1, 2, 3);
+	}
 
-	// Send our projection and view uniforms to the currently bound shader
+	// Send our projection and view uniforms in one upload
 	// I do that here because they are the same for all objects
-	glUniform1ui(colourModeID, colourmode);
-	glUniform1ui(attenuationModeID, attenuationmode);
-	glUniformMatrix4fv(viewID, 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(projectionID, 1, GL_FALSE, &projection[0][0]);
-	glUniformMatrix4fv(lightSpaceMatrixID, 1, GL_FALSE, &lightSpace[0][0]);
+	frameUniforms.view = view;
+	frameUniforms.projection = projection;
+	for (int i = 0; i < shadowCascades.numCascades; i++)
+	{
+		frameUniforms.lightSpaceMatrix[i] = shadowCascades.lightSpaceMatrix[i];
+		frameUniforms.cascadeSplits[i] = shadowCascades.splitDepth[i];
+	}
+	frameUniforms.numCascades = shadowCascades.numCascades;
+	frameUniforms.colourMode = colourmode;
+	frameUniforms.attenuationMode = attenuationmode;
+	frameUniforms.clusterCount = uvec4(lightClusters.tilesX, lightClusters.tilesY, lightClusters.slices, clusteredMode ? 1 : 0);
+	vec2 tileSize = lightClusters.tileSize();
+	frameUniforms.clusterScale = vec4(tileSize.x, tileSize.y, lightClusters.sliceScale(), lightClusters.sliceBias());
+	{
+		PROFILE_SCOPE("uniform uploads");
+		frameBuffer.update(&frameUniforms, sizeof(FrameUniforms), uploadRingMode ? &uploadRing : NULL);
+	}
 	
-	glBindTexture(GL_TEXTURE_2D, depthMap);
+	glBindTexture(GL_TEXTURE_2D_ARRAY, shadowCascades.depthTexture);
 	glActiveTexture(GL_TEXTURE0 + 0);
 	glUniform1i(shadowMapID, 0);
+	glUniform1i(clusterGridID, 1);
+	glUniform1i(clusterLightIndicesID, 2);
+	glUniform1i(clusterLightsID, 3);
 	
 	
 
-	render(view,modelID);
+	{
+		PROFILE_GPU_SCOPE("main pass");
+		render(view, projection * view, modelID);
+	}
 
 	glDisableVertexAttribArray(0);
 	glUseProgram(0);
 
-	/* Modify our animation variables */
-	
+	// everything reading this frame's part of the ring has been submitted
+	uploadRing.endFrame();
+	PROFILE_FRAME_END();
 
-	GLfloat minmaxXZ = 9.5f;
-	GLfloat maxY = 5.f;
-	GLfloat minY = -0.8f;
-	GLfloat minYFly = -0.6f;
-	
-	if (controlMode == 1)
+	// a replay in the window times each frame from its start to the next one's, and closes at the end of the session
+	if (replayingInput && !headlessMode)
 	{
-		angle_y += angle_inc_y;
-		motorAngle += motorAngleInc;
+		double cpuTime = chrono::duration<double, milli>(chrono::high_resolution_clock::now() - frameStart).count();
+		if (timestep.ticks > 0)
+			replayTimings.add(timestep.ticks, cpuTime, chrono::duration<double, milli>(frameStart - lastFrameStart).count(), renderStats);
+		if (timestep.ticks >= inputLog.endTick)
+			glfwSetWindowShouldClose(window, GL_TRUE);
 	}
-	else if (controlMode == 2)
-	{
-		if (moveY > 0 && y < maxY)
-		{
-			y += moveY;
-		}
-		else if (moveY < 0 && y > minY)
-		{
-			y += moveY;
-		}
-
-		if (moveZ > 0 && z < minmaxXZ && y > minYFly)
-		{
-			z += moveZ;
-			modelAngle_x = glm::max(-30.f, modelAngle_x - modelAngleChange);
-		}
-		else if (moveZ < 0 && z > -minmaxXZ && y > minYFly)
-		{
-			z += moveZ;
-			modelAngle_x = glm::min(30.f, modelAngle_x + modelAngleChange);
-		}
-		else
-		{
-			if (modelAngle_x > 0)
-				modelAngle_x -= modelAngleChange;
-			if (modelAngle_x < 0)
-				modelAngle_x += modelAngleChange;
-		}
-
+	lastFrameStart = frameStart;
 
-		if (moveX > 0 && x < minmaxXZ && y > minYFly)
-		{
-			x += moveX;
-			modelAngle_z = glm::min(30.f, modelAngle_z + modelAngleChange);
-		}
-		else if (moveX < 0 && x > -minmaxXZ && y > minYFly)
-		{
-			x += moveX;
-			modelAngle_z = glm::max(-30.f, modelAngle_z - modelAngleChange);
-		}
-		else
-		{
-			if (modelAngle_z > 0)
-				modelAngle_z -= modelAngleChange;
-			if (modelAngle_z < 0)
-				modelAngle_z += modelAngleChange;
-		}
-
-		if (y > minY)
-		{
-			motorAngle += 47;
-		}
-		if (motorAngle > 360)
+	// print the average number of draw calls over the last 60 frames
+	if (showRenderStats)
+	{
+		statsFrames++;
+		statsDrawCalls += renderStats.drawCalls;
+		statsInstances += renderStats.instancesDrawn;
+		statsTriangles += renderStats.trianglesDrawn;
+		statsPartSetupCalls += renderStats.partSetupCalls + renderStats.drawCalls;
+		statsShadowCached += renderStats.shadowCascadesCached;
+		statsCulled += renderStats.nodesCulled;
+		statsBinds += renderStats.meshBinds;
+		statsBindsSkipped += renderStats.meshBindsSkipped;
+		statsUploads += renderStats.uniformUploads;
+		statsUploadsSkipped += renderStats.uniformUploadsSkipped;
+		statsBytesStreamed += renderStats.bytesStreamed;
+		statsFenceWaits += renderStats.fenceWaits;
+		statsFenceWaitTime += renderStats.fenceWaitTime;
+		statsTicks += ticks;
+		if (statsFrames == 60)
 		{
-			motorAngle -= 360;
+			cout << "draw calls/frame: " << statsDrawCalls / statsFrames <<
+				", parts drawn/frame: " << statsInstances / statsFrames <<
+				", triangles/frame: " << statsTriangles / statsFrames << (lodMode ? " (LOD)" : " (no LOD)") <<
+				(instancedMode ? " (instanced)" : " (not instanced)") <<
+				", part draw and setup GL calls/frame: " << statsPartSetupCalls / statsFrames << (vertexArrayMode ? " (vertex arrays)" : " (no vertex arrays)") <<
+				", shadow cascades cached: " << statsShadowCached << "/" << statsFrames * shadowCascades.numCascades <<
+				", parts culled/frame: " << statsCulled / statsFrames <<
+				", mesh binds/frame: " << statsBinds / statsFrames << " (" << statsBindsSkipped / statsFrames << " skipped)" <<
+				", material uploads/frame: " << statsUploads / statsFrames << " (" << statsUploadsSkipped / statsFrames << " skipped)" <<
+				", streamed/frame: " << statsBytesStreamed / statsFrames / 1024 << "KB" << (uploadRingMode ? " (upload ring)" : " (no upload ring)") <<
+				", fence wait/frame: " << statsFenceWaitTime / statsFrames << "us (" << statsFenceWaits << " frames waited)" <<
+				", ticks/frame: " << (float)statsTicks / statsFrames << endl;
+			statsFrames = statsDrawCalls = statsInstances = statsShadowCached = statsCulled = 0;
+			statsBinds = statsBindsSkipped = statsUploads = statsUploadsSkipped = statsPartSetupCalls = statsTriangles = 0;
+			statsBytesStreamed = statsFenceWaits = statsTicks = 0;
+			statsFenceWaitTime = 0.f;
 		}
 	}
 }
@@ -1033,6 +1059,19 @@ static void keyCallback(GLFWwindow* window, int key, int s, int action, int mods
 
 	if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS)
 		glfwSetWindowShouldClose(window, GL_TRUE);
+
+	// a replay only takes its keys from the log
+	if (replayingInput)
+		return;
+	if (recordingInput)
+		inputLog.record((unsigned int)timestep.ticks, key, action);
+	handleKey(key, action);
+}
+
+/* Everything a key does, whether it comes from the keyboard or a replay. The simulation only
+   changes through here, between ticks */
+static void handleKey(int key, int action)
+{
 	bool modeChanged = false;
 	// sets the control mode
 	if (key == '1')
@@ -1100,6 +1139,16 @@ static void keyCallback(GLFWwindow* window, int key, int s, int action, int mods
 
 			lightsOn = true;
 		}
+
+		// the drone jumps to its new place rather than being drawn on the way there
+		previousAngle_y = angle_y;
+		previousMotorAngle = motorAngle;
+		swarm.previousX[0] = x;
+		swarm.previousY[0] = y;
+		swarm.previousZ[0] = z;
+		swarm.previousPitch[0] = modelAngle_x;
+		swarm.previousYaw[0] = modelAngle_y;
+		swarm.previousRoll[0] = modelAngle_z;
 	}
 
 
@@ -1149,53 +1198,7 @@ static void keyCallback(GLFWwindow* window, int key, int s, int action, int mods
 	}
 	else if (controlMode == 2)
 	{
-		if (key == 'A')//left
-		{
-			if (action == GLFW_PRESS)
-				moveX = speed; 
-			if (action == GLFW_RELEASE)
-				moveX = 0;
-			
-		}
-		else if (key == 'D')//right
-		{
-			if (action == GLFW_PRESS)
-				moveX = -speed;
-			if (action == GLFW_RELEASE)
-				moveX = 0;
-		}
-
-		if (key == 'W')//forward
-		{
-			if (action == GLFW_PRESS)
-				moveZ = speed;
-			if (action == GLFW_RELEASE)
-				moveZ = 0;
-
-		}
-		else if (key == 'S')//back
-		{
-			if (action == GLFW_PRESS)
-				moveZ = -speed;
-			if (action == GLFW_RELEASE)
-				moveZ = 0;
-		}
-
-		if (key == 'E')//up
-		{
-			if (action == GLFW_PRESS)
-				moveY = speed;
-			if (action == GLFW_RELEASE)
-				moveY = 0;
-
-		}
-		else if (key == 'Q')//down
-		{
-			if (action == GLFW_PRESS)
-				moveY = -speed;
-			if (action == GLFW_RELEASE)
-				moveY = 0;
-		}
+		flyKey(key, action, speed, moveX, moveY, moveZ);
 	}
 	else
 	{
@@ -1222,6 +1225,84 @@ static void keyCallback(GLFWwindow* window, int key, int s, int action, int mods
 		lightsOn = !lightsOn;
 	}
 
+	if (key == 'I' && action == GLFW_RELEASE)
+	{
+		instancedMode = !instancedMode;
+	}
+
+	if (key == 'U' && action == GLFW_RELEASE)
+	{
+		cullingMode = !cullingMode;
+	}
+
+	if (key == 'M' && action == GLFW_RELEASE)
+	{
+		lodMode = !lodMode;
+		lodSelector.reset();
+	}
+
+	if (key == 'V' && action == GLFW_RELEASE)
+	{
+		vertexArrayMode = !vertexArrayMode;
+		cube.useVertexArray = vertexArrayMode;
+		for (int lod = 0; lod < maxLods; lod++)
+		{
+			tube[lod].useVertexArray = motorBell[lod].useVertexArray = vertexArrayMode;
+			motorStator[lod].useVertexArray = motorShaft[lod].useVertexArray = vertexArrayMode;
+		}
+	}
+
+	if (key == 'K' && action == GLFW_RELEASE)
+	{
+		shadowCacheMode = !shadowCacheMode;
+	}
+
+	if (key == 'L' && action == GLFW_RELEASE)
+	{
+		clusteredMode = !clusteredMode;
+	}
+
+#ifdef FRAME_PROFILER
+	if (key == 'G' && action == GLFW_RELEASE)
+	{
+		frameProfiler.printSummaries = !frameProfiler.printSummaries;
+	}
+
+	if (key == 'H' && action == GLFW_RELEASE)
+	{
+		cout << (frameProfiler.writeChromeTrace("profile.json") ? "saved profile.json" : "couldn't save profile.json") << endl;
+	}
+#endif
+
+	if (key == 'C' && action == GLFW_RELEASE)
+	{
+		showRenderStats = !showRenderStats;
+		statsFrames = statsDrawCalls = statsInstances = statsShadowCached = statsCulled = 0;
+		statsBinds = statsBindsSkipped = statsUploads = statsUploadsSkipped = statsPartSetupCalls = statsTriangles = 0;
+		statsBytesStreamed = statsFenceWaits = statsTicks = 0;
+		statsFenceWaitTime = 0.f;
+	}
+
+	if (key == 'B' && action == GLFW_RELEASE)
+	{
+		uploadRingMode = !uploadRingMode;
+		InstanceBuffer::uploadRing = uploadRingMode ? &uploadRing : NULL;
+	}
+
+	if (key == 'J' && action == GLFW_RELEASE)
+	{
+		multithreadedMode = !multithreadedMode;
+		jobs.start(multithreadedMode ? workerThreads() : 0);
+		cout << "swarm update on " << jobs.numThreads() << " threads" << endl;
+	}
+
+	if (key == 'N' && action == GLFW_RELEASE)
+	{
+		swarmSizeIndex = (swarmSizeIndex + 1) % (sizeof(swarmSizes) / sizeof(swarmSizes[0]));
+		buildSwarm(swarmSizes[swarmSizeIndex]);
+		cout << "swarm: " << swarm.size() << " drones, " << swarmDrones.size() << " drawn" << endl;
+	}
+
 	/* Cycle between drawing vertices, mesh and filled polygons */
 	if (key == ',' && action != GLFW_RELEASE)
 	{
@@ -1233,8 +1314,187 @@ static void keyCallback(GLFWwindow* window, int key, int s, int action, int mods
 
 
 /* Entry point of program */
+/* The flight the headless run takes, the same every time: the drone takes off, flies round in a
+   circle with the swarm, and then the camera goes round it in view mode for the last quarter */
+static void scriptHeadlessFrame(int frame, int numFrames, double seconds)
+{
+	if (frame == numFrames * 3 / 4)
+	{
+		handleKey('1', GLFW_PRESS);
+		return;
+	}
+	if (controlMode != 2)
+		return;
+
+	if (seconds < 1.5)
+	{
+		moveX = moveZ = 0;
+		moveY = speed;
+		return;
+	}
+	float heading = (float)(seconds - 1.5) * 0.6f;
+	moveX = speed * cos(heading);
+	moveY = 0;
+	moveZ = speed * sin(heading);
+}
+
+/* Loads a recorded session to be replayed, its timings go next to it: flight.log to flight_timings.csv */
+static bool startReplay(const string& path, string& out)
+{
+	if (!inputLog.load(path))
+	{
+		cout << "can't read input log " << path << endl;
+		return false;
+	}
+	timestep.tickSeconds = 1.0 / inputLog.ticksPerSecond;
+	replayingInput = true;
+	size_t dot = path.find_last_of('.');
+	size_t slash = path.find_last_of("/\\");
+	out = dot != string::npos && (slash == string::npos || dot > slash) ? path.substr(0, dot) : path;
+	cout << "replaying " << path << ": " << inputLog.events.size() << " keys over " << inputLog.endTick << " ticks" << endl;
+	return true;
+}
+
+/* Runs the renderer without a window for a number of frames and writes the time each frame took
+   to <out>_timings.csv, and with --images every frame to <out>_00000.ppm on.
+	--frames N		frames to draw, 600 by default
+	--size WxH		frame size, 1024x768 by default
+	--fps F			the frame rate the clock is moved on at, 60 by default
+	--swarm N		drones flying with the controlled one, 1 by default
+	--out prefix	the start of the output file names, "headless" by default
+	--images		save the frames as well as the timings
+	--replay log	fly a recorded session instead of the scripted flight, as fast as it will go.
+					It runs until the session's last tick and the output is named after the log */
+static int runHeadless(int argc, char* argv[])
+{
+	int numFrames = 600, width = 1024, height = 768, numDrones = 1;
+	double fps = 60.0;
+	string out = "headless", replayPath, replayOut;
+	bool writeImages = false, outGiven = false;
+	for (int i = 0; i < argc; i++)
+	{
+		string option = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (option == "--frames" && hasValue)
+			numFrames = std::max(atoi(argv[++i]), 1);
+		else if (option == "--size" && hasValue)
+			sscanf(argv[++i], "%dx%d", &width, &height);
+		else if (option == "--fps" && hasValue)
+			fps = std::max(atof(argv[++i]), 1.0);
+		else if (option == "--swarm" && hasValue)
+			numDrones = std::max(atoi(argv[++i]), 1);
+		else if (option == "--out" && hasValue)
+		{
+			out = argv[++i];
+			outGiven = true;
+		}
+		else if (option == "--replay" && hasValue)
+			replayPath = argv[++i];
+		else if (option == "--images")
+			writeImages = true;
+		else
+		{
+			cout << "unknown headless option " << option << endl;
+			return 1;
+		}
+	}
+
+	if (!replayPath.empty())
+	{
+		if (!startReplay(replayPath, replayOut))
+			return 1;
+		if (!outGiven)
+			out = replayOut;
+	}
+
+	HeadlessContext context;
+	if (!context.create(width, height))
+		return 1;
+	cout << "headless: " << glGetString(GL_RENDERER) << ", OpenGL " << glGetString(GL_VERSION) << endl;
+
+	headlessMode = true;
+	headlessTime = 0.0;
+	screenFrameBuffer = context.frameBuffer;
+	init(loadShaderProgram, HeadlessContext::getProcAddress);
+	reshape(NULL, width, height);
+	if (numDrones != swarmSizes[swarmSizeIndex])
+		buildSwarm(numDrones);
+
+	FrameTimingLog timings;
+	if (!timings.open(out + "_timings.csv"))
+	{
+		cout << "can't write " << out << "_timings.csv" << endl;
+		return 1;
+	}
+
+	// cpu is the time to build and submit the frame, frame is up to the GPU having finished it
+	for (int frame = 0; replayingInput ? timestep.ticks < inputLog.endTick : frame < numFrames; frame++)
+	{
+		headlessTime = frame / fps;
+		if (!replayingInput)
+			scriptHeadlessFrame(frame, numFrames, headlessTime);
+
+		chrono::high_resolution_clock::time_point start = chrono::high_resolution_clock::now();
+		display();
+		chrono::high_resolution_clock::time_point submitted = chrono::high_resolution_clock::now();
+		glFinish();
+		chrono::high_resolution_clock::time_point finished = chrono::high_resolution_clock::now();
+
+		timings.add(timestep.ticks, chrono::duration<double, milli>(submitted - start).count(), chrono::duration<double, milli>(finished - start).count(), renderStats);
+
+		if (writeImages)
+		{
+			ostringstream path;
+			path << out << "_" << setw(5) << setfill('0') << frame << ".ppm";
+			if (!context.writeImage(path.str()))
+				cout << "can't write " << path.str() << endl;
+		}
+	}
+
+	cout << width << "x" << height << " with " << swarm.size() << " drones, ";
+	timings.summarise(cout);
+
+#ifdef FRAME_PROFILER
+	frameProfiler.summarise(cout);
+	if (!frameProfiler.writeChromeTrace(out + "_trace.json"))
+		cout << "can't write " << out << "_trace.json" << endl;
+#endif
+
+	jobs.stop();
+	context.destroy();
+	return 0;
+}
+
 int main(int argc, char* argv[])
 {
+	// run the CPU benchmarks instead of opening a window
+	if (argc > 1 && string(argv[1]) == "--bench")
+	{
+		return runBenchmarks(argc - 2, argv + 2);
+	}
+
+	// draw a scripted flight offscreen, for machines without a display
+	if (argc > 1 && string(argv[1]) == "--headless")
+	{
+		return runHeadless(argc - 2, argv + 2);
+	}
+
+	/* --record log saves the session's keys when the window closes, --replay log flies a
+	   recorded session again in the window and writes its frame times next to the log */
+	string inputLogPath;
+	if (argc > 2 && string(argv[1]) == "--record")
+	{
+		inputLogPath = argv[2];
+		recordingInput = true;
+		inputLog.ticksPerSecond = (unsigned int)(1.0 / timestep.tickSeconds + 0.5);
+	}
+	else if (argc > 2 && string(argv[1]) == "--replay")
+	{
+		string out;
+		if (!startReplay(argv[2], out) || !replayTimings.open(out + "_timings.csv"))
+			return 1;
+	}
+
 	GLWrapper* glw = new GLWrapper(1024, 768, "Assignment 1 - Drone");;
 	windowWidth = 1024;
 	windowHeight = 768;
@@ -1248,14 +1508,24 @@ int main(int argc, char* argv[])
 	glw->setRenderer(display);
 	glw->setKeyCallback(keyCallback);
 	glw->setReshapeCallback(reshape);
+	window = glw->getWindow();
 
 	/* Output the OpenGL vendor and version */
 	glw->DisplayVersion();
 
-	init(glw);
+	init([glw](const char* vertexPath, const char* fragmentPath) { return glw->LoadShader(vertexPath, fragmentPath); }, glfwGetProcAddress);
 
 	glw->eventLoop();
 
+	if (recordingInput)
+	{
+		inputLog.endTick = (unsigned int)timestep.ticks;
+		cout << (inputLog.save(inputLogPath) ? "saved " : "couldn't save ") << inputLog.events.size() << " keys over " <<
+			inputLog.endTick << " ticks to " << inputLogPath << endl;
+	}
+	if (replayingInput)
+		replayTimings.summarise(cout);
+
 	delete(glw);
 	return 0;
 }
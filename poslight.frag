@@ -8,39 +8,80 @@ in VERTEX_OUT
 	vec3 pos;
 	vec3 normal;
 	vec4 vertexColour;
-	vec4 FragPosLightSpace;
+	flat float reflectiveness;
 } fIn;
 
 
 out vec4 outputColor;
 
-uniform vec3 viewPos;
-uniform sampler2D shadowMap;
+// must match maxNumLights and maxShadowCascades in UniformBuffers.h
+#define MAX_LIGHTS 64
+#define MAX_CASCADES 4
 
-uniform mat4 model, view, projection;
-uniform mat3 normalMatrix;
+// Per-frame values, filled once a frame from a uniform buffer. Must match FrameBlock in poslight.vert
+layout(std140) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceMatrix[MAX_CASCADES];
+	vec4 cascadeSplits;		// far view space depth of each cascade
+	uint colourMode;
+	uint attenuationMode;
+	uint unused;
+	uint numCascades;
+	uvec4 clusterCount;		// tiles in x and y, depth slices, and 1 when clustered lighting is on
+	vec4 clusterScale;		// tile size in pixels, depth slice scale and bias
+};
+
+struct Light
+{
+	vec4 position;
+	vec3 colour;
+	uint mode;		// 1 for the light that casts shadows
+};
+
+layout(std140) uniform LightBlock
+{
+	uint numLights;
+	Light lights[MAX_LIGHTS];
+};
+
+// Clustered lights, see LightClusters in ClusteredLights.h
+uniform usamplerBuffer clusterGrid;			// offset and count into clusterLightIndices for each cluster
+uniform usamplerBuffer clusterLightIndices;
+uniform samplerBuffer clusterLights;		// (position, radius) and (colour, 0) for each light
+
+uniform vec3 viewPos;
+uniform sampler2DArray shadowMap;	// one layer for each cascade
 
 uniform uint emitMode;
 uniform vec3 emitColour;
-uniform vec4 lightPos[10];
-uniform vec3 lightColour[10];
-uniform uint lightMode[10];
-uniform uint numLights;
-uniform float reflectiveness; // value of 0.01 - 1
-
-uniform uint attenuationMode;
 
 vec3 specular_albedo = vec3(1.0, 0.8, 0.6);
 vec3 global_ambient = vec3(0.05, 0.05, 0.05);
 
-float shadowCalculation(vec4 lightSpace)
+/* Shadow from the main light, using the first cascade that reaches the fragment's view depth */
+float shadowCalculation(vec3 worldPos, float viewDepth)
 {
+	int cascade = -1;
+	for (int i = 0; i < numCascades; i++)
+	{
+		if (viewDepth < cascadeSplits[i])
+		{
+			cascade = i;
+			break;
+		}
+	}
+	// past the last cascade there are no shadows
+	if (cascade < 0)
+		return 0.0;
 
+	vec4 lightSpace = lightSpaceMatrix[cascade] * vec4(worldPos, 1.0);
 	vec3 projCoords = lightSpace.xyz / lightSpace.w;
 
 	projCoords = projCoords * 0.5 + 0.5;
 
-	float closestDepth = texture(shadowMap, projCoords.xy).r;
+	float closestDepth = texture(shadowMap, vec3(projCoords.xy, cascade)).r;
 
 	float currentDepth = projCoords.z; 
 	float bias = 0.005;
@@ -51,6 +92,58 @@ float shadowCalculation(vec4 lightSpace)
 }
 
 
+/* Lighting from one positional light, P and N are the eye space position and normal */
+vec3 pointLight(vec3 light_pos3, vec3 lightColour, uint mode, vec3 P, vec3 N, vec3 V)
+{
+	vec3 currentLightColour = lightColour;
+	if (lightColour == vec3(0.f))
+	{
+		currentLightColour = vec3(1.0f);
+	}
+
+	vec3 ambient = fIn.vertexColour.xyz  * 0.1 * (0.8 + (0.2*currentLightColour));
+
+	vec3 L = light_pos3 - P;			// Calculate the vector from the light position to the vertex in eye space
+	float distanceToLight = length(L);	// For attenuation
+	L = normalize(L);					// Normalise our light vector
+
+	// Calculate the diffuse component
+	vec3 diffuse = max(dot(N, L), 0.0) * fIn.vertexColour.xyz * (0.2 + (0.8*currentLightColour));
+
+	// Calculate the specular component using Phong specular reflection
+	vec3 R = reflect(-L, N);
+	vec3 specular = vec3(0.f);
+	if (fIn.reflectiveness > 0.f)
+	{
+		specular = pow(max(dot(R, V), 0.0), 1/max(fIn.reflectiveness,0.0001) ) * specular_albedo * (0.8 + (0.2*currentLightColour));
+	}
+
+	// Calculate the attenuation factor;
+	float attenuation;
+	if (attenuationMode != 1)
+	{
+		attenuation = 1.0;
+	}
+	else
+	{
+		// Define attenuation constants. These could be uniforms for greater flexibility
+		float attenuation_k1 = 0.5;
+		float attenuation_k2 = 0.2;
+		float attenuation_k3 = 0.8;
+		attenuation = 1.0 / (attenuation_k1 + attenuation_k2*distanceToLight + 
+								   attenuation_k3 * pow(distanceToLight, 2));
+	}
+
+	// calculate shadow value
+	float shadow = 0.f;
+	if (mode == 1)
+	{
+		shadow = shadowCalculation(fIn.pos, -P.z);
+	}
+
+	return attenuation * (ambient + ((1.0 - shadow) * (specular + diffuse)));
+}
+
 void main()
 {
 	vec3 emissive = vec3(0);
@@ -67,62 +160,32 @@ void main()
 	
 	}
 	outputColor =  vec4((global_ambient * fIn.vertexColour.xyz) + emissive , 1.f);
-	for (int i = 0; i < numLights; i++)
-	{
-		vec4 position_h = vec4(fIn.pos, 1.0);
-		vec3 light_pos3 = lightPos[i].xyz;		
-		
-		vec3 currentLightColour = lightColour[i];
-		if (lightColour[i] == vec3(0.f))
-		{
-			currentLightColour = vec3(1.0f);
-		}
-
-		vec3 ambient = fIn.vertexColour.xyz  * 0.1 * (0.8 + (0.2*currentLightColour));
-
-		// Define our vectors to calculate diffuse and specular lighting
-		mat4 mv_matrix = view * model;		// Calculate the model-view transformation
-		vec4 P = view * position_h;	// Modify the vertex position (x, y, z, w) by the model-view transformation
-		vec3 N = normalize(normalMatrix * fIn.normal);		// Modify the normals by the normal-matrix (i.e. to model-view (or eye) coordinates )
-		vec3 L = light_pos3 - P.xyz;		// Calculate the vector from the light position to the vertex in eye space
-		float distanceToLight = length(L);	// For attenuation
-		L = normalize(L);					// Normalise our light vector
 
-		// Calculate the diffuse component
-		vec3 diffuse = max(dot(N, L), 0.0) * fIn.vertexColour.xyz * (0.2 + (0.8*currentLightColour));
+	// the same for every light, so worked out once
+	vec3 P = (view * vec4(fIn.pos, 1.0)).xyz;	// Modify the vertex position (x, y, z, w) by the model-view transformation
+	vec3 N = normalize(fIn.normal);				// The normal was moved to model-view (or eye) coordinates in the vertex shader
+	vec3 V = normalize(viewPos - P);
 
-		// Calculate the specular component using Phong specular reflection
-		vec3 V = normalize(viewPos - P.xyz);	
-		vec3 R = reflect(-L, N);
-		vec3 specular = vec3(0.f);
-		if (reflectiveness > 0.f)
-		{
-			specular = pow(max(dot(R, V), 0.0), 1/max(reflectiveness,0.0001) ) * specular_albedo * (0.8 + (0.2*currentLightColour));
-		}
+	// lights in the uniform block reach every fragment
+	for (int i = 0; i < numLights; i++)
+	{
+		outputColor += vec4(pointLight(lights[i].position.xyz, lights[i].colour, lights[i].mode, P, N, V), 1.0);
+	}
 
-		// Calculate the attenuation factor;
-		float attenuation;
-		if (attenuationMode != 1)
-		{
-			attenuation = 1.0;
-		}
-		else
-		{
-			// Define attenuation constants. These could be uniforms for greater flexibility
-			float attenuation_k1 = 0.5;
-			float attenuation_k2 = 0.2;
-			float attenuation_k3 = 0.8;
-			attenuation = 1.0 / (attenuation_k1 + attenuation_k2*distanceToLight + 
-									   attenuation_k3 * pow(distanceToLight, 2));
-		}
+	// clustered lights, only the ones listed for this fragment's cluster
+	if (clusterCount.w == 1)
+	{
+		uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterScale.xy), clusterCount.xy - 1);
+		uint slice = uint(clamp(log(-P.z) * clusterScale.z + clusterScale.w, 0.0, float(clusterCount.z - 1)));
+		uint cluster = (slice * clusterCount.y + tile.y) * clusterCount.x + tile.x;
 
-		// calculate shadow value
-		float shadow = 0.f;
-		if (lightMode[i] == 1)
+		uvec2 range = texelFetch(clusterGrid, int(cluster)).xy;
+		for (uint i = 0; i < range.y; i++)
 		{
-			shadow = shadowCalculation(fIn.FragPosLightSpace);
+			int light = int(texelFetch(clusterLightIndices, int(range.x + i)).x);
+			vec3 position = texelFetch(clusterLights, light * 2).xyz;
+			vec3 colour = texelFetch(clusterLights, light * 2 + 1).xyz;
+			outputColor += vec4(pointLight(position, colour, 0, P, N, V), 1.0);
 		}
-
-		outputColor +=  vec4(attenuation * (ambient + ((1.0 - shadow) * (specular + diffuse))), 1.0);
 	}
-}
\ No newline at end of file
+}
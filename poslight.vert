@@ -10,6 +10,12 @@ layout(location = 0) in vec3 position;
 layout(location = 1) in vec4 colour;
 layout(location = 2) in vec3 normal;
 
+// Per-instance attributes, only read when instanced is set
+layout(location = 3) in mat4 instanceModel;
+layout(location = 7) in mat3 instanceNormalMatrix;
+layout(location = 10) in vec4 instanceColour;
+layout(location = 11) in float instanceReflectiveness;
+
 // This is the output vertex colour sent to the rasterizer
 //out vec4 fcolour;
 
@@ -18,32 +24,62 @@ out VERTEX_OUT
 	vec3 pos;
 	vec3 normal;
 	vec4 vertexColour;
-	vec4 FragPosLightSpace;
+	flat float reflectiveness;
 } vOut;
 
 
 
+// must match maxShadowCascades in UniformBuffers.h
+#define MAX_CASCADES 4
+
+// Per-frame values, filled once a frame from a uniform buffer. Must match FrameBlock in poslight.frag
+layout(std140) uniform FrameBlock
+{
+	mat4 view;
+	mat4 projection;
+	mat4 lightSpaceMatrix[MAX_CASCADES];
+	vec4 cascadeSplits;		// far view space depth of each cascade
+	uint colourMode;
+	uint attenuationMode;
+	uint unused;
+	uint numCascades;
+	uvec4 clusterCount;		// tiles in x and y, depth slices, and 1 when clustered lighting is on
+	vec4 clusterScale;		// tile size in pixels, depth slice scale and bias
+};
+
 // These are the uniforms that are defined in the application
-uniform mat4 model, view, projection;
-uniform uint colourMode;
+uniform mat4 model;
 uniform vec4 colourOverride;
-uniform mat4 lightSpaceMatrix;
+uniform mat3 normalMatrix;
+uniform float reflectiveness;
+uniform uint instanced;		// only set around the instanced draws
 
 void main()
 {
+	mat4 partModel = model;
+	mat3 partNormalMatrix = normalMatrix;
+	vec4 partColour = colourOverride;
+	vOut.reflectiveness = reflectiveness;
+	if (instanced == 1)
+	{
+		partModel = instanceModel;
+		partNormalMatrix = instanceNormalMatrix;
+		partColour = instanceColour;
+		vOut.reflectiveness = instanceReflectiveness;
+	}
+
 	if (colourMode == 1)
 	{
-		vOut.vertexColour = colourOverride;
+		vOut.vertexColour = partColour;
 	}
 	else
 	{
 		vOut.vertexColour = colour;
 	}
-	vOut.pos = vec3(model * vec4(position, 1.f));
-	vOut.normal = normal; 
-	vOut.FragPosLightSpace = lightSpaceMatrix * vec4(vOut.pos,1.f);
+	vOut.pos = vec3(partModel * vec4(position, 1.f));
+	vOut.normal = partNormalMatrix * normal; 
 
-	gl_Position = (projection * view * model) * vec4(position, 1.0);
+	gl_Position = (projection * view * partModel) * vec4(position, 1.0);
 }
 
 
@@ -1,9 +1,14 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
+layout (location = 3) in mat4 instanceModel;
 
 uniform mat4 model, lightSpaceMatrix;
+uniform uint instanced;
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    mat4 partModel = model;
+    if (instanced == 1u)
+        partModel = instanceModel;
+    gl_Position = lightSpaceMatrix * partModel * vec4(aPos, 1.0);
 }
\ No newline at end of file